@@ -0,0 +1,239 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+/* Audio sample conversion kernels: throughput of each input format. The checks build
+   synthetic Ogg streams to verify how the player finds its way in them. */
+
+#include "bench.h"
+#include "audio/convert.h"
+#include "audio/ogg.h"
+
+#include <the_Foundation/block.h>
+#include <stdlib.h>
+#include <string.h>
+
+iDeclareType(BenchAudio)
+
+struct Impl_BenchAudio {
+    size_t   numValues;
+    uint8_t *input;  /* large enough for any format */
+    uint8_t *output;
+    float *  planar[2];
+};
+
+enum { numValues_BenchAudio_ = 1 << 20 }; /* about 12 seconds of 44.1 kHz stereo */
+
+static void f32_BenchAudio_(void *context) {
+    iBenchAudio *d = context;
+    gainF32_Audio((float *) d->output, (const float *) d->input, d->numValues, 0.8f);
+}
+
+static void f64_BenchAudio_(void *context) {
+    iBenchAudio *d = context;
+    gainF64ToF32_Audio((float *) d->output, (const double *) d->input, d->numValues, 0.8f);
+}
+
+static void s16_BenchAudio_(void *context) {
+    iBenchAudio *d = context;
+    gainS16_Audio((int16_t *) d->output, (const int16_t *) d->input, d->numValues, 0.8f);
+}
+
+static void s24_BenchAudio_(void *context) {
+    iBenchAudio *d = context;
+    gainS24ToS16_Audio((int16_t *) d->output, d->input, d->numValues, 0.8f);
+}
+
+static void s32_BenchAudio_(void *context) {
+    iBenchAudio *d = context;
+    gainS32_Audio((int32_t *) d->output, (const int32_t *) d->input, d->numValues, 0.8f);
+}
+
+static void u8_BenchAudio_(void *context) {
+    iBenchAudio *d = context;
+    gainU8_Audio(d->output, d->input, d->numValues, 0.8f);
+}
+
+static void vorbis_BenchAudio_(void *context) {
+    iBenchAudio *d = context;
+    interleaveF32_Audio((float *) d->output,
+                        (const float *const *) d->planar,
+                        2,
+                        d->numValues / 2,
+                        0.8f);
+}
+
+void runAudio_Bench(void) {
+    iBenchAudio ba;
+    ba.numValues = numValues_BenchAudio_;
+    ba.input     = malloc(8 * ba.numValues);
+    ba.output    = malloc(8 * ba.numValues);
+    /* Noise, so no format gets an unrealistic shortcut. */
+    srand(1);
+    for (size_t i = 0; i < 8 * ba.numValues; i++) {
+        ba.input[i] = rand() & 0xff;
+    }
+    float *floats = (float *) ba.input;
+    for (size_t i = 0; i < ba.numValues; i++) {
+        floats[i] = (float) rand() / RAND_MAX * 2 - 1;
+    }
+    ba.planar[0] = floats;
+    ba.planar[1] = floats + ba.numValues / 2;
+    /* Throughput is counted as samples (values) per second: MB/s equals millions of values. */
+    run_Bench("audio: F32 gain", ba.numValues, f32_BenchAudio_, &ba);
+    run_Bench("audio: Vorbis interleave (stereo)", ba.numValues, vorbis_BenchAudio_, &ba);
+    run_Bench("audio: S16 gain", ba.numValues, s16_BenchAudio_, &ba);
+    run_Bench("audio: S32 gain", ba.numValues, s32_BenchAudio_, &ba);
+    run_Bench("audio: U8 gain", ba.numValues, u8_BenchAudio_, &ba);
+    run_Bench("audio: S24 to S16", ba.numValues, s24_BenchAudio_, &ba);
+    /* Reinterpreting the float noise as doubles could produce NaNs; use real values. */
+    double *doubles = (double *) ba.input;
+    for (size_t i = 0; i < ba.numValues; i++) {
+        doubles[i] = (double) rand() / RAND_MAX * 2 - 1;
+    }
+    run_Bench("audio: F64 to F32", ba.numValues, f64_BenchAudio_, &ba);
+    free(ba.output);
+    free(ba.input);
+}
+
+static uint32_t crc_OggCheck_(const uint8_t *data, size_t size) {
+    uint32_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= (uint32_t) data[i] << 24;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc << 1) ^ (crc & 0x80000000 ? 0x04c11db7 : 0);
+        }
+    }
+    return crc;
+}
+
+static void appendPage_OggCheck_(iBlock *stream, uint32_t serial, int64_t granule,
+                                 const uint8_t *payload, size_t size) {
+    /* Payloads are kept under 255 bytes so a page has a single segment. */
+    uint8_t page[headerSize_OggPage + 1 + 255];
+    iAssert(size < 255);
+    memset(page, 0, sizeof(page));
+    memcpy(page, "OggS", 4);
+    for (int i = 0; i < 8; i++) {
+        page[6 + i] = (uint8_t) ((uint64_t) granule >> (8 * i));
+    }
+    for (int i = 0; i < 4; i++) {
+        page[14 + i] = (uint8_t) (serial >> (8 * i));
+    }
+    page[26] = 1;
+    page[27] = (uint8_t) size;
+    memcpy(page + headerSize_OggPage + 1, payload, size);
+    const size_t   pageSize = headerSize_OggPage + 1 + size;
+    const uint32_t crc      = crc_OggCheck_(page, pageSize);
+    for (int i = 0; i < 4; i++) {
+        page[22 + i] = (uint8_t) (crc >> (8 * i));
+    }
+    appendData_Block(stream, page, pageSize);
+}
+
+static void makeStream_OggCheck_(iBlock *stream, int numPages, int samplesPerPage) {
+    /* A header page and audio pages of 100 bytes each. */
+    uint8_t payload[100];
+    memset(payload, 0x55, sizeof(payload));
+    appendPage_OggCheck_(stream, 1, 0, payload, sizeof(payload));
+    for (int i = 1; i <= numPages; i++) {
+        appendPage_OggCheck_(stream, 1, (int64_t) i * samplesPerPage, payload, sizeof(payload));
+    }
+}
+
+static void checkLastGranule_(void) {
+    iBlock stream;
+    init_Block(&stream, 0);
+    makeStream_OggCheck_(&stream, 10, 1000);
+    check_Bench(lastGranule_Ogg(constData_Block(&stream), size_Block(&stream)) == 10000,
+                "ogg: last granule");
+    /* A capture pattern in the payload of the last page, followed by a bogus granule. */ {
+        uint8_t payload[60];
+        memset(payload, 0, sizeof(payload));
+        memcpy(payload + 20, "OggS", 4);
+        memset(payload + 26, 0x7f, 8);
+        payload[34] = 1; /* same serial */
+        appendPage_OggCheck_(&stream, 1, 11000, payload, sizeof(payload));
+        uint8_t *page = (uint8_t *) data_Block(&stream) + size_Block(&stream) - sizeof(payload) -
+                        headerSize_OggPage - 1;
+        check_Bench(isValidPage_Ogg(page, sizeof(payload) + headerSize_OggPage + 1),
+                    "ogg: page checksum");
+        check_Bench(lastGranule_Ogg(constData_Block(&stream), size_Block(&stream)) == 11000,
+                    "ogg: last granule (stray pattern)");
+        page[headerSize_OggPage + 1] ^= 1; /* corrupt the payload */
+        check_Bench(lastGranule_Ogg(constData_Block(&stream), size_Block(&stream)) == 10000,
+                    "ogg: last granule (bad checksum)");
+        page[headerSize_OggPage + 1] ^= 1;
+    }
+    /* Chained: another logical stream follows. */ {
+        uint8_t payload[10] = { 0 };
+        appendPage_OggCheck_(&stream, 2, 0, payload, sizeof(payload));
+        appendPage_OggCheck_(&stream, 2, 500, payload, sizeof(payload));
+        check_Bench(lastGranule_Ogg(constData_Block(&stream), size_Block(&stream)) == 11000,
+                    "ogg: last granule (chained)");
+    }
+    deinit_Block(&stream);
+}
+
+static uint64_t resume_OggCheck_(uint64_t pageStart, uint64_t target, uint64_t knownFrom) {
+    /* Decodes frames from the start of a page like stb_vorbis does after resynchronizing:
+       the position is unknown until `knownFrom` has been passed. Returns the position of
+       the first sample that would be played. */
+    const int frameSize  = 256;
+    uint64_t  pos        = pageStart;
+    uint64_t  numDecoded = 0;
+    for (;;) {
+        pos        += frameSize;
+        numDecoded += frameSize;
+        if (pos >= knownFrom) {
+            const uint64_t discard = seekDiscard_Ogg(target, pos, numDecoded);
+            if (pos >= target) {
+                return pos - numDecoded + discard;
+            }
+            numDecoded = 0; /* all dropped */
+        }
+    }
+}
+
+static void checkSeek_(void) {
+    iBlock stream;
+    init_Block(&stream, 0);
+    makeStream_OggCheck_(&stream, 10, 1000);
+    const uint8_t *data   = constData_Block(&stream);
+    const uint64_t target = 2500; /* in the middle of the page that ends at 3000 */
+    const size_t   pos    = seekPage_Ogg(data, size_Block(&stream), target);
+    const size_t   next   = pos + pageSize_Ogg(data + pos, size_Block(&stream) - pos);
+    check_Bench(granule_Ogg(data + pos) == 2000 && granule_Ogg(data + next) == 3000,
+                "ogg: seek finds the preceding page");
+    check_Bench(resume_OggCheck_((uint64_t) granule_Ogg(data + pos), target, 3000) == target,
+                "ogg: seek mid-page (position found late)");
+    check_Bench(resume_OggCheck_((uint64_t) granule_Ogg(data + pos), target, 0) == target,
+                "ogg: seek mid-page (position known)");
+    check_Bench(seekPage_Ogg(data, size_Block(&stream), 3000) == next &&
+                seekDiscard_Ogg(3000, 3256, 256) == 0,
+                "ogg: seek to a page boundary");
+    deinit_Block(&stream);
+}
+
+void checkAudio_Bench(void) {
+    checkLastGranule_();
+    checkSeek_();
+}
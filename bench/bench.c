@@ -0,0 +1,190 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "bench.h"
+#include "app.h"
+#include "embedded.h"
+#include "ui/command.h"
+#include "ui/metrics.h"
+#include "ui/text.h"
+
+#include <the_Foundation/commandline.h>
+#include <the_Foundation/garbage.h>
+#include <the_Foundation/path.h>
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int    iterations_ = 20;
+static size_t allocCount_;
+static int    numFailed_;
+
+#if defined (LAGRANGE_BENCH_COUNT_ALLOCS)
+/* The linker redirects calls made by the statically linked code here (-Wl,--wrap). */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocCount_++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocCount_++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocCount_++;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+int iterations_Bench(void) {
+    return iterations_;
+}
+
+static void flushCommands_Bench_(void) {
+    /* There is no event loop, so commands posted by the benchmarked code pile up in the
+       queue. They are deleted so each iteration starts from the same state. */
+    SDL_Event ev;
+    while (SDL_PeepEvents(&ev, 1, SDL_GETEVENT, SDL_USEREVENT, SDL_USEREVENT) > 0) {
+        if (ev.user.code == command_UserEventCode) {
+            delete_Command(ev.user.data1);
+        }
+    }
+}
+
+void run_Bench(const char *name, size_t bytesPerIteration, iBenchFunc func, void *context) {
+    /* Note: `name` may be a collected string, so print it before recycling. */
+    printf("%-40s", name);
+    fflush(stdout);
+    /* Warm up caches (e.g., glyphs) so they don't skew the first iteration. */
+    func(context);
+    flushCommands_Bench_();
+    recycle_Garbage();
+    const size_t   startAllocs = allocCount_;
+    const uint64_t startTime   = SDL_GetPerformanceCounter();
+    for (int i = 0; i < iterations_; i++) {
+        func(context);
+        flushCommands_Bench_();
+        recycle_Garbage();
+    }
+    const double seconds =
+        (double) (SDL_GetPerformanceCounter() - startTime) / SDL_GetPerformanceFrequency();
+    const double perIter = seconds / iterations_;
+    printf(" %10.3f ms", perIter * 1000.0);
+    if (bytesPerIteration) {
+        printf(" %10.2f MB/s", bytesPerIteration / perIter / 1.0e6);
+    }
+    else {
+        printf(" %10s     ", "");
+    }
+#if defined (LAGRANGE_BENCH_COUNT_ALLOCS)
+    printf(" %12.1f allocs", (double) (allocCount_ - startAllocs) / iterations_);
+#else
+    iUnused(startAllocs);
+#endif
+    printf("\n");
+    fflush(stdout);
+}
+
+void check_Bench(iBool condition, const char *what) {
+    printf("%-40s %s\n", what, condition ? "ok" : "FAILED");
+    fflush(stdout);
+    if (!condition) {
+        numFailed_++;
+    }
+}
+
+int main(int argc, char **argv) {
+    init_Foundation();
+    /* No display is needed; everything is drawn with the software renderer. */
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0 /* can be overridden */);
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER)) {
+        fprintf(stderr, "SDL init failed: %s\n", SDL_GetError());
+        return -1;
+    }
+    iCommandLine args;
+    init_CommandLine(&args, argc, argv);
+    iStringList *corpusFiles = new_StringList();
+    iBool        checkOnly   = iFalse;
+    for (size_t i = 1; i < size_StringList(args_CommandLine(&args)); i++) {
+        const iString *arg = constAt_StringList(args_CommandLine(&args), i);
+        if (!cmp_String(arg, "--iterations") &&
+            i + 1 < size_StringList(args_CommandLine(&args))) {
+            iterations_ = iMax(1, toInt_String(constAt_StringList(args_CommandLine(&args), ++i)));
+        }
+        else if (!cmp_String(arg, "--check")) {
+            checkOnly = iTrue;
+        }
+        else {
+            pushBack_StringList(corpusFiles, arg);
+        }
+    }
+#if defined (iHaveLoadEmbed)
+    /* Load the resources from a file next to the executable. */ {
+        char *base = SDL_GetBasePath();
+        const iBool ok = load_Embed(concatPath_CStr(base ? base : "", "resources.binary"));
+        SDL_free(base);
+        if (!ok) {
+            fprintf(stderr, "failed to load resources.binary\n");
+            return -1;
+        }
+    }
+#endif
+    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+    SDL_Window *  win    = SDL_CreateWindow("lagrange-bench", 0, 0, 1024, 768, SDL_WINDOW_HIDDEN);
+    SDL_Renderer *render = win ? SDL_CreateRenderer(win, -1,
+                                                    SDL_RENDERER_SOFTWARE |
+                                                    SDL_RENDERER_TARGETTEXTURE)
+                               : NULL;
+    if (!render) {
+        fprintf(stderr, "failed to create a software renderer: %s\n", SDL_GetError());
+        return -1;
+    }
+    initHeadless_App();
+    setPixelRatio_Metrics(1.0f);
+    init_Text(render);
+    if (checkOnly) {
+        printf("lagrange-bench %s: checks\n", LAGRANGE_APP_VERSION);
+        checkMedia_Bench();
+        checkAudio_Bench();
+    }
+    else {
+        printf("lagrange-bench %s: %d iterations per benchmark\n", LAGRANGE_APP_VERSION,
+               iterations_);
+        runDocument_Bench(corpusFiles);
+        runMedia_Bench();
+        runAudio_Bench();
+    }
+    deinit_Text();
+    deinitHeadless_App();
+    iRelease(corpusFiles);
+    deinit_CommandLine(&args);
+    SDL_DestroyRenderer(render);
+    SDL_DestroyWindow(win);
+    SDL_Quit();
+    deinit_Foundation();
+    return numFailed_;
+}
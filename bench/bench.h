@@ -0,0 +1,46 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#pragma once
+
+/* lagrange-bench: headless benchmarks of the core code paths. Each benchmark is run
+   for a number of iterations after a warm-up round, and the average time, throughput and
+   number of heap allocations per iteration are printed.
+
+   With --check, only the correctness checks are run and the exit code is the number of
+   failed checks. */
+
+#include <the_Foundation/stringlist.h>
+
+typedef void (*iBenchFunc)(void *context);
+
+int     iterations_Bench    (void);
+void    run_Bench           (const char *name, size_t bytesPerIteration,
+                             iBenchFunc func, void *context);
+void    check_Bench         (iBool condition, const char *what);
+
+/* Suites */
+void    runDocument_Bench   (const iStringList *corpusFiles);
+void    runMedia_Bench      (void);
+void    runAudio_Bench      (void);
+void    checkMedia_Bench    (void);
+void    checkAudio_Bench    (void);
@@ -0,0 +1,245 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+/* Gemtext parsing and layout, text measurement, and Gopher menu conversion. */
+
+#include "bench.h"
+#include "embedded.h"
+#include "gmdocument.h"
+#include "gopher.h"
+#include "ui/text.h"
+
+#include <the_Foundation/array.h>
+#include <the_Foundation/file.h>
+#include <the_Foundation/path.h>
+#include <stdio.h>
+
+iDeclareType(BenchDocument)
+
+struct Impl_BenchDocument {
+    iString      name;
+    iString      source;
+    iGmDocument *doc;
+    int          counter;
+};
+
+static const int layoutWidth_BenchDocument_ = 800;
+
+static void addSource_(iArray *corpus, const char *name, const iString *source) {
+    iBenchDocument bd;
+    initCStr_String(&bd.name, name);
+    initCopy_String(&bd.source, source);
+    bd.doc     = new_GmDocument();
+    bd.counter = 0;
+    setFormat_GmDocument(bd.doc, gemini_GmDocumentFormat);
+    setUrl_GmDocument(bd.doc, collectNewCStr_String("gemini://bench.example/"));
+    pushBack_Array(corpus, &bd);
+}
+
+static void addBlock_(iArray *corpus, const char *name, const iBlock *data) {
+    iString src;
+    initBlock_String(&src, data);
+    addSource_(corpus, name, &src);
+    deinit_String(&src);
+}
+
+/*----------------------------------------------------------------------------------------------*/
+/* Synthetic documents that stress particular paths. */
+
+static iString *hugePreformatted_(void) {
+    iString *src = newCStr_String("# Preformatted\n```ascii art\n");
+    for (int i = 0; i < 4000; i++) {
+        appendFormat_String(src, "%5d |", i);
+        for (int j = 0; j < 12; j++) {
+            appendCStr_String(src, " /\\_/\\ (o.o) ");
+        }
+        appendCStr_String(src, "\n");
+    }
+    appendCStr_String(src, "```\nThe end.\n");
+    return src;
+}
+
+static iString *linkIndex_(void) {
+    iString *src = newCStr_String("# Index\n");
+    for (int i = 0; i < 3000; i++) {
+        appendFormat_String(src,
+                            "=> gemini://host%d.example/gemlog/%04d-entry.gmi 2020-%02d-%02d "
+                            "Entry number %d about something\n",
+                            i % 50, i, 1 + i % 12, 1 + i % 28, i);
+        if (i % 100 == 99) {
+            appendFormat_String(src, "\n## Page %d\n", i / 100 + 1);
+        }
+    }
+    return src;
+}
+
+static iString *cjk_(void) {
+    iString *src = newCStr_String("# 日本語と한국어\n");
+    for (int i = 0; i < 400; i++) {
+        appendCStr_String(src,
+                          "日本語の文章には単語の間に空白がないので、行は文字単位で折り返されます。"
+                          "漢字、ひらがな、カタカナが混在しています。\n"
+                          "한국어 문장은 단어 사이에 공백이 있으므로 단어 단위로 줄이 바뀝니다.\n"
+                          "* 中文段落也包含在内，用于测试字体回退。\n");
+    }
+    return src;
+}
+
+static iString *emoji_(void) {
+    iString *src = newCStr_String("# Emoji \U0001f389\n");
+    for (int i = 0; i < 1000; i++) {
+        appendCStr_String(src,
+                          "Weather ☀ \U0001f324 ⛅ \U0001f327 ⛈ and travel "
+                          "\U0001f680\U0001f6f8\U0001f697\U0001f6b2 with friends \U0001f431"
+                          "\U0001f436\U0001f98a\n"
+                          "> Quoted \U0001f4ac remark \U0001f914 in a reply\n");
+    }
+    return src;
+}
+
+static iString *prose_(void) {
+    iString *src = newCStr_String("# Prose\n");
+    for (int i = 0; i < 300; i++) {
+        appendFormat_String(src,
+                            "## Section %d\n"
+                            "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+                            "eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim "
+                            "ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut "
+                            "aliquip ex ea commodo consequat.\n\n"
+                            "* First point\n* Second point, which is long enough to wrap onto "
+                            "another line in the layout\n"
+                            "> Duis aute irure dolor in reprehenderit in voluptate velit esse.\n",
+                            i + 1);
+    }
+    return src;
+}
+
+static iString *gopherMenu_(void) {
+    iString *src = new_String();
+    for (int i = 0; i < 3000; i++) {
+        switch (i % 4) {
+            case 0:
+                appendFormat_String(src, "i   ___  Section %d  ___\tfake\t(NULL)\t0\r\n", i);
+                break;
+            case 1:
+                appendFormat_String(src, "1Directory %d\t/dir/%d\tgopher.example\t70\r\n", i, i);
+                break;
+            case 2:
+                appendFormat_String(src, "0Text file %d\t/file/%d.txt\tgopher.example\t70\r\n",
+                                    i, i);
+                break;
+            default:
+                appendFormat_String(src, "iJust some information text\tfake\t(NULL)\t0\r\n");
+                break;
+        }
+    }
+    appendCStr_String(src, ".\r\n");
+    return src;
+}
+
+/*----------------------------------------------------------------------------------------------*/
+
+static void parseAndLayout_(void *context) {
+    iBenchDocument *d = context;
+    setSource_GmDocument(d->doc, &d->source, layoutWidth_BenchDocument_);
+}
+
+static void relayout_(void *context) {
+    iBenchDocument *d = context;
+    /* Alternate widths so every iteration actually wraps differently. */
+    setWidth_GmDocument(d->doc, layoutWidth_BenchDocument_ - 100 * (d->counter++ & 1));
+}
+
+static void measureLines_(void *context) {
+    const iBenchDocument *d = context;
+    iRangecc line = iNullRange;
+    while (nextSplit_Rangecc(range_String(&d->source), "\n", &line)) {
+        measureRange_Text(paragraph_FontId, line);
+    }
+}
+
+static void convertGopher_(void *context) {
+    const iBlock *menu = context;
+    iGopher gopher;
+    init_Gopher(&gopher);
+    gopher.type   = '1';
+    gopher.output = new_Block(0);
+    processResponse_Gopher(&gopher, menu);
+    delete_Block(gopher.output);
+    deinit_Gopher(&gopher);
+}
+
+void runDocument_Bench(const iStringList *corpusFiles) {
+    iArray corpus;
+    init_Array(&corpus, sizeof(iBenchDocument));
+    /* Synthetic documents. */ {
+        const struct { const char *name; iString *(*generate)(void); } synth[] = {
+            { "pre-huge", hugePreformatted_ },
+            { "link-index", linkIndex_ },
+            { "cjk", cjk_ },
+            { "emoji", emoji_ },
+            { "prose", prose_ },
+        };
+        iForIndices(i, synth) {
+            iString *src = synth[i].generate();
+            addSource_(&corpus, synth[i].name, src);
+            delete_String(src);
+        }
+    }
+    /* Real-world documents. */
+    addBlock_(&corpus, "about-help", &blobHelp_Embedded);
+    addBlock_(&corpus, "about-lagrange", &blobLagrange_Embedded);
+    addBlock_(&corpus, "about-version", &blobVersion_Embedded);
+    iConstForEach(StringList, f, corpusFiles) {
+        iFile *file = new_File(f.value);
+        if (open_File(file, readOnly_FileMode)) {
+            addBlock_(&corpus, cstr_Rangecc(baseName_Path(f.value)),
+                      collect_Block(readAll_File(file)));
+        }
+        else {
+            fprintf(stderr, "failed to read %s\n", cstr_String(f.value));
+        }
+        iRelease(file);
+    }
+    iForEach(Array, i, &corpus) {
+        iBenchDocument *bd   = i.value;
+        const size_t    size = size_String(&bd->source);
+        run_Bench(format_CStr("parse+layout %s", cstr_String(&bd->name)), size,
+                  parseAndLayout_, bd);
+        run_Bench(format_CStr("relayout %s", cstr_String(&bd->name)), size, relayout_, bd);
+        run_Bench(format_CStr("measureRange_Text %s", cstr_String(&bd->name)), size,
+                  measureLines_, bd);
+    }
+    /* Gopher menu conversion. */ {
+        iString *menu = gopherMenu_();
+        run_Bench("convertSource_Gopher", size_String(menu), convertGopher_,
+                  iConstCast(iBlock *, utf8_String(menu)));
+        delete_String(menu);
+    }
+    iForEach(Array, j, &corpus) {
+        iBenchDocument *bd = j.value;
+        iRelease(bd->doc);
+        deinit_String(&bd->source);
+        deinit_String(&bd->name);
+    }
+    deinit_Array(&corpus);
+}
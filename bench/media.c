@@ -0,0 +1,132 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+/* Looking up inline media by link ID, as done for every visible link when drawing. */
+
+#include "bench.h"
+#include "decoder.h"
+#include "media.h"
+
+#include <the_Foundation/block.h>
+#include <the_Foundation/string.h>
+#include <stdio.h>
+
+iDeclareType(BenchMedia)
+
+struct Impl_BenchMedia {
+    iMedia * media;
+    int      numLinks;
+    iBlock   image;
+    iString  mime;
+    uint32_t found;
+};
+
+static void populate_BenchMedia_(iBenchMedia *d) {
+    /* Every other link has an image, as on a typical gallery page. */
+    for (int i = 1; i <= d->numLinks; i += 2) {
+        setData_Media(d->media, i, NULL, &d->mime, &d->image, allowHide_MediaFlag);
+    }
+}
+
+static void lookup_BenchMedia_(void *context) {
+    iBenchMedia *d = context;
+    for (int frame = 0; frame < 100; frame++) {
+        for (int i = 1; i <= d->numLinks; i++) {
+            d->found += findLinkImage_Media(d->media, i);
+            d->found += findLinkAudio_Media(d->media, i);
+        }
+    }
+}
+
+static void build_BenchMedia_(void *context) {
+    iBenchMedia *d = context;
+    clear_Media(d->media);
+    populate_BenchMedia_(d);
+}
+
+static void remove_BenchMedia_(void *context) {
+    /* Hiding an image removes it from the middle of the list. */
+    iBenchMedia *d = context;
+    const int linkId = (d->numLinks / 2) | 1;
+    setData_Media(d->media, linkId, NULL, NULL, NULL, allowHide_MediaFlag);
+    setData_Media(d->media, linkId, NULL, &d->mime, &d->image, allowHide_MediaFlag);
+}
+
+void runMedia_Bench(void) {
+    static const int sizes[] = { 10, 100, 1000 };
+    /* A 1x1 PPM is quick to decode so the benchmark measures the bookkeeping. */
+    static const char ppm[] = "P6\n1 1\n255\n\x80\x80\x80";
+    for (size_t s = 0; s < iElemCount(sizes); s++) {
+        iBenchMedia bm;
+        bm.media    = new_Media();
+        bm.numLinks = sizes[s];
+        bm.found    = 0;
+        initData_Block(&bm.image, ppm, sizeof(ppm) - 1);
+        initCStr_String(&bm.mime, "image/x-portable-pixmap");
+        populate_BenchMedia_(&bm);
+        run_Bench(format_CStr("media: lookup x100 (%d links)", bm.numLinks), 0,
+                  lookup_BenchMedia_, &bm);
+        run_Bench(format_CStr("media: remove+add (%d links)", bm.numLinks), 0,
+                  remove_BenchMedia_, &bm);
+        run_Bench(format_CStr("media: build (%d links)", bm.numLinks), 0,
+                  build_BenchMedia_, &bm);
+        deinit_String(&bm.mime);
+        deinit_Block(&bm.image);
+        delete_Media(bm.media);
+    }
+}
+
+static void checkDownscale_(iBool isOpaque) {
+    /* An 8x8 image is decoded at most 3x3 in size, so the box filter has to blend
+       partially covered pixels. Uncompressed 32-bit TGA is used for its alpha channel. */
+    const uint8_t  alpha = isOpaque ? 255 : 128;
+    const uint8_t  header[18] = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0, 8, 0, 32, 0x28 };
+    iBlock         tga;
+    iDecodedImage  img;
+    initData_Block(&tga, header, sizeof(header));
+    for (int i = 0; i < 8 * 8; i++) {
+        const uint8_t bgra[4] = { 50, 100, 200, alpha };
+        appendData_Block(&tga, bgra, sizeof(bgra));
+    }
+    iZap(img);
+    submit_Decoder(&tga, 1, &tga, init_I2(3, 3));
+    const iBool isDecoded = takeFinished_Decoder(&tga, &img) && img.pixels;
+    check_Bench(isDecoded && img.size.x == 3 && img.size.y == 3,
+                format_CStr("decoder: downscale size (%s)", isOpaque ? "opaque" : "translucent"));
+    iBool isPreserved = isDecoded;
+    for (int i = 0; isDecoded && i < img.size.x * img.size.y; i++) {
+        const uint8_t *px = img.pixels + 4 * i;
+        isPreserved &= (iAbs(px[0] - 200) <= 1 && iAbs(px[1] - 100) <= 1 &&
+                        iAbs(px[2] - 50) <= 1 && iAbs(px[3] - alpha) <= 1);
+    }
+    check_Bench(isPreserved,
+                format_CStr("decoder: downscale keeps alpha (%s)", isOpaque ? "opaque" : "translucent"));
+    check_Bench(isDecoded && img.hasAlpha == !isOpaque,
+                format_CStr("decoder: downscale hasAlpha (%s)", isOpaque ? "opaque" : "translucent"));
+    deinit_DecodedImage(&img);
+    deinit_Block(&tga);
+}
+
+void checkMedia_Bench(void) {
+    checkDownscale_(iTrue);
+    checkDownscale_(iFalse);
+}
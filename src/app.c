@@ -22,6 +22,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "app.h"
 #include "bookmarks.h"
+#include "decoder.h"
 #include "defs.h"
 #include "embedded.h"
 #include "feeds.h"
@@ -30,6 +31,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "gmdocument.h"
 #include "gmutil.h"
 #include "history.h"
+#include "imagecache.h"
+#include "profiler.h"
+#include "saver.h"
 #include "ui/color.h"
 #include "ui/command.h"
 #include "ui/documentwidget.h"
@@ -42,6 +46,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "ui/window.h"
 #include "visited.h"
 
+#include <the_Foundation/buffer.h>
 #include <the_Foundation/commandline.h>
 #include <the_Foundation/file.h>
 #include <the_Foundation/fileinfo.h>
@@ -102,6 +107,11 @@ struct Impl_App {
     uint32_t     elapsedSinceLastTicker;
     iBool        running;
     iAtomicInt   pendingRefresh;
+    /* Frame scheduling (microseconds): */
+    uint32_t     frameInterval;       /* display refresh period */
+    uint64_t     frameStart;
+    iBool        isInFrame;           /* running tickers or drawing */
+    uint32_t     drawTime;            /* recent average */
     int          tabEnum;
     iStringList *launchCommands;
     iBool        isFinishedLaunching;
@@ -173,6 +183,7 @@ static iString *serializePrefs_App_(const iApp *d) {
     appendFormat_String(str, "zoom.set arg:%d\n", d->prefs.zoomPercent);
     appendFormat_String(str, "smoothscroll arg:%d\n", d->prefs.smoothScrolling);
     appendFormat_String(str, "imageloadscroll arg:%d\n", d->prefs.loadImageInsteadOfScrolling);
+    appendFormat_String(str, "mediafetches.set arg:%d\n", d->prefs.maxMediaFetches);
     appendFormat_String(str, "linewidth.set arg:%d\n", d->prefs.lineWidth);
     appendFormat_String(str, "prefs.biglede.changed arg:%d\n", d->prefs.bigFirstParagraph);
     appendFormat_String(str, "prefs.sideicon.changed arg:%d\n", d->prefs.sideIcon);
@@ -231,11 +242,7 @@ static void loadPrefs_App_(iApp *d) {
 
 static void savePrefs_App_(const iApp *d) {
     iString *cfg = serializePrefs_App_(d);
-    iFile *f = new_File(prefsFileName_());
-    if (open_File(f, writeOnly_FileMode | text_FileMode)) {
-        write_File(f, &cfg->chars);
-    }
-    iRelease(f);
+    submitText_Saver(prefsFileName_(), cfg);
     delete_String(cfg);
 }
 
@@ -246,31 +253,62 @@ static iBool loadState_App_(iApp *d) {
     iUnused(d);
     iFile *f = iClob(newCStr_File(concatPath_CStr(dataDir_App_, stateFileName_App_)));
     if (open_File(f, readOnly_FileMode)) {
+        /* The file is read in one go. Background tabs keep a reference to this data and
+           are deserialized only when they are first shown. */
+        iBlock * state = collect_Block(readAll_File(f));
+        iBuffer *buf   = iClob(new_Buffer());
+        open_Buffer(buf, state);
+        iStream *ins = stream_Buffer(buf);
         char magic[4];
-        readData_File(f, 4, magic);
+        readData_Buffer(buf, 4, magic);
         if (memcmp(magic, magicState_App_, 4)) {
             printf("%s: format not recognized\n", cstr_String(path_File(f)));
             return iFalse;
         }
-        const uint32_t version = readU32_File(f);
+        const uint32_t version = readU32_Stream(ins);
         /* Check supported versions. */
         if (version > latest_FileVersion) {
             printf("%s: unsupported version\n", cstr_String(path_File(f)));
             return iFalse;
         }
-        setVersion_Stream(stream_File(f), version);
+        setVersion_Stream(ins, version);
         iDocumentWidget *doc = document_App();
         iDocumentWidget *current = NULL;
-        while (!atEnd_File(f)) {
-            readData_File(f, 4, magic);
+        while (!atEnd_Buffer(buf)) {
+            readData_Buffer(buf, 4, magic);
             if (!memcmp(magic, magicTabDocument_App_, 4)) {
                 if (!doc) {
-                    doc = newTab_App(NULL, iTrue);
+                    doc = newTab_App(NULL, iFalse);
                 }
-                if (read8_File(f)) {
+                const iBool isCurrent = read8_Stream(ins) != 0;
+                if (isCurrent) {
                     current = doc;
                 }
-                deserializeState_DocumentWidget(doc, stream_File(f));
+                /* The title is shown on the tab until the tab is materialized. */
+                iString *title    = collect_String(new_String());
+                iChar    siteIcon = 0;
+                if (version >= titledTabSections_FileVersion) {
+                    deserialize_String(title, ins);
+                    siteIcon = readU32_Stream(ins);
+                }
+                if (version >= indexedTabSections_FileVersion) {
+                    const size_t size = readU32_Stream(ins);
+                    const size_t pos  = pos_Stream(ins);
+                    if (pos + size > size_Block(state)) {
+                        printf("%s: truncated data\n", cstr_String(path_File(f)));
+                        break;
+                    }
+                    if (isCurrent || version != latest_FileVersion) {
+                        deserializeState_DocumentWidget(doc, ins);
+                    }
+                    else {
+                        deserializeStateLater_DocumentWidget(doc, state, pos, size, title, siteIcon);
+                    }
+                    seek_Stream(ins, pos + size);
+                }
+                else {
+                    deserializeState_DocumentWidget(doc, ins);
+                }
                 doc = NULL;
             }
             else {
@@ -297,19 +335,31 @@ iObjectList *listDocuments_App(void) {
 
 static void saveState_App_(const iApp *d) {
     iUnused(d);
-    iFile *f = newCStr_File(concatPath_CStr(dataDir_App_, stateFileName_App_));
-    if (open_File(f, writeOnly_FileMode)) {
-        writeData_File(f, magicState_App_, 4);
-        writeU32_File(f, latest_FileVersion); /* version */
-        iConstForEach(ObjectList, i, iClob(listDocuments_App())) {
-            if (isInstance_Object(i.object, &Class_DocumentWidget)) {
-                writeData_File(f, magicTabDocument_App_, 4);
-                write8_File(f, document_App() == i.object ? 1 : 0);
-                serializeState_DocumentWidget(i.object, stream_File(f));
-            }
+    iBuffer *buf = new_Buffer();
+    openEmpty_Buffer(buf);
+    iStream *outs = stream_Buffer(buf);
+    writeData_Stream(outs, magicState_App_, 4);
+    writeU32_Stream(outs, latest_FileVersion); /* version */
+    iConstForEach(ObjectList, i, iClob(listDocuments_App())) {
+        if (isInstance_Object(i.object, &Class_DocumentWidget)) {
+            writeData_Stream(outs, magicTabDocument_App_, 4);
+            write8_Stream(outs, document_App() == i.object ? 1 : 0);
+            iChar siteIcon;
+            serialize_String(savedTitle_DocumentWidget(i.object, &siteIcon), outs);
+            writeU32_Stream(outs, siteIcon);
+            /* Size of the section is filled in afterwards so it can be skipped when
+               loading. */
+            const size_t sizePos = pos_Stream(outs);
+            writeU32_Stream(outs, 0);
+            serializeState_DocumentWidget(i.object, outs);
+            const size_t endPos = pos_Stream(outs);
+            seek_Stream(outs, sizePos);
+            writeU32_Stream(outs, (uint32_t) (endPos - sizePos - 4));
+            seek_Stream(outs, endPos);
         }
     }
-    iRelease(f);
+    submitCStr_Saver(concatPath_CStr(dataDir_App_, stateFileName_App_), data_Buffer(buf));
+    iRelease(buf);
 }
 
 static void init_App_(iApp *d, int argc, char **argv) {
@@ -329,6 +379,10 @@ static void init_App_(iApp *d, int argc, char **argv) {
         }
         SDL_free(exec);
     }
+    init_Profiler();
+    init_Saver();
+    init_Decoder();
+    init_ImageCache();
     init_SortedArray(&d->tickers, sizeof(iTicker), cmp_Ticker_);
     d->lastTickerTime         = SDL_GetTicks();
     d->elapsedSinceLastTicker = 0;
@@ -344,6 +398,10 @@ static void init_App_(iApp *d, int argc, char **argv) {
     d->running           = iFalse;
     d->window            = NULL;
     set_Atomic(&d->pendingRefresh, iFalse);
+    d->frameInterval     = 1000000 / 60;
+    d->frameStart        = 0;
+    d->isInFrame         = iFalse;
+    d->drawTime          = 0;
     d->mimehooks         = new_MimeHooks();
     d->certs             = new_GmCerts(dataDir_App_);
     d->visited           = new_Visited();
@@ -439,12 +497,17 @@ static void deinit_App(iApp *d) {
     delete_GmCerts(d->certs);
     save_MimeHooks(d->mimehooks);
     delete_MimeHooks(d->mimehooks);
+    flush_Saver(); /* everything is on disk before the rest of the teardown */
     deinit_SortedArray(&d->tickers);
+    deinit_ImageCache(); /* before the renderer is destroyed */
     delete_Window(d->window);
     d->window = NULL;
     deinit_CommandLine(&d->args);
     iRelease(d->launchCommands);
     delete_String(d->execPath);
+    deinit_Decoder();
+    deinit_Saver(); /* wait for pending writes */
+    deinit_Profiler();
     iRecycle();
 }
 
@@ -486,6 +549,7 @@ void processEvents_App(enum iAppEventMode eventMode) {
             SDL_WaitEvent(&ev)) ||
            ((!isWaitingAllowed_App_(d) || eventMode == postedEventsOnly_AppEventMode) &&
             SDL_PollEvent(&ev))) {
+        const uint64_t profileTime = begin_Profiler();
         switch (ev.type) {
             case SDL_QUIT:
                 d->running = iFalse;
@@ -508,12 +572,19 @@ void processEvents_App(enum iAppEventMode eventMode) {
                 break;
             }
             default: {
+                const iBool isCommand =
+                    (ev.type == SDL_USEREVENT && ev.user.code == command_UserEventCode);
+                const iCommand *outerCommand = NULL;
+                if (isCommand) {
+                    /* Handlers can now use the already parsed form. */
+                    outerCommand = setDispatched_Command(ev.user.data1);
+                }
                 iBool wasUsed = processEvent_Window(d->window, &ev);
                 if (!wasUsed) {
                     /* There may be a key bindings for this. */
                     wasUsed = processEvent_Keys(&ev);
                 }
-                if (ev.type == SDL_USEREVENT && ev.user.code == command_UserEventCode) {
+                if (isCommand) {
 #if defined (iPlatformApple) && !defined (iPlatformIOS)
                     handleCommand_MacOS(command_UserEvent(&ev));
 #endif
@@ -521,19 +592,26 @@ void processEvents_App(enum iAppEventMode eventMode) {
                         arrange_Widget(d->window->root);
                     }
                     if (!wasUsed) {
-                        /* No widget handled the command, so we'll do it. */
-                        handleCommand_App(ev.user.data1);
+                        /* No widget handled the command, so we'll do it. App-level state
+                           may be shown anywhere in the window. */
+                        if (handleCommand_App(command_UserEvent(&ev))) {
+                            postRefresh_App();
+                        }
                     }
                     /* Allocated by postCommand_Apps(). */
-                    free(ev.user.data1);
+                    delete_Command(ev.user.data1);
+                    setDispatched_Command(outerCommand);
                 }
                 break;
             }
         }
+        end_Profiler(events_ProfileZone, profileTime);
     }
 backToMainLoop:;
 }
 
+static void postRefreshEvent_App_(iApp *d);
+
 static void runTickers_App_(iApp *d) {
     const uint32_t now = SDL_GetTicks();
     d->elapsedSinceLastTicker = (d->lastTickerTime ? now - d->lastTickerTime : 0);
@@ -545,7 +623,7 @@ static void runTickers_App_(iApp *d) {
     /* Tickers may add themselves again, so we'll run off a copy. */
     iSortedArray *pending = copy_SortedArray(&d->tickers);
     clear_SortedArray(&d->tickers);
-    postRefresh_App();
+    postRefreshEvent_App_(d); /* tickers refresh the widgets they animate */
     iConstForEach(Array, i, &pending->values) {
         const iTicker *ticker = i.value;
         if (ticker->callback) {
@@ -566,9 +644,10 @@ static int resizeWatcher_(void *user, SDL_Event *event) {
         resetFonts_Text(); {
             SDL_Event u = { .type = SDL_USEREVENT };
             u.user.code = command_UserEventCode;
-            u.user.data1 = strdup("theme.changed");
+            u.user.data1 = new_Command("theme.changed");
             u.user.windowID = SDL_GetWindowID(d->window->win);
             dispatchEvent_Widget(d->window->root, &u);
+            delete_Command(u.user.data1);
         }
 #endif
         drawWhileResizing_Window(d->window, winev->data1, winev->data2);
@@ -576,15 +655,63 @@ static int resizeWatcher_(void *user, SDL_Event *event) {
     return 0;
 }
 
+static uint64_t nowMicros_App_(void) {
+    return (uint64_t) (SDL_GetPerformanceCounter() * 1.0e6 / SDL_GetPerformanceFrequency());
+}
+
+static void updateFrameInterval_App_(iApp *d) {
+    SDL_DisplayMode mode;
+    if (d->window && SDL_GetWindowDisplayMode(d->window->win, &mode) == 0 &&
+        mode.refresh_rate > 0) {
+        d->frameInterval = 1000000 / mode.refresh_rate;
+    }
+}
+
+static void waitForFrame_App_(iApp *d) {
+    /* All refreshes requested before the next display refresh are handled in one frame, so
+       tickers and animations advance at most once per refresh. Events that don't cause any
+       drawing are handled without delay. */
+    const uint64_t now = nowMicros_App_();
+    const uint64_t due = d->frameStart + d->frameInterval;
+    const iBool    isDrawing = isRefreshPending_App() || !isEmpty_SortedArray(&d->tickers);
+    if (isDrawing && now + 1000 < due) {
+        SDL_Delay((uint32_t) (due - now) / 1000);
+        /* Input that arrived in the meantime goes in this frame. */
+        processEvents_App(postedEventsOnly_AppEventMode);
+    }
+    else if (now > due + 1000000) {
+        /* Was idle; the window may be on a different display now. */
+        updateFrameInterval_App_(d);
+    }
+}
+
+static void endFrame_App_(iApp *d, uint64_t drawStart) {
+    /* Waiting for vsync when presenting is not counted. */
+    const uint32_t drawTime = drawTime_Window(d->window);
+    if (drawTime) {
+        d->drawTime = (d->drawTime * 7 + drawTime) / 8;
+    }
+    if (drawStart - d->frameStart + drawTime > d->frameInterval) {
+        count_Profiler(missedFrame_ProfileCounter);
+    }
+}
+
 static int run_App_(iApp *d) {
     arrange_Widget(findWidget_App("root"));
     d->running = iTrue;
     SDL_EventState(SDL_DROPFILE, SDL_ENABLE); /* open files via drag'n'drop */
     SDL_AddEventWatch(resizeWatcher_, d);
+    updateFrameInterval_App_(d);
     while (d->running) {
         processEvents_App(waitForNewEvents_AppEventMode);
+        waitForFrame_App_(d);
+        d->frameStart = nowMicros_App_();
+        d->isInFrame  = iTrue;
         runTickers_App_(d);
+        const uint64_t drawStart = nowMicros_App_();
         refresh_App();
+        endFrame_App_(d, drawStart);
+        d->isInFrame  = iFalse;
         recycle_Garbage();
     }
     return 0;
@@ -601,6 +728,14 @@ iBool isRefreshPending_App(void) {
     return value_Atomic(&app_.pendingRefresh);
 }
 
+iBool isFrameLate_App(void) {
+    const iApp *d = &app_;
+    if (!d->isInFrame) {
+        return iFalse; /* handling events, there is a whole frame ahead */
+    }
+    return nowMicros_App_() - d->frameStart + d->drawTime > d->frameInterval;
+}
+
 uint32_t elapsedSinceLastTicker_App(void) {
     return app_.elapsedSinceLastTicker;
 }
@@ -647,8 +782,23 @@ int run_App(int argc, char **argv) {
     return rc;
 }
 
-void postRefresh_App(void) {
+void initHeadless_App(void) {
+    /* Only the state needed by documents and text rendering. Nothing is loaded from or
+       saved to the user's data directory. */
+    iApp *d = &app_;
+    init_Prefs(&d->prefs);
+    d->visited = new_Visited();
+    setThemePalette_Color(d->prefs.theme);
+}
+
+void deinitHeadless_App(void) {
     iApp *d = &app_;
+    delete_Visited(d->visited);
+    d->visited = NULL;
+    deinit_Prefs(&d->prefs);
+}
+
+static void postRefreshEvent_App_(iApp *d) {
     const iBool wasPending = exchange_Atomic(&d->pendingRefresh, iTrue);
     if (!wasPending) {
         SDL_Event ev;
@@ -661,6 +811,22 @@ void postRefresh_App(void) {
     }
 }
 
+void postRefresh_App(void) {
+    iApp *d = &app_;
+    if (d->window) {
+        damageAll_Window(d->window);
+    }
+    postRefreshEvent_App_(d);
+}
+
+void postRefreshRect_App(iRect rect) {
+    iApp *d = &app_;
+    if (d->window) {
+        addDamage_Window(d->window, rect);
+    }
+    postRefreshEvent_App_(d);
+}
+
 void postCommand_App(const char *command) {
     iApp *d = &app_;
     iAssert(command);
@@ -680,9 +846,13 @@ void postCommand_App(const char *command) {
     ev.user.type     = SDL_USEREVENT;
     ev.user.code     = command_UserEventCode;
     ev.user.windowID = get_Window() ? SDL_GetWindowID(get_Window()->win) : 0;
-    ev.user.data1    = strdup(command);
+    ev.user.data1    = new_Command(command);
     ev.user.data2    = NULL;
-    SDL_PushEvent(&ev);
+    if (SDL_PushEvent(&ev) != 1) {
+        /* The event was filtered out or the queue is full. */
+        delete_Command(ev.user.data1);
+        return;
+    }
     if (app_.commandEcho) {
         printf("[command] %s\n", command); fflush(stdout);
     }
@@ -707,7 +877,7 @@ iAny *findWidget_App(const char *id) {
 void addTicker_App(iTickerFunc ticker, iAny *context) {
     iApp *d = &app_;
     insert_SortedArray(&d->tickers, &(iTicker){ context, ticker });
-    postRefresh_App();
+    postRefreshEvent_App_(d);
 }
 
 void removeTicker_App(iTickerFunc ticker, iAny *context) {
@@ -976,6 +1146,28 @@ iBool handleCommand_App(const char *cmd) {
         SDL_MaximizeWindow(d->window->win);
         return iTrue;
     }
+    else if (equal_Command(cmd, "window.flashdamage")) {
+        setFlashDamage_Window(d->window, !d->window->isFlashingDamage);
+        return iTrue;
+    }
+    else if (equal_Command(cmd, "profiler.toggle")) {
+        setEnabled_Profiler(!isEnabled_Profiler());
+        postRefresh_App();
+        return iTrue;
+    }
+    else if (equal_Command(cmd, "profiler.export")) {
+        iDate now;
+        initCurrent_Date(&now);
+        const iString *path = collect_String(concat_Path(
+            downloadDir_App(),
+            collect_String(format_Date(&now, "lagrange-trace_%Y-%m-%d_%H%M%S.json"))));
+        submit_Saver(path, utf8_String(collect_String(traceJson_Profiler())));
+        flush_Saver(); /* the message says it's saved */
+        makeMessage_Widget(uiHeading_ColorEscape "TRACE SAVED",
+                           format_CStr("%s\nOpen it in chrome://tracing or a compatible viewer.",
+                                       cstr_String(path)));
+        return iTrue;
+    }
     else if (equal_Command(cmd, "font.set")) {
         setFreezeDraw_Window(get_Window(), iTrue);
         d->prefs.font = arg_Command(cmd);
@@ -1020,6 +1212,10 @@ iBool handleCommand_App(const char *cmd) {
         d->prefs.loadImageInsteadOfScrolling = arg_Command(cmd);
         return iTrue;
     }
+    else if (equal_Command(cmd, "mediafetches.set")) {
+        d->prefs.maxMediaFetches = iClamp(arg_Command(cmd), 1, 16);
+        return iTrue;
+    }
     else if (equal_Command(cmd, "theme.set")) {
         const int isAuto = argLabel_Command(cmd, "auto");
         d->prefs.theme = arg_Command(cmd);
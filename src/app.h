@@ -25,6 +25,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 /* Application core: event loop, base event processing, audio synth. */
 
 #include <the_Foundation/objectlist.h>
+#include <the_Foundation/rect.h>
 #include <the_Foundation/string.h>
 #include <the_Foundation/time.h>
 
@@ -54,11 +55,14 @@ const iString *downloadDir_App  (void);
 const iString *debugInfo_App    (void);
 
 int         run_App                     (int argc, char **argv);
+void        initHeadless_App            (void); /* no window or user data (benchmarks) */
+void        deinitHeadless_App          (void);
 void        processEvents_App           (enum iAppEventMode mode);
 iBool       handleCommand_App           (const char *cmd);
 void        refresh_App                 (void);
 iBool       isRefreshPending_App        (void);
 uint32_t    elapsedSinceLastTicker_App  (void); /* milliseconds */
+iBool       isFrameLate_App             (void); /* postpone non-critical work if true */
 
 const iPrefs *      prefs_App           (void);
 iBool               forceSoftwareRender_App(void);
@@ -80,7 +84,8 @@ typedef void (*iTickerFunc)(iAny *);
 iAny *      findWidget_App      (const char *id);
 void        addTicker_App       (iTickerFunc ticker, iAny *context);
 void        removeTicker_App    (iTickerFunc ticker, iAny *context);
-void        postRefresh_App     (void);
+void        postRefresh_App     (void); /* redraws the whole window */
+void        postRefreshRect_App (iRect rect); /* empty rect: just presents a new frame */
 void        postCommand_App     (const char *command);
 void        postCommandf_App    (const char *command, ...);
 
@@ -52,18 +52,23 @@ void init_SampleBuf(iSampleBuf *d, SDL_AudioFormat format, size_t numChannels, s
     d->sampleSize  = SDL_AUDIO_BITSIZE(format) / 8 * numChannels;
     d->count       = count + 1; /* considered empty if head==tail */
     d->data        = malloc(d->sampleSize * d->count);
-    d->head        = 0;
-    d->tail        = 0;
-    init_Condition(&d->moreNeeded);
+    set_Atomic(&d->head, 0);
+    set_Atomic(&d->tail, 0);
+    set_Atomic(&d->isWriterWaiting, iFalse);
+    set_Atomic(&d->flushTo, 0);
+    d->moreNeeded  = SDL_CreateSemaphore(0);
 }
 
 void deinit_SampleBuf(iSampleBuf *d) {
-    deinit_Condition(&d->moreNeeded);
+    SDL_DestroySemaphore(d->moreNeeded);
     free(d->data);
 }
 
 size_t size_SampleBuf(const iSampleBuf *d) {
-    return d->head - d->tail;
+    /* Positions wrap around at `count`. */
+    const size_t head = value_Atomic(&d->head);
+    const size_t tail = value_Atomic(&d->tail);
+    return (head + d->count - tail) % d->count;
 }
 
 size_t vacancy_SampleBuf(const iSampleBuf *d) {
@@ -76,7 +81,7 @@ iBool isFull_SampleBuf(const iSampleBuf *d) {
 
 void write_SampleBuf(iSampleBuf *d, const void *samples, const size_t n) {
     iAssert(n <= vacancy_SampleBuf(d));
-    const size_t headPos = d->head % d->count;
+    const size_t headPos = value_Atomic(&d->head);
     const size_t avail   = d->count - headPos;
     if (n > avail) {
         const char *in = samples;
@@ -87,12 +92,45 @@ void write_SampleBuf(iSampleBuf *d, const void *samples, const size_t n) {
     else {
         memcpy(ptr_SampleBuf_(d, headPos), samples, d->sampleSize * n);
     }
-    d->head += n;
+    /* Publish the samples only after they have been copied. */
+    set_Atomic(&d->head, (headPos + n) % d->count);
+}
+
+size_t writeRegion_SampleBuf(iSampleBuf *d, void **ptr_out) {
+    /* Samples can be produced directly into the buffer; the region may be shorter than the
+       vacancy if it wraps around. */
+    const size_t headPos = value_Atomic(&d->head);
+    *ptr_out = ptr_SampleBuf_(d, headPos);
+    return iMin(vacancy_SampleBuf(d), d->count - headPos);
+}
+
+void commitWrite_SampleBuf(iSampleBuf *d, size_t n) {
+    iAssert(n <= vacancy_SampleBuf(d));
+    set_Atomic(&d->head, (value_Atomic(&d->head) + n) % d->count);
+}
+
+void waitVacancy_SampleBuf(iSampleBuf *d) {
+    set_Atomic(&d->isWriterWaiting, iTrue);
+    /* The reader may have made room after the flag was set, so check again. */
+    if (isFull_SampleBuf(d)) {
+        SDL_SemWait(d->moreNeeded);
+    }
+    set_Atomic(&d->isWriterWaiting, iFalse);
+}
+
+void wakeWriter_SampleBuf(iSampleBuf *d) {
+    SDL_SemPost(d->moreNeeded);
+}
+
+void flush_SampleBuf(iSampleBuf *d) {
+    /* Only the reader may move the tail, so it is asked to skip ahead to the current head.
+       Until then, the flushed samples still count as occupied. */
+    set_Atomic(&d->flushTo, value_Atomic(&d->head) + 1);
 }
 
 void read_SampleBuf(iSampleBuf *d, const size_t n, void *samples_out) {
     iAssert(n <= size_SampleBuf(d));
-    const size_t tailPos = d->tail % d->count;
+    const size_t tailPos = value_Atomic(&d->tail);
     const size_t avail   = d->count - tailPos;
     if (n > avail) {
         char *out = samples_out;
@@ -103,5 +141,18 @@ void read_SampleBuf(iSampleBuf *d, const size_t n, void *samples_out) {
     else {
         memcpy(samples_out, ptr_SampleBuf_(d, tailPos), d->sampleSize * n);
     }
-    d->tail += n;
+    set_Atomic(&d->tail, (tailPos + n) % d->count);
+    if (exchange_Atomic(&d->isWriterWaiting, iFalse)) {
+        SDL_SemPost(d->moreNeeded); /* doesn't block */
+    }
+}
+
+void applyFlush_SampleBuf(iSampleBuf *d) {
+    const int flushTo = exchange_Atomic(&d->flushTo, 0);
+    if (flushTo) {
+        set_Atomic(&d->tail, flushTo - 1);
+        if (exchange_Atomic(&d->isWriterWaiting, iFalse)) {
+            SDL_SemPost(d->moreNeeded);
+        }
+    }
 }
@@ -22,10 +22,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #pragma once
 
+#include "the_Foundation/atomic.h"
 #include "the_Foundation/block.h"
 #include "the_Foundation/mutex.h"
 
 #include <SDL_audio.h>
+#include <SDL_mutex.h>
 
 iDeclareType(InputBuf)
 iDeclareType(SampleBuf)
@@ -50,14 +52,24 @@ size_t  size_InputBuf   (const iInputBuf *);
 
 /*----------------------------------------------------------------------------------------------*/
 
+/* Single-producer, single-consumer ring buffer. The decoder thread writes and the audio
+   callback reads without locking: each side only modifies its own position, which the other
+   side reads atomically. When the buffer is full, the writer sleeps on a semaphore that the
+   reader posts after making room, so the callback never blocks. When seeking, the writer
+   flushes the buffer by marking the samples written so far for discarding; the reader drops
+   them the next time it runs. */
+
 struct Impl_SampleBuf {
     SDL_AudioFormat format;
     uint8_t         numChannels;
     uint8_t         sampleSize; /* as bytes; one sample includes values for all channels */
     void *          data;
     size_t          count;
-    size_t          head, tail;
-    iCondition      moreNeeded;
+    iAtomicInt      head;       /* next position to write, modified only by the writer */
+    iAtomicInt      tail;       /* next position to read, modified only by the reader */
+    iAtomicInt      isWriterWaiting;
+    iAtomicInt      flushTo;    /* position + 1 up to which to discard samples, or zero */
+    SDL_sem *       moreNeeded;
 };
 
 iDeclareTypeConstructionArgs(SampleBuf, SDL_AudioFormat format, size_t numChannels, size_t count)
@@ -70,5 +82,11 @@ iLocalDef void *ptr_SampleBuf_(iSampleBuf *d, size_t pos) {
     return ((char *) d->data) + (d->sampleSize * pos);
 }
 
-void    write_SampleBuf     (iSampleBuf *, const void *samples, const size_t n);
-void    read_SampleBuf      (iSampleBuf *, const size_t n, void *samples_out);
+void    write_SampleBuf     (iSampleBuf *, const void *samples, const size_t n); /* writer */
+size_t  writeRegion_SampleBuf(iSampleBuf *, void **ptr_out); /* writer; contiguous vacancy */
+void    commitWrite_SampleBuf(iSampleBuf *, size_t n); /* writer; after filling a region */
+void    waitVacancy_SampleBuf(iSampleBuf *); /* writer; returns when not full or woken up */
+void    flush_SampleBuf     (iSampleBuf *); /* writer; discards everything written so far */
+void    read_SampleBuf      (iSampleBuf *, const size_t n, void *samples_out); /* reader */
+void    applyFlush_SampleBuf(iSampleBuf *); /* reader; call before checking the size */
+void    wakeWriter_SampleBuf(iSampleBuf *);
@@ -0,0 +1,160 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "convert.h"
+
+
+#if defined (__SSE2__)
+#   include <emmintrin.h>
+#   define LAGRANGE_AUDIO_SSE2
+#elif defined (__ARM_NEON)
+#   include <arm_neon.h>
+#   define LAGRANGE_AUDIO_NEON
+#endif
+
+/* Each kernel handles as many values as possible with vector instructions, and the rest
+   with the scalar loop, which is also the fallback on other architectures. */
+
+void gainF32_Audio(float *out, const float *in, size_t n, float gain) {
+    size_t i = 0;
+#if defined (LAGRANGE_AUDIO_SSE2)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+    }
+#elif defined (LAGRANGE_AUDIO_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vld1q_f32(in + i), gain));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = in[i] * gain;
+    }
+}
+
+void gainF64ToF32_Audio(float *out, const double *in, size_t n, float gain) {
+    size_t i = 0;
+#if defined (LAGRANGE_AUDIO_SSE2)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= n; i += 4) {
+        const __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+        const __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_movelh_ps(lo, hi), g));
+    }
+#elif defined (LAGRANGE_AUDIO_NEON) && defined (__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t v = vcombine_f32(vcvt_f32_f64(vld1q_f64(in + i)),
+                                           vcvt_f32_f64(vld1q_f64(in + i + 2)));
+        vst1q_f32(out + i, vmulq_n_f32(v, gain));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = (float) in[i] * gain;
+    }
+}
+
+void gainS16_Audio(int16_t *out, const int16_t *in, size_t n, float gain) {
+    size_t i = 0;
+#if defined (LAGRANGE_AUDIO_SSE2)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v  = _mm_loadu_si128((const __m128i *) (in + i));
+        /* Sign-extend to 32 bits by placing the values in the high halves. */
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        const __m128i a  = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+        const __m128i b  = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(a, b));
+    }
+#elif defined (LAGRANGE_AUDIO_NEON)
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(in + i);
+        const int32x4_t a =
+            vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), gain));
+        const int32x4_t b =
+            vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), gain));
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = (int16_t) (in[i] * gain);
+    }
+}
+
+void gainS24ToS16_Audio(int16_t *out, const uint8_t *in, size_t n, float gain) {
+    /* The low byte of each little-endian value is dropped. */
+    for (size_t i = 0; i < n; i++, in += 3) {
+        const int16_t value = (int16_t) (in[1] | (in[2] << 8));
+        out[i] = (int16_t) (value * gain);
+    }
+}
+
+void gainS32_Audio(int32_t *out, const int32_t *in, size_t n, float gain) {
+    /* Doubles keep the full 32-bit precision. */
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (int32_t) (in[i] * (double) gain);
+    }
+}
+
+void gainU8_Audio(uint8_t *out, const uint8_t *in, size_t n, float gain) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (uint8_t) ((int) (in[i] - 127) * gain + 127);
+    }
+}
+
+void interleaveF32_Audio(float *out, const float *const *channels, size_t numChannels, size_t n,
+                         float gain) {
+    size_t i = 0;
+    if (numChannels == 1) {
+        gainF32_Audio(out, channels[0], n, gain);
+        return;
+    }
+    if (numChannels == 2) {
+        const float *left  = channels[0];
+        const float *right = channels[1];
+#if defined (LAGRANGE_AUDIO_SSE2)
+        const __m128 g = _mm_set1_ps(gain);
+        for (; i + 4 <= n; i += 4) {
+            const __m128 l = _mm_mul_ps(_mm_loadu_ps(left + i), g);
+            const __m128 r = _mm_mul_ps(_mm_loadu_ps(right + i), g);
+            _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+        }
+#elif defined (LAGRANGE_AUDIO_NEON)
+        for (; i + 4 <= n; i += 4) {
+            const float32x4x2_t lr = { { vmulq_n_f32(vld1q_f32(left + i), gain),
+                                         vmulq_n_f32(vld1q_f32(right + i), gain) } };
+            vst2q_f32(out + 2 * i, lr);
+        }
+#endif
+        for (; i < n; i++) {
+            out[2 * i]     = left[i] * gain;
+            out[2 * i + 1] = right[i] * gain;
+        }
+        return;
+    }
+    for (; i < n; i++) {
+        for (size_t c = 0; c < numChannels; c++) {
+            *out++ = channels[c][i] * gain;
+        }
+    }
+}
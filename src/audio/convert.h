@@ -0,0 +1,40 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#pragma once
+
+/* Sample format conversion with gain. These are used by the decoder thread to write
+   samples straight into the output buffer. `n` is the number of values, i.e., samples
+   times channels. The output may not overlap the input, unless they are the same. */
+
+#include <the_Foundation/defs.h>
+
+void    gainF32_Audio       (float *out, const float *in, size_t n, float gain);
+void    gainF64ToF32_Audio  (float *out, const double *in, size_t n, float gain);
+void    gainS16_Audio       (int16_t *out, const int16_t *in, size_t n, float gain);
+void    gainS24ToS16_Audio  (int16_t *out, const uint8_t *in, size_t n, float gain);
+void    gainS32_Audio       (int32_t *out, const int32_t *in, size_t n, float gain);
+void    gainU8_Audio        (uint8_t *out, const uint8_t *in, size_t n, float gain);
+
+/* Interleaves planar channels (e.g., from stb_vorbis). `n` is the number of samples. */
+void    interleaveF32_Audio (float *out, const float *const *channels, size_t numChannels,
+                             size_t n, float gain);
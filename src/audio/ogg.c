@@ -0,0 +1,169 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "ogg.h"
+
+#include <string.h>
+
+iBool isPage_Ogg(const uint8_t *data, size_t size) {
+    return size >= headerSize_OggPage && !memcmp(data, "OggS", 4) && data[4] == 0;
+}
+
+int64_t granule_Ogg(const uint8_t *page) {
+    uint64_t granule = 0;
+    for (int i = 7; i >= 0; i--) {
+        granule = (granule << 8) | page[6 + i];
+    }
+    return (int64_t) granule;
+}
+
+uint32_t serial_Ogg(const uint8_t *page) {
+    return page[14] | (page[15] << 8) | (page[16] << 16) | ((uint32_t) page[17] << 24);
+}
+
+size_t pageSize_Ogg(const uint8_t *page, size_t avail) {
+    const size_t numSegments = page[26];
+    if (avail < headerSize_OggPage + numSegments) {
+        return 0;
+    }
+    size_t size = headerSize_OggPage + numSegments;
+    for (size_t i = 0; i < numSegments; i++) {
+        size += page[headerSize_OggPage + i];
+    }
+    return size <= avail ? size : 0;
+}
+
+static uint32_t crc_Ogg_(uint32_t crc, uint8_t byte) {
+    /* CRC-32 with polynomial 0x04c11db7, not reflected, as specified for Ogg. */
+    crc ^= (uint32_t) byte << 24;
+    for (int i = 0; i < 8; i++) {
+        crc = (crc << 1) ^ (crc & 0x80000000 ? 0x04c11db7 : 0);
+    }
+    return crc;
+}
+
+iBool isValidPage_Ogg(const uint8_t *page, size_t avail) {
+    /* The checksum is computed with its own field set to zero. */
+    if (!isPage_Ogg(page, avail)) {
+        return iFalse;
+    }
+    const size_t size = pageSize_Ogg(page, avail);
+    if (!size) {
+        return iFalse;
+    }
+    uint32_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc = crc_Ogg_(crc, i >= 22 && i < 26 ? 0 : page[i]);
+    }
+    return crc == (page[22] | (page[23] << 8) | (page[24] << 16) | ((uint32_t) page[25] << 24));
+}
+
+size_t headerSize_Ogg(const uint8_t *data, size_t size) {
+    /* Vorbis header packets are on pages with a zero granule position; the first page
+       with audio ends the headers. Returns zero if the headers are not complete yet. */
+    size_t pos = 0;
+    while (isPage_Ogg(data + pos, size - pos)) {
+        const size_t pageSize = pageSize_Ogg(data + pos, size - pos);
+        if (!pageSize) {
+            break;
+        }
+        if (pos > 0 && granule_Ogg(data + pos) != 0) {
+            return pos;
+        }
+        pos += pageSize;
+    }
+    return 0;
+}
+
+uint64_t lastGranule_Ogg(const uint8_t *data, size_t size) {
+    /* The granule position of the last page is the total number of samples. Only the
+       end of the stream needs to be looked at. The capture pattern may also occur inside
+       packet data, and a chained stream may end with pages of another logical stream, so
+       only intact pages of the first stream are trusted. */
+    if (!isPage_Ogg(data, size)) {
+        return 0;
+    }
+    const uint32_t serial = serial_Ogg(data);
+    const size_t   start  = size > maxSize_OggPage ? size - maxSize_OggPage : 0;
+    for (size_t pos = size >= headerSize_OggPage ? size - headerSize_OggPage + 1 : 0;
+         pos-- > start; ) {
+        if (isPage_Ogg(data + pos, size - pos) && serial_Ogg(data + pos) == serial &&
+            isValidPage_Ogg(data + pos, size - pos)) {
+            const int64_t granule = granule_Ogg(data + pos);
+            if (granule > 0) { /* -1 means no packet ends on the page */
+                return (uint64_t) granule;
+            }
+        }
+    }
+    return 0;
+}
+
+static size_t nextPage_Ogg_(const uint8_t *data, size_t size, size_t pos) {
+    /* Finds the next complete page that has a granule position. Returns `size` if there
+       isn't one. */
+    for (; pos + headerSize_OggPage <= size; pos++) {
+        if (isPage_Ogg(data + pos, size - pos) && pageSize_Ogg(data + pos, size - pos) &&
+            granule_Ogg(data + pos) >= 0) {
+            return pos;
+        }
+    }
+    return size;
+}
+
+size_t seekPage_Ogg(const uint8_t *data, size_t size, uint64_t granule) {
+    /* Returns the position of the last complete page that ends at or before `granule`.
+       Granule positions grow with the byte position, so the data is bisected until the
+       remaining range is small enough to walk page by page. */
+    size_t lo = 0;
+    size_t hi = size;
+    while (hi - lo > 2 * maxSize_OggPage) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const size_t pos = nextPage_Ogg_(data, hi, mid);
+        if (pos < hi && (uint64_t) granule_Ogg(data + pos) <= granule) {
+            lo = pos;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    size_t found = lo;
+    for (size_t pos = lo; isPage_Ogg(data + pos, size - pos); ) {
+        const size_t pageSize = pageSize_Ogg(data + pos, size - pos);
+        if (!pageSize) {
+            break;
+        }
+        const int64_t pageGranule = granule_Ogg(data + pos);
+        if (pageGranule >= 0) {
+            if ((uint64_t) pageGranule > granule) {
+                break;
+            }
+            found = pos;
+        }
+        pos += pageSize;
+    }
+    return found;
+}
+
+uint64_t seekDiscard_Ogg(uint64_t target, uint64_t end, uint64_t numDecoded) {
+    const uint64_t start = end > numDecoded ? end - numDecoded : 0;
+    return target > start ? iMin(target - start, numDecoded) : 0;
+}
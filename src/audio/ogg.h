@@ -0,0 +1,49 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#pragma once
+
+/* Ogg pages start with a 27-byte header: "OggS", version, flags, 64-bit granule position,
+   serial, sequence, checksum, and the number of segments followed by the segment table.
+   These look at the raw pages so the player can find its way in a stream that is still
+   being downloaded. */
+
+#include <the_Foundation/defs.h>
+
+enum {
+    headerSize_OggPage = 27,
+    maxSize_OggPage    = headerSize_OggPage + 255 + 255 * 255,
+};
+
+iBool       isPage_Ogg          (const uint8_t *data, size_t size); /* capture pattern only */
+iBool       isValidPage_Ogg     (const uint8_t *page, size_t avail); /* complete, checksum OK */
+int64_t     granule_Ogg         (const uint8_t *page); /* -1 if no packet ends on the page */
+uint32_t    serial_Ogg          (const uint8_t *page);
+size_t      pageSize_Ogg        (const uint8_t *page, size_t avail); /* zero if incomplete */
+
+size_t      headerSize_Ogg      (const uint8_t *data, size_t size);
+uint64_t    lastGranule_Ogg     (const uint8_t *data, size_t size);
+size_t      seekPage_Ogg        (const uint8_t *data, size_t size, uint64_t granule);
+
+/* After seeking to a page, `numDecoded` samples have been decoded and the position just past
+   them is `end`. Returns how many of them precede `target` and should be dropped. */
+uint64_t    seekDiscard_Ogg     (uint64_t target, uint64_t end, uint64_t numDecoded);
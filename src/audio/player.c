@@ -22,6 +22,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "player.h"
 #include "buf.h"
+#include "convert.h"
+#include "ogg.h"
 
 #define STB_VORBIS_HEADER_ONLY
 #include "stb_vorbis.c"
@@ -30,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <the_Foundation/thread.h>
 #include <SDL_audio.h>
 #include <SDL_timer.h>
+#include <limits.h>
 
 #if defined (LAGRANGE_ENABLE_MPG123)
 #  include <mpg123.h>
@@ -65,13 +68,19 @@ struct Impl_Decoder {
     SDL_AudioFormat   inputFormat;
     iInputBuf *       input;
     size_t            inputPos;
+    size_t            inputStartPos;
     size_t            totalInputSize;
     unsigned int      outputFreq;
     iSampleBuf        output;
-    iMutex            outputMutex;
     iArray            pendingOutput;
     uint64_t          currentSample;
     uint64_t          totalSamples; /* zero if unknown */
+    uint64_t          seekableSamples; /* how far the available input reaches */
+    iAtomicInt        seekRequest; /* target sample + 1, or zero */
+    iBool             isSeeking; /* holding decoded samples until their position is known */
+    uint64_t          seekTarget;
+    uint64_t          seekDecoded; /* samples held in `pendingOutput` while seeking */
+    size_t            scannedInputSize;
     iMutex            tagMutex;
     iString           tags[max_PlayerTag];
     stb_vorbis *      vorbis;
@@ -87,12 +96,45 @@ enum iDecoderStatus {
     needMoreInput_DecoderStatus,
 };
 
+/*----------------------------------------------------------------------------------------------*/
+
+static void convertWav_Decoder_(const iDecoder *d, void *out, const void *in, size_t n) {
+    const float gain = d->gain;
+    if (d->inputFormat == AUDIO_F64LSB) {
+        iAssert(d->output.format == AUDIO_F32);
+        gainF64ToF32_Audio(out, in, n, gain);
+    }
+    else if (d->inputFormat == AUDIO_F32) {
+        gainF32_Audio(out, in, n, gain);
+    }
+    else if (d->inputFormat == AUDIO_S24LSB) {
+        iAssert(d->output.format == AUDIO_S16);
+        gainS24ToS16_Audio(out, in, n, gain);
+    }
+    else {
+        switch (SDL_AUDIO_BITSIZE(d->output.format)) {
+            case 8:
+                gainU8_Audio(out, in, n, gain);
+                break;
+            case 16:
+                gainS16_Audio(out, in, n, gain);
+                break;
+            case 32:
+                gainS32_Audio(out, in, n, gain);
+                break;
+        }
+    }
+}
+
 static enum iDecoderStatus decodeWav_Decoder_(iDecoder *d, iRanges inputRange) {
     const uint8_t numChannels     = d->output.numChannels;
     const size_t  inputSampleSize = numChannels * SDL_AUDIO_BITSIZE(d->inputFormat) / 8;
     const size_t  vacancy         = vacancy_SampleBuf(&d->output);
-    const size_t  inputBytePos    = inputSampleSize * d->inputPos;
-    const size_t  avail           = (inputRange.end - inputBytePos) / inputSampleSize;
+    const size_t  inputBytePos    = d->inputStartPos + inputSampleSize * d->inputPos;
+    const size_t  avail           = inputRange.end > inputBytePos
+                                        ? (inputRange.end - inputBytePos) / inputSampleSize
+                                        : 0;
+    d->seekableSamples = d->inputPos + avail;
     if (avail == 0) {
         return needMoreInput_DecoderStatus;
     }
@@ -100,81 +142,32 @@ static enum iDecoderStatus decodeWav_Decoder_(iDecoder *d, iRanges inputRange) {
     if (n == 0) {
         return ok_DecoderStatus;
     }
-    void *samples = malloc(inputSampleSize * n);
-    /* Get a copy of the input for further processing. */ {
-        lock_Mutex(&d->input->mtx);
-        iAssert(inputSampleSize * d->inputPos < size_Block(&d->input->data));
-        memcpy(samples,
-               constData_Block(&d->input->data) + inputSampleSize * d->inputPos,
-               inputSampleSize * n);
-        d->inputPos += n;
-        unlock_Mutex(&d->input->mtx);
-    }
-    /* Gain. */ {
-        const float gain = d->gain;
-        if (d->inputFormat == AUDIO_F64LSB) {
-            iAssert(d->output.format == AUDIO_F32);
-            double *inValue  = samples;
-            float * outValue = samples;
-            for (size_t count = numChannels * n; count; count--) {
-                *outValue++ = gain * *inValue++;
-            }
-        }
-        else if (d->inputFormat == AUDIO_F32) {
-            float *value = samples;
-            for (size_t count = numChannels * n; count; count--, value++) {
-                *value *= gain;
-            }
-        }
-        else if (d->inputFormat == AUDIO_S24LSB) {
-            iAssert(d->output.format == AUDIO_S16);
-            const char *inValue  = samples;
-            int16_t *   outValue = samples;
-            for (size_t count = numChannels * n; count; count--, inValue += 3, outValue++) {
-                memcpy(outValue, inValue, 2);
-                *outValue *= gain;
-            }
-        }
-        else {
-            switch (SDL_AUDIO_BITSIZE(d->output.format)) {
-                case 8: {
-                    uint8_t *value = samples;
-                    for (size_t count = numChannels * n; count; count--, value++) {
-                        *value = (int) (*value - 127) * gain + 127;
-                    }
-                    break;
-                }
-                case 16: {
-                    int16_t *value = samples;
-                    for (size_t count = numChannels * n; count; count--, value++) {
-                        *value *= gain;
-                    }
-                    break;
-                }
-                case 32: {
-                    int32_t *value = samples;
-                    for (size_t count = numChannels * n; count; count--, value++) {
-                        *value *= gain;
-                    }
-                    break;
-                }
-            }
-        }
-    }
-    iGuardMutex(&d->outputMutex, write_SampleBuf(&d->output, samples, n));
+    /* Convert straight from the input to the output buffer. */
+    lock_Mutex(&d->input->mtx);
+    iAssert(inputBytePos < size_Block(&d->input->data));
+    for (size_t done = 0; done < n; ) {
+        void *       out;
+        const size_t count = iMin(n - done, writeRegion_SampleBuf(&d->output, &out));
+        convertWav_Decoder_(d,
+                            out,
+                            constData_Block(&d->input->data) + d->inputStartPos +
+                                inputSampleSize * d->inputPos,
+                            numChannels * count);
+        commitWrite_SampleBuf(&d->output, count);
+        d->inputPos += count;
+        done += count;
+    }
+    unlock_Mutex(&d->input->mtx);
     d->currentSample += n;
-    free(samples);
     return ok_DecoderStatus;
 }
 
 static void writePending_Decoder_(iDecoder *d) {
     /* Write as much as we can. */
-    lock_Mutex(&d->outputMutex);
     size_t avail = vacancy_SampleBuf(&d->output);
     size_t n = iMin(avail, size_Array(&d->pendingOutput));
     write_SampleBuf(&d->output, constData_Array(&d->pendingOutput), n);
     removeN_Array(&d->pendingOutput, 0, n);
-    unlock_Mutex(&d->outputMutex);
     d->currentSample += n;
 }
 
@@ -184,9 +177,15 @@ static enum iDecoderStatus decodeVorbis_Decoder_(iDecoder *d) {
         lock_Mutex(&d->input->mtx);
         int error;
         int consumed;
-        d->vorbis = stb_vorbis_open_pushdata(
-            constData_Block(input), size_Block(input), &consumed, &error, NULL);
+        const size_t headerSize = headerSize_Ogg(constData_Block(input), size_Block(input));
+        d->vorbis = headerSize ? stb_vorbis_open_pushdata(constData_Block(input),
+                                                          (int) headerSize,
+                                                          &consumed,
+                                                          &error,
+                                                          NULL)
+                               : NULL;
         if (!d->vorbis) {
+            unlock_Mutex(&d->input->mtx);
             return needMoreInput_DecoderStatus;
         }
         d->inputPos += consumed;
@@ -214,20 +213,31 @@ static enum iDecoderStatus decodeVorbis_Decoder_(iDecoder *d) {
         }
     }
     if (d->totalSamples == 0 && d->input->isComplete) {
-        /* Time to check the stream size. */
+        /* Time to check the stream size. The input doesn't change any more, so a shared
+           copy can be scanned without holding the lock. */
+        iBlock data;
         lock_Mutex(&d->input->mtx);
-        d->totalInputSize = size_Block(input);
-        int error = 0;
-        stb_vorbis *vrb = stb_vorbis_open_memory(constData_Block(input), size_Block(input),
-                                                 &error, NULL);
-        if (vrb) {
-            d->totalSamples = stb_vorbis_stream_length_in_samples(vrb);
-            stb_vorbis_close(vrb);
+        initCopy_Block(&data, input);
+        unlock_Mutex(&d->input->mtx);
+        d->totalInputSize = size_Block(&data);
+        d->totalSamples   = lastGranule_Ogg(constData_Block(&data), size_Block(&data));
+        deinit_Block(&data);
+    }
+    if (d->totalSamples) {
+        d->seekableSamples = d->totalSamples;
+    }
+    else {
+        /* Find out how far the downloaded pages reach. The end of the data is scanned only
+           after it has grown by a few pages. */
+        lock_Mutex(&d->input->mtx);
+        if (size_Block(input) >= d->scannedInputSize + maxSize_OggPage / 4) {
+            d->scannedInputSize = size_Block(input);
+            d->seekableSamples  = lastGranule_Ogg(constData_Block(input), size_Block(input));
         }
         unlock_Mutex(&d->input->mtx);
     }
     enum iDecoderStatus status = ok_DecoderStatus;
-    while (size_Array(&d->pendingOutput) < d->output.count) {
+    while (d->isSeeking || size_Array(&d->pendingOutput) < d->output.count) {
         /* Try to decode some input. */
         lock_Mutex(&d->input->mtx);
         int     count     = 0;
@@ -245,18 +255,35 @@ static enum iDecoderStatus decodeVorbis_Decoder_(iDecoder *d) {
             }
             else continue;
         }
-        /* Apply gain. */ {
-            const float gain = d->gain;
-            float sample[2];
-            for (size_t i = 0; i < (size_t) count; ++i) {
-                for (size_t chan = 0; chan < d->output.numChannels; chan++) {
-                    sample[chan] = samples[chan][i] * gain;
-                }
-                pushBack_Array(&d->pendingOutput, sample);
+        /* Interleave and apply gain. The array keeps its capacity, so this doesn't allocate
+           once playback is underway. */ {
+            const float *channels[2] = { samples[0], samples[d->output.numChannels - 1] };
+            const size_t pos = size_Array(&d->pendingOutput);
+            resize_Array(&d->pendingOutput, pos + count);
+            interleaveF32_Audio(at_Array(&d->pendingOutput, pos),
+                                channels,
+                                d->output.numChannels,
+                                count,
+                                d->gain);
+        }
+        /* After seeking, decoding resumes from a page boundary before the target. The
+           decoder may only learn its position when the page ends, so the samples are held
+           until then and the ones before the target are dropped. */
+        if (d->isSeeking) {
+            const int location = stb_vorbis_get_sample_offset(d->vorbis);
+            d->seekDecoded += count;
+            if (location >= 0) {
+                removeN_Array(&d->pendingOutput,
+                              0,
+                              seekDiscard_Ogg(d->seekTarget, (uint64_t) location, d->seekDecoded));
+                d->seekDecoded = 0;
+                d->isSeeking   = (uint64_t) location < d->seekTarget;
             }
         }
     }
-    writePending_Decoder_(d);
+    if (!d->isSeeking) {
+        writePending_Decoder_(d);
+    }
     return status;
 }
 
@@ -299,10 +326,7 @@ enum iDecoderStatus decodeMpeg_Decoder_(iDecoder *d) {
         int16_t buffer[512];
         size_t bytesRead = 0;
         const int rc = mpg123_read(d->mpeg, (uint8_t *) buffer, sizeof(buffer), &bytesRead);
-        const float gain = d->gain;
-        for (size_t i = 0; i < bytesRead / 2; i++) {
-            buffer[i] *= gain;
-        }
+        gainS16_Audio(buffer, buffer, bytesRead / 2, d->gain);
         pushBackN_Array(&d->pendingOutput, buffer, bytesRead / 2 / d->output.numChannels);
         if (rc == MPG123_NEED_MORE) {
             status = needMoreInput_DecoderStatus;
@@ -330,14 +354,81 @@ enum iDecoderStatus decodeMpeg_Decoder_(iDecoder *d) {
     if (off > 0) {
         d->totalSamples = off;
     }
+    /* Frames are indexed as they are parsed, so only the part already decoded can be seeked
+       into before the whole stream has arrived. */
+    d->seekableSamples = d->totalInputSize ? d->totalSamples
+                                           : iMax(d->seekableSamples, d->currentSample);
     writePending_Decoder_(d);
 #endif
     return status;
 }
 
+static void seek_Decoder_(iDecoder *d, uint64_t target) {
+    clear_Array(&d->pendingOutput);
+    d->isSeeking = iFalse;
+    switch (d->type) {
+        case wav_DecoderType: {
+            /* Samples are at fixed offsets in the data chunk. */
+            const size_t inputSampleSize =
+                d->output.numChannels * SDL_AUDIO_BITSIZE(d->inputFormat) / 8;
+            lock_Mutex(&d->input->mtx);
+            const size_t inputSize = size_InputBuf(d->input);
+            unlock_Mutex(&d->input->mtx);
+            const uint64_t avail = inputSize > d->inputStartPos
+                                       ? (inputSize - d->inputStartPos) / inputSampleSize
+                                       : 0;
+            d->inputPos = d->currentSample = iMin(target, avail);
+            break;
+        }
+        case vorbis_DecoderType: {
+            if (!d->vorbis) {
+                return;
+            }
+            /* Resume from the page that precedes the target. stb_vorbis resynchronizes on it,
+               but may not know the sample position until the following page ends. */
+            iBlock data;
+            lock_Mutex(&d->input->mtx);
+            initCopy_Block(&data, &d->input->data);
+            unlock_Mutex(&d->input->mtx);
+            d->inputPos = seekPage_Ogg(constData_Block(&data), size_Block(&data), target);
+            deinit_Block(&data);
+            stb_vorbis_flush_pushdata(d->vorbis);
+            d->isSeeking     = iTrue;
+            d->seekTarget    = target;
+            d->seekDecoded   = 0;
+            d->currentSample = target;
+            break;
+        }
+        case mpeg_DecoderType: {
+#if defined (LAGRANGE_ENABLE_MPG123)
+            if (!d->mpeg) {
+                return;
+            }
+            /* mpg123 looks up the frame in its seek index and tells where to continue
+               feeding from. */
+            off_t inputOffset = 0;
+            const off_t pos = mpg123_feedseek(d->mpeg, (off_t) target, SEEK_SET, &inputOffset);
+            if (pos < 0) {
+                return;
+            }
+            d->inputPos      = (size_t) inputOffset;
+            d->currentSample = (uint64_t) pos;
+#endif
+            break;
+        }
+        default:
+            return;
+    }
+    flush_SampleBuf(&d->output);
+}
+
 static iThreadResult run_Decoder_(iThread *thread) {
     iDecoder *d = userData_Thread(thread);
     while (d->type) {
+        const int seekRequest = exchange_Atomic(&d->seekRequest, 0);
+        if (seekRequest) {
+            seek_Decoder_(d, (uint64_t) (seekRequest - 1));
+        }
         /* Check amount of data available. */
         lock_Mutex(&d->input->mtx);
         size_t inputSize = size_InputBuf(d->input);
@@ -362,16 +453,13 @@ static iThreadResult run_Decoder_(iThread *thread) {
         }
         if (status == needMoreInput_DecoderStatus) {
             lock_Mutex(&d->input->mtx);
-            if (size_InputBuf(d->input) == inputSize) {
+            if (size_InputBuf(d->input) == inputSize && !value_Atomic(&d->seekRequest)) {
                 wait_Condition(&d->input->changed, &d->input->mtx);
             }
             unlock_Mutex(&d->input->mtx);
         }
-        else {
-            iGuardMutex(
-                &d->outputMutex, if (isFull_SampleBuf(&d->output)) {
-                    wait_Condition(&d->output.moreNeeded, &d->outputMutex);
-                });
+        else if (d->type) {
+            waitVacancy_SampleBuf(&d->output);
         }
     }
     return 0;
@@ -381,12 +469,19 @@ void init_Decoder(iDecoder *d, iInputBuf *input, const iContentSpec *spec) {
     d->type           = spec->type;
     d->gain           = 1.0f;
     d->input          = input;
-    d->inputPos       = spec->inputStartPos;
+    d->inputPos       = 0;
+    d->inputStartPos  = spec->inputStartPos;
     d->inputFormat    = spec->inputFormat;
     d->totalInputSize = spec->totalInputSize;
     d->outputFreq     = spec->output.freq;
     d->currentSample  = 0;
     d->totalSamples   = spec->totalSamples;
+    d->seekableSamples  = 0;
+    d->isSeeking        = iFalse;
+    d->seekTarget       = 0;
+    d->seekDecoded      = 0;
+    d->scannedInputSize = 0;
+    set_Atomic(&d->seekRequest, 0);
     init_Array(&d->pendingOutput, spec->output.channels * SDL_AUDIO_BITSIZE(spec->output.format) / 8);
     init_SampleBuf(&d->output,
                    spec->output.format,
@@ -402,7 +497,6 @@ void init_Decoder(iDecoder *d, iInputBuf *input, const iContentSpec *spec) {
     d->id3v1 = NULL;
     d->id3v2 = NULL;
 #endif
-    init_Mutex(&d->outputMutex);
     d->thread = new_Thread(run_Decoder_);
     setUserData_Thread(d->thread, d);
     start_Thread(d->thread);
@@ -410,11 +504,10 @@ void init_Decoder(iDecoder *d, iInputBuf *input, const iContentSpec *spec) {
 
 void deinit_Decoder(iDecoder *d) {
     d->type = none_DecoderType;
-    signal_Condition(&d->output.moreNeeded);
+    wakeWriter_SampleBuf(&d->output);
     signal_Condition(&d->input->changed);
     join_Thread(d->thread);
     iRelease(d->thread);
-    deinit_Mutex(&d->outputMutex);
     deinit_SampleBuf(&d->output);
     deinit_Array(&d->pendingOutput);
     iForIndices(i, d->tags) {
@@ -560,11 +653,15 @@ static iContentSpec contentSpec_Player_(const iPlayer *d) {
         }
     }
     else if (content.type == vorbis_DecoderType) {
-        /* Try to decode what we have and see if it looks like Vorbis. */
+        /* Try to decode the headers and see if it looks like Vorbis. */
         int consumed = 0;
         int error = 0;
+        const size_t headerSize = headerSize_Ogg(constData_Block(&d->data->data), dataSize);
+        if (!headerSize) {
+            return content;
+        }
         stb_vorbis *vrb = stb_vorbis_open_pushdata(
-            constData_Block(&d->data->data), size_Block(&d->data->data), &consumed, &error, NULL);
+            constData_Block(&d->data->data), (int) headerSize, &consumed, &error, NULL);
         if (!vrb) {
             return content;
         }
@@ -609,15 +706,14 @@ static void writeOutputSamples_Player_(void *plr, Uint8 *stream, int len) {
     iAssert(d->decoder);
     const size_t sampleSize = sampleSize_Player_(d);
     const size_t count      = len / sampleSize;
-    lock_Mutex(&d->decoder->outputMutex);
+    /* Runs in the audio thread: must not lock or wait for the decoder. */
+    applyFlush_SampleBuf(&d->decoder->output);
     if (size_SampleBuf(&d->decoder->output) >= count) {
         read_SampleBuf(&d->decoder->output, count, stream);
     }
     else {
         memset(stream, d->spec.silence, len);
     }
-    signal_Condition(&d->decoder->output.moreNeeded);
-    unlock_Mutex(&d->decoder->outputMutex);
 }
 
 void init_Player(iPlayer *d) {
@@ -719,6 +815,24 @@ void stop_Player(iPlayer *d) {
     }
 }
 
+void seek_Player(iPlayer *d, float time) {
+    if (!d->decoder) {
+        return;
+    }
+    iDecoder *dec    = d->decoder;
+    uint64_t  target = (uint64_t) iMax(0.0, (double) time * d->spec.freq);
+    if (dec->totalSamples) {
+        target = iMin(target, dec->totalSamples);
+    }
+    set_Atomic(&dec->seekRequest, (int) iMin(target, (uint64_t) INT_MAX - 1) + 1);
+    /* The decoder may be waiting for room in the output or for more input. */
+    wakeWriter_SampleBuf(&dec->output);
+    lock_Mutex(&d->data->mtx);
+    signal_Condition(&d->data->changed);
+    unlock_Mutex(&d->data->mtx);
+    setNotIdle_Player(d);
+}
+
 void setVolume_Player(iPlayer *d, float volume) {
     d->volume = iClamp(volume, 0, 1);
     if (d->decoder) {
@@ -760,6 +874,11 @@ float duration_Player(const iPlayer *d) {
     return (float) ((double) d->decoder->totalSamples / (double) d->spec.freq);
 }
 
+float seekableTime_Player(const iPlayer *d) {
+    if (!d->decoder) return 0;
+    return (float) ((double) d->decoder->seekableSamples / (double) d->spec.freq);
+}
+
 float streamProgress_Player(const iPlayer *d) {
     if (d->decoder && d->decoder->totalInputSize) {
         lock_Mutex(&d->data->mtx);
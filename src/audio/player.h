@@ -36,6 +36,7 @@ enum iPlayerUpdate {
 enum iPlayerFlag {
     adjustingVolume_PlayerFlag = iBit(1),
     volumeGrabbed_PlayerFlag   = iBit(2),
+    seekGrabbed_PlayerFlag     = iBit(3),
 };
 
 enum iPlayerTag {
@@ -52,6 +53,7 @@ void    updateSourceData_Player (iPlayer *, const iString *mimeType, const iBloc
 iBool   start_Player            (iPlayer *);
 void    stop_Player             (iPlayer *);
 void    setPaused_Player        (iPlayer *, iBool isPaused);
+void    seek_Player             (iPlayer *, float time);
 void    setVolume_Player        (iPlayer *, float volume);
 void    setFlags_Player         (iPlayer *, int flags, iBool set);
 void    setNotIdle_Player       (iPlayer *);
@@ -63,6 +65,7 @@ iBool   isPaused_Player         (const iPlayer *);
 float   volume_Player           (const iPlayer *);
 float   time_Player             (const iPlayer *);
 float   duration_Player         (const iPlayer *);
+float   seekableTime_Player     (const iPlayer *); /* how far the downloaded data reaches */
 float   streamProgress_Player   (const iPlayer *); /* normalized 0...1 */
 
 uint32_t    idleTimeMs_Player       (const iPlayer *);
@@ -21,6 +21,7 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "bookmarks.h"
+#include "saver.h"
 
 #include <the_Foundation/file.h>
 #include <the_Foundation/hash.h>
@@ -143,24 +144,21 @@ void load_Bookmarks(iBookmarks *d, const char *dirPath) {
 }
 
 void save_Bookmarks(const iBookmarks *d, const char *dirPath) {
+    iString *str = new_String();
     lock_Mutex(d->mtx);
-    iFile *f = newCStr_File(concatPath_CStr(dirPath, fileName_Bookmarks_));
-    if (open_File(f, writeOnly_FileMode | text_FileMode)) {
-        iString *str = collectNew_String();
-        iConstForEach(Hash, i, &d->bookmarks) {
-            const iBookmark *bm = (const iBookmark *) i.value;
-            format_String(str,
-                          "%08x %lf %s\n%s\n%s\n",
-                          bm->icon,
-                          seconds_Time(&bm->when),
-                          cstr_String(&bm->url),
-                          cstr_String(&bm->title),
-                          cstr_String(&bm->tags));
-            writeData_File(f, cstr_String(str), size_String(str));
-        }
+    iConstForEach(Hash, i, &d->bookmarks) {
+        const iBookmark *bm = (const iBookmark *) i.value;
+        appendFormat_String(str,
+                            "%08x %lf %s\n%s\n%s\n",
+                            bm->icon,
+                            seconds_Time(&bm->when),
+                            cstr_String(&bm->url),
+                            cstr_String(&bm->title),
+                            cstr_String(&bm->tags));
     }
-    iRelease(f);
     unlock_Mutex(d->mtx);
+    submitTextCStr_Saver(concatPath_CStr(dirPath, fileName_Bookmarks_), str);
+    delete_String(str);
 }
 
 void add_Bookmarks(iBookmarks *d, const iString *url, const iString *title, const iString *tags,
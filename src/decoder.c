@@ -0,0 +1,337 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "decoder.h"
+#include "app.h"
+
+#include <the_Foundation/mutex.h>
+#include <the_Foundation/ptrarray.h>
+#include <the_Foundation/thread.h>
+#include <stb_image.h>
+#include <SDL_cpuinfo.h>
+#include <math.h>
+
+iDeclareType(Decoder)
+iDeclareType(DecoderJob)
+
+struct Impl_DecoderJob {
+    iDecodedImage result;
+    iBlock        data;
+    iInt2         maxSize;
+    iBool         isCancelled;
+};
+
+static iDecoderJob *new_DecoderJob_(const void *owner, uint32_t id, const iBlock *data,
+                                    iInt2 maxSize) {
+    iDecoderJob *d = calloc(1, sizeof(iDecoderJob));
+    d->result.owner = owner;
+    d->result.id    = id;
+    d->maxSize      = maxSize;
+    initCopy_Block(&d->data, data); /* implicitly shared, not copied */
+    return d;
+}
+
+static void delete_DecoderJob_(iDecoderJob *d) {
+    deinit_DecodedImage(&d->result);
+    deinit_Block(&d->data);
+    free(d);
+}
+
+static iBool hasAlpha_(const uint8_t *rgba, size_t numPixels) {
+    uint8_t minAlpha = 0xff;
+    for (size_t i = 0; i < numPixels; i++) {
+        minAlpha &= rgba[4 * i + 3];
+    }
+    return minAlpha != 0xff;
+}
+
+static void reduceRow_(const uint8_t *src, int srcWidth, float *dst, int dstWidth, float weight) {
+    /* Box filter: each output pixel is the area average of the source pixels it covers.
+       Colors are premultiplied so transparent pixels don't bleed into the result. */
+    const float scale = (float) srcWidth / (float) dstWidth;
+    for (int x = 0; x < dstWidth; x++) {
+        const float start = x * scale;
+        const float end   = start + scale;
+        float acc[4] = { 0, 0, 0, 0 };
+        for (int sx = (int) start; sx < iMin(srcWidth, (int) ceilf(end)); sx++) {
+            const float    cover = iMin(end, sx + 1.0f) - iMax(start, (float) sx);
+            const uint8_t *px    = src + 4 * sx;
+            const float    a     = px[3] * cover;
+            acc[0] += px[0] * a;
+            acc[1] += px[1] * a;
+            acc[2] += px[2] * a;
+            acc[3] += a;
+        }
+        float *out = dst + 4 * x;
+        for (int c = 0; c < 4; c++) {
+            out[c] += acc[c] * weight;
+        }
+    }
+}
+
+static uint8_t *downscale_(const uint8_t *src, iInt2 srcSize, iInt2 dstSize) {
+    /* The output is produced one row at a time, so only one row of accumulators is needed
+       regardless of the source size. */
+    uint8_t *dst   = malloc(4 * (size_t) dstSize.x * dstSize.y);
+    float *  acc   = malloc(sizeof(float) * 4 * dstSize.x);
+    const float scale = (float) srcSize.y / (float) dstSize.y;
+    const float norm  = 1.0f / (scale * srcSize.x / dstSize.x);
+    for (int y = 0; y < dstSize.y; y++) {
+        const float start = y * scale;
+        const float end   = start + scale;
+        memset(acc, 0, sizeof(float) * 4 * dstSize.x);
+        for (int sy = (int) start; sy < iMin(srcSize.y, (int) ceilf(end)); sy++) {
+            const float cover = iMin(end, sy + 1.0f) - iMax(start, (float) sy);
+            reduceRow_(src + 4 * (size_t) sy * srcSize.x, srcSize.x, acc, dstSize.x, cover);
+        }
+        uint8_t *out = dst + 4 * (size_t) y * dstSize.x;
+        for (int x = 0; x < dstSize.x; x++) {
+            const float *a = acc + 4 * x;
+            if (a[3] > 0.0f) {
+                for (int c = 0; c < 3; c++) {
+                    out[4 * x + c] = (uint8_t) iMin(255.0f, a[c] / a[3] + 0.5f);
+                }
+                out[4 * x + 3] = (uint8_t) iMin(255.0f, a[3] * norm + 0.5f);
+            }
+            else {
+                memset(out + 4 * x, 0, 4);
+            }
+        }
+    }
+    free(acc);
+    return dst;
+}
+
+static void decode_DecoderJob_(iDecoderJob *d) {
+    iDecodedImage *img = &d->result;
+    img->pixels = stbi_load_from_memory(constData_Block(&d->data),
+                                        size_Block(&d->data),
+                                        &img->sourceSize.x,
+                                        &img->sourceSize.y,
+                                        NULL,
+                                        4);
+    clear_Block(&d->data);
+    if (!img->pixels) {
+        img->sourceSize = img->size = zero_I2();
+        return;
+    }
+    img->size = img->sourceSize;
+    /* Reduce to the size it will be displayed at, keeping the aspect ratio. */
+    float scale = 1.0f;
+    if (d->maxSize.x > 0 && img->size.x > d->maxSize.x) {
+        scale = (float) d->maxSize.x / img->size.x;
+    }
+    if (d->maxSize.y > 0 && img->size.y * scale > d->maxSize.y) {
+        scale = (float) d->maxSize.y / img->size.y;
+    }
+    if (scale < 1.0f) {
+        const iInt2 reduced = init_I2(iMax(1, (int) (img->size.x * scale + 0.5f)),
+                                      iMax(1, (int) (img->size.y * scale + 0.5f)));
+        uint8_t *pixels = downscale_(img->pixels, img->size, reduced);
+        stbi_image_free(img->pixels);
+        img->pixels = pixels;
+        img->size   = reduced;
+    }
+    img->hasAlpha = hasAlpha_(img->pixels, (size_t) img->size.x * img->size.y);
+}
+
+void deinit_DecodedImage(iDecodedImage *d) {
+    if (d->pixels) {
+        free(d->pixels); /* stbi_image_free() is free() */
+        d->pixels = NULL;
+    }
+}
+
+/*----------------------------------------------------------------------------------------------*/
+
+#define maxWorkers_Decoder_ 4
+
+struct Impl_Decoder {
+    iMutex *   mtx;
+    iCondition jobAvailable;
+    iThread *  workers[maxWorkers_Decoder_];
+    size_t     numWorkers;
+    iBool      stopWorkers;
+    iPtrArray  pending;  /* FIFO */
+    iPtrArray  active;   /* being decoded */
+    iPtrArray  finished;
+};
+
+static iDecoder decoder_;
+
+static void notify_Decoder_(const void *owner) {
+    postCommandf_App("media.decoded owner:%p", owner);
+}
+
+static iThreadResult run_Decoder_(iThread *thread) {
+    iDecoder *d = userData_Thread(thread);
+    lock_Mutex(d->mtx);
+    for (;;) {
+        while (isEmpty_PtrArray(&d->pending) && !d->stopWorkers) {
+            wait_Condition(&d->jobAvailable, d->mtx);
+        }
+        if (d->stopWorkers) {
+            break;
+        }
+        iDecoderJob *job;
+        take_PtrArray(&d->pending, 0, (void **) &job);
+        pushBack_PtrArray(&d->active, job);
+        unlock_Mutex(d->mtx);
+        decode_DecoderJob_(job);
+        lock_Mutex(d->mtx);
+        removeOne_PtrArray(&d->active, job);
+        if (job->isCancelled) {
+            delete_DecoderJob_(job);
+        }
+        else {
+            pushBack_PtrArray(&d->finished, job);
+            notify_Decoder_(job->result.owner);
+        }
+    }
+    unlock_Mutex(d->mtx);
+    return 0;
+}
+
+void init_Decoder(void) {
+    iDecoder *d = &decoder_;
+    d->mtx = new_Mutex();
+    init_Condition(&d->jobAvailable);
+    init_PtrArray(&d->pending);
+    init_PtrArray(&d->active);
+    init_PtrArray(&d->finished);
+    d->stopWorkers = iFalse;
+    /* Leave one core for the main thread. */
+    d->numWorkers = iClamp(SDL_GetCPUCount() - 1, 1, maxWorkers_Decoder_);
+    for (size_t i = 0; i < d->numWorkers; i++) {
+        d->workers[i] = new_Thread(run_Decoder_);
+        setUserData_Thread(d->workers[i], d);
+        start_Thread(d->workers[i]);
+    }
+}
+
+static void deleteAll_Decoder_(iPtrArray *jobs) {
+    iForEach(PtrArray, i, jobs) {
+        delete_DecoderJob_(i.ptr);
+    }
+    clear_PtrArray(jobs);
+}
+
+void deinit_Decoder(void) {
+    iDecoder *d = &decoder_;
+    if (!d->numWorkers) return;
+    iGuardMutex(d->mtx, {
+        d->stopWorkers = iTrue;
+        for (size_t i = 0; i < d->numWorkers; i++) {
+            signal_Condition(&d->jobAvailable);
+        }
+    });
+    for (size_t i = 0; i < d->numWorkers; i++) {
+        join_Thread(d->workers[i]);
+        iReleasePtr(&d->workers[i]);
+    }
+    d->numWorkers = 0;
+    deleteAll_Decoder_(&d->pending);
+    deleteAll_Decoder_(&d->finished);
+    iAssert(isEmpty_PtrArray(&d->active));
+    deinit_PtrArray(&d->finished);
+    deinit_PtrArray(&d->active);
+    deinit_PtrArray(&d->pending);
+    deinit_Condition(&d->jobAvailable);
+    delete_Mutex(d->mtx);
+}
+
+iBool probe_Decoder(const iBlock *data, iInt2 *size_out) {
+    int comp;
+    if (stbi_info_from_memory(
+            constData_Block(data), size_Block(data), &size_out->x, &size_out->y, &comp)) {
+        return iTrue;
+    }
+    *size_out = zero_I2();
+    return iFalse;
+}
+
+static iBool isMatch_DecoderJob_(const iDecoderJob *d, const void *owner, uint32_t id) {
+    return d->result.owner == owner && (id == 0 || d->result.id == id);
+}
+
+void submit_Decoder(const void *owner, uint32_t id, const iBlock *data, iInt2 maxSize) {
+    iDecoder *d = &decoder_;
+    iDecoderJob *job = new_DecoderJob_(owner, id, data, maxSize);
+    if (!d->numWorkers) {
+        /* Not running; decode immediately. */
+        decode_DecoderJob_(job);
+        pushBack_PtrArray(&d->finished, job);
+        notify_Decoder_(owner);
+        return;
+    }
+    cancel_Decoder(owner, id); /* only the latest data is relevant */
+    iGuardMutex(d->mtx, {
+        pushBack_PtrArray(&d->pending, job);
+        signal_Condition(&d->jobAvailable);
+    });
+}
+
+static void cancel_Decoder_(iPtrArray *jobs, const void *owner, uint32_t id) {
+    iForEach(PtrArray, i, jobs) {
+        if (isMatch_DecoderJob_(i.ptr, owner, id)) {
+            delete_DecoderJob_(i.ptr);
+            remove_PtrArrayIterator(&i);
+        }
+    }
+}
+
+void cancel_Decoder(const void *owner, uint32_t id) {
+    iDecoder *d = &decoder_;
+    if (!d->numWorkers) {
+        cancel_Decoder_(&d->finished, owner, id);
+        return;
+    }
+    lock_Mutex(d->mtx);
+    cancel_Decoder_(&d->pending, owner, id);
+    cancel_Decoder_(&d->finished, owner, id);
+    iForEach(PtrArray, i, &d->active) {
+        iDecoderJob *job = i.ptr;
+        if (isMatch_DecoderJob_(job, owner, id)) {
+            job->isCancelled = iTrue; /* the worker deletes it */
+        }
+    }
+    unlock_Mutex(d->mtx);
+}
+
+iBool takeFinished_Decoder(const void *owner, iDecodedImage *img_out) {
+    iDecoder *d = &decoder_;
+    iBool found = iFalse;
+    if (d->numWorkers) lock_Mutex(d->mtx);
+    iForEach(PtrArray, i, &d->finished) {
+        iDecoderJob *job = i.ptr;
+        if (job->result.owner == owner) {
+            *img_out = job->result;
+            job->result.pixels = NULL; /* ownership moves to caller */
+            delete_DecoderJob_(job);
+            remove_PtrArrayIterator(&i);
+            found = iTrue;
+            break;
+        }
+    }
+    if (d->numWorkers) unlock_Mutex(d->mtx);
+    return found;
+}
@@ -0,0 +1,51 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#pragma once
+
+/* Image decoding in a pool of background threads. Finished images are announced with
+   a "media.decoded owner:%p" command and picked up by the owner in the main thread. */
+
+#include <the_Foundation/block.h>
+#include <the_Foundation/vec2.h>
+
+iDeclareType(DecodedImage)
+
+struct Impl_DecodedImage {
+    const void *owner;
+    uint32_t    id;
+    iInt2       sourceSize; /* dimensions of the encoded image */
+    iInt2       size;       /* may be smaller if the image was reduced while decoding */
+    iBool       hasAlpha;   /* False if every pixel is opaque */
+    uint8_t *   pixels;     /* RGBA, 4 bytes per pixel; NULL if decoding failed */
+};
+
+void    deinit_DecodedImage     (iDecodedImage *);
+
+void    init_Decoder            (void);
+void    deinit_Decoder          (void);
+
+iBool   probe_Decoder           (const iBlock *data, iInt2 *size_out); /* header only */
+void    submit_Decoder          (const void *owner, uint32_t id, const iBlock *data,
+                                 iInt2 maxSize /* zero for no limit */);
+void    cancel_Decoder          (const void *owner, uint32_t id); /* zero `id`: all jobs of `owner` */
+iBool   takeFinished_Decoder    (const void *owner, iDecodedImage *img_out);
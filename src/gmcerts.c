@@ -22,7 +22,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "gmcerts.h"
 #include "defs.h"
+#include "saver.h"
 
+#include <the_Foundation/buffer.h>
 #include <the_Foundation/file.h>
 #include <the_Foundation/fileinfo.h>
 #include <the_Foundation/mutex.h>
@@ -200,39 +202,39 @@ static const char *magicIdentity_GmCerts_ = "iden";
 iDefineTypeConstructionArgs(GmCerts, (const char *saveDir), saveDir)
 
 static void saveIdentities_GmCerts_(const iGmCerts *d) {
-    iFile *f = new_File(collect_String(concatCStr_Path(&d->saveDir, identsFilename_GmCerts_)));
-    if (open_File(f, writeOnly_FileMode)) {
-        writeData_File(f, magicIdMeta_GmCerts_, 4);
-        writeU32_File(f, latest_FileVersion); /* version */
-        iConstForEach(PtrArray, i, &d->idents) {
-            const iGmIdentity *ident = i.ptr;
-            if (~ident->flags & temporary_GmIdentityFlag) {
-                writeData_File(f, magicIdentity_GmCerts_, 4);
-                serialize_GmIdentity(ident, stream_File(f));
-            }
+    iBuffer *buf = new_Buffer();
+    openEmpty_Buffer(buf);
+    iStream *outs = stream_Buffer(buf);
+    writeData_Stream(outs, magicIdMeta_GmCerts_, 4);
+    writeU32_Stream(outs, latest_FileVersion); /* version */
+    iConstForEach(PtrArray, i, &d->idents) {
+        const iGmIdentity *ident = i.ptr;
+        if (~ident->flags & temporary_GmIdentityFlag) {
+            writeData_Stream(outs, magicIdentity_GmCerts_, 4);
+            serialize_GmIdentity(ident, outs);
         }
     }
-    iRelease(f);
+    submit_Saver(collect_String(concatCStr_Path(&d->saveDir, identsFilename_GmCerts_)),
+                 data_Buffer(buf));
+    iRelease(buf);
 }
 
 static void save_GmCerts_(const iGmCerts *d) {
+    /* Only a snapshot is made here; the file is written in the background. */
     iBeginCollect();
-    iFile *f = new_File(collect_String(concatCStr_Path(&d->saveDir, filename_GmCerts_)));
-    if (open_File(f, writeOnly_FileMode | text_FileMode)) {
-        iString line;
-        init_String(&line);
-        iConstForEach(StringHash, i, d->trusted) {
-            const iTrustEntry *trust = value_StringHashNode(i.value);
-            format_String(&line,
-                          "%s %ld %s\n",
-                          cstr_String(key_StringHashConstIterator(&i)),
-                          integralSeconds_Time(&trust->validUntil),
-                          cstrCollect_String(hexEncode_Block(&trust->fingerprint)));
-            write_File(f, &line.chars);
-        }
-        deinit_String(&line);
-    }
-    iRelease(f);
+    iString content;
+    init_String(&content);
+    iConstForEach(StringHash, i, d->trusted) {
+        const iTrustEntry *trust = value_StringHashNode(i.value);
+        appendFormat_String(&content,
+                            "%s %ld %s\n",
+                            cstr_String(key_StringHashConstIterator(&i)),
+                            integralSeconds_Time(&trust->validUntil),
+                            cstrCollect_String(hexEncode_Block(&trust->fingerprint)));
+    }
+    submitText_Saver(collect_String(concatCStr_Path(&d->saveDir, filename_GmCerts_)),
+                     &content);
+    deinit_String(&content);
     iEndCollect();
 }
 
@@ -27,6 +27,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "ui/metrics.h"
 #include "ui/window.h"
 #include "visited.h"
+#include "profiler.h"
 #include "app.h"
 
 #include <the_Foundation/ptrarray.h>
@@ -41,6 +42,11 @@ struct Impl_GmLink {
     iRangecc urlRange; /* URL in the source */
     iTime when;
     int flags;
+    /* Presentation, updated after layout: */
+    enum iColorId colors[max_GmLinkPart];
+    iString hoverText; /* shown after the link on hover: host, media type, visit date */
+    iInt2 hoverTextSize;
+    iRangei span; /* vertical extent of the link's runs */
 };
 
 void init_GmLink(iGmLink *d) {
@@ -48,9 +54,16 @@ void init_GmLink(iGmLink *d) {
     d->urlRange = iNullRange;
     iZap(d->when);
     d->flags = 0;
+    iForIndices(i, d->colors) {
+        d->colors[i] = tmLinkText_ColorId;
+    }
+    init_String(&d->hoverText);
+    d->hoverTextSize = zero_I2();
+    d->span = (iRangei){ 0, 0 };
 }
 
 void deinit_GmLink(iGmLink *d) {
+    deinit_String(&d->hoverText);
     deinit_String(&d->url);
 }
 
@@ -71,6 +84,8 @@ struct Impl_GmDocument {
     iString   bannerText;
     iString   title; /* the first top-level title */
     iArray    headings;
+    iArray    preWidths; /* measured preformatted block widths, indexed by preId - 1 */
+    int       preWidthsFontHeight;
     uint32_t  themeSeed;
     iChar     siteIcon;
     iMedia *  media;
@@ -153,6 +168,23 @@ static iInt2 measurePreformattedBlock_GmDocument_(const iGmDocument *d, const ch
     return measureRange_Text(font, preBlock);
 }
 
+static int preformattedWidth_GmDocument_(iGmDocument *d, uint16_t preId, const char *start) {
+    /* The widths only depend on the source and the font, so they remain valid when the
+       layout is redone for a different document width. */
+    const int fontHeight = lineHeight_Text(preformatted_FontId);
+    if (d->preWidthsFontHeight != fontHeight) {
+        clear_Array(&d->preWidths);
+        d->preWidthsFontHeight = fontHeight;
+    }
+    if (preId <= size_Array(&d->preWidths)) {
+        return value_Array(&d->preWidths, preId - 1, int);
+    }
+    iAssert(preId == size_Array(&d->preWidths) + 1);
+    const int width = measurePreformattedBlock_GmDocument_(d, start, preformatted_FontId).x;
+    pushBack_Array(&d->preWidths, &width);
+    return width;
+}
+
 static iRangecc addLink_GmDocument_(iGmDocument *d, iRangecc line, iGmLinkId *linkId) {
     static iRegExp *pattern_;
     if (!pattern_) {
@@ -251,6 +283,128 @@ static iBool isForcedMonospace_GmDocument_(const iGmDocument *d) {
     return iFalse;
 }
 
+static enum iColorId linkColor_GmLink_(const iGmLink *link, enum iGmLinkPart part) {
+    const int www_GmLinkFlag = http_GmLinkFlag | mailto_GmLinkFlag;
+    if (link) {
+        const iBool isBad = (link->flags & supportedProtocol_GmLinkFlag) == 0;
+        if (part == icon_GmLinkPart) {
+            if (isBad) {
+                return tmBadLink_ColorId;
+            }
+            if (link->flags & visited_GmLinkFlag) {
+                return link->flags & www_GmLinkFlag
+                           ? tmHypertextLinkIconVisited_ColorId
+                           : link->flags & gopher_GmLinkFlag ? tmGopherLinkIconVisited_ColorId
+                                                             : tmLinkIconVisited_ColorId;
+            }
+            return link->flags & www_GmLinkFlag
+                       ? tmHypertextLinkIcon_ColorId
+                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkIcon_ColorId
+                                                         : tmLinkIcon_ColorId;
+        }
+        if (part == text_GmLinkPart) {
+            return link->flags & www_GmLinkFlag
+                       ? tmHypertextLinkText_ColorId
+                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkText_ColorId
+                                                         : tmLinkText_ColorId;
+        }
+        if (part == textHover_GmLinkPart) {
+            return link->flags & www_GmLinkFlag
+                       ? tmHypertextLinkTextHover_ColorId
+                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkTextHover_ColorId
+                                                         : tmLinkTextHover_ColorId;
+        }
+        if (part == domain_GmLinkPart) {
+            if (isBad) {
+                return tmBadLink_ColorId;
+            }
+            return link->flags & www_GmLinkFlag
+                       ? tmHypertextLinkDomain_ColorId
+                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkDomain_ColorId
+                                                         : tmLinkDomain_ColorId;
+        }
+        if (part == visited_GmLinkPart) {
+            return link->flags & www_GmLinkFlag
+                       ? tmHypertextLinkLastVisitDate_ColorId
+                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkLastVisitDate_ColorId
+                                                         : tmLinkLastVisitDate_ColorId;
+        }
+    }
+    return tmLinkText_ColorId;
+}
+
+static void updateLinkPresentation_GmDocument_(iGmDocument *d) {
+    /* Colors and hover texts are composed once here so drawing links does not need to parse
+       URLs or format strings. */
+    const int metaFont = paragraph_FontId; /* DocumentWidget draws link metadata with this */
+    iForEach(PtrArray, i, &d->links) {
+        iGmLink *  link  = i.ptr;
+        const int  flags = link->flags;
+        iForIndices(part, link->colors) {
+            link->colors[part] = linkColor_GmLink_(link, part);
+        }
+        clear_String(&link->hoverText);
+        iUrl parts;
+        init_Url(&parts, &link->url);
+        const iBool showHost  = (flags & humanReadable_GmLinkFlag &&
+                                (!isEmpty_Range(&parts.host) || flags & mailto_GmLinkFlag));
+        const iBool showImage = (flags & imageFileExtension_GmLinkFlag) != 0;
+        const iBool showAudio = (flags & audioFileExtension_GmLinkFlag) != 0;
+        /* Show scheme and host. */
+        if (showImage || showAudio || showHost) {
+            format_String(&link->hoverText,
+                          " \u2014%s%s%s\r%c%s",
+                          showHost ? " " : "",
+                          showHost ? (flags & mailto_GmLinkFlag
+                                          ? cstr_String(&link->url)
+                                          : ~flags & gemini_GmLinkFlag
+                                                ? format_CStr("%s://%s",
+                                                              cstr_Rangecc(parts.scheme),
+                                                              cstr_Rangecc(parts.host))
+                                                : cstr_Rangecc(parts.host))
+                                   : "",
+                          showHost && (showImage || showAudio) ? " \u2014" : "",
+                          asciiBase_ColorEscape +
+                              link->colors[showImage || showAudio ? textHover_GmLinkPart
+                                                                  : domain_GmLinkPart],
+                          showImage ? " View Image \U0001f5bc"
+                                    : showAudio ? " Play Audio \U0001f3b5" : "");
+        }
+        if (flags & visited_GmLinkFlag) {
+            iDate date;
+            init_Date(&date, &link->when);
+            appendFormat_String(&link->hoverText,
+                                " \u2014 %s%s",
+                                escape_Color(link->colors[visited_GmLinkPart]),
+                                cstr_String(collect_String(format_Date(&date, "%b %d"))));
+        }
+        link->hoverTextSize = isEmpty_String(&link->hoverText)
+                                  ? zero_I2()
+                                  : measure_Text(metaFont, cstr_String(&link->hoverText));
+    }
+}
+
+static void updateLinkSpans_GmDocument_(iGmDocument *d) {
+    /* Lets the position of a link be looked up without searching through the layout. */
+    iForEach(PtrArray, i, &d->links) {
+        ((iGmLink *) i.ptr)->span = (iRangei){ 0, 0 };
+    }
+    iConstForEach(Array, r, &d->layout) {
+        const iGmRun *run = r.value;
+        if (run->linkId && run->linkId <= size_PtrArray(&d->links)) {
+            iGmLink *link = at_PtrArray(&d->links, run->linkId - 1);
+            const iRangei span = { top_Rect(run->visBounds), bottom_Rect(run->visBounds) };
+            if (isEmpty_Range(&link->span)) {
+                link->span = span;
+            }
+            else {
+                link->span.start = iMin(link->span.start, span.start);
+                link->span.end   = iMax(link->span.end, span.end);
+            }
+        }
+    }
+}
+
 static void doLayout_GmDocument_(iGmDocument *d) {
     const iBool isMono = isForcedMonospace_GmDocument_(d);
     /* TODO: Collect these parameters into a GmTheme. */
@@ -300,6 +454,7 @@ static void doLayout_GmDocument_(iGmDocument *d) {
     if (d->size.x <= 0 || isEmpty_String(&d->source)) {
         return;
     }
+    const uint64_t   profileTime   = begin_Profiler();
     const iRangecc   content       = range_String(&d->source);
     iRangecc         contentLine   = iNullRange;
     iInt2            pos           = zero_I2();
@@ -333,7 +488,7 @@ static void doLayout_GmDocument_(iGmDocument *d) {
                 preId++;
                 preFont = preformatted_FontId;
                 /* Use a smaller font if the block contents are wide. */
-                if (measurePreformattedBlock_GmDocument_(d, line.start, preFont).x >
+                if (preformattedWidth_GmDocument_(d, preId, line.start) >
                     d->size.x - indents[preformatted_GmLineType]) {
                     preFont = preformattedSmall_FontId;
                 }
@@ -617,6 +772,9 @@ static void doLayout_GmDocument_(iGmDocument *d) {
             }
         }
     }
+    updateLinkSpans_GmDocument_(d);
+    updateLinkPresentation_GmDocument_(d);
+    end_Profiler(layoutDocument_ProfileZone, profileTime);
 }
 
 void init_GmDocument(iGmDocument *d) {
@@ -631,6 +789,8 @@ void init_GmDocument(iGmDocument *d) {
     init_String(&d->bannerText);
     init_String(&d->title);
     init_Array(&d->headings, sizeof(iGmHeading));
+    init_Array(&d->preWidths, sizeof(int));
+    d->preWidthsFontHeight = 0;
     d->themeSeed = 0;
     d->siteIcon = 0;
     d->media = new_Media();
@@ -642,6 +802,7 @@ void deinit_GmDocument(iGmDocument *d) {
     deinit_String(&d->title);
     clearLinks_GmDocument_(d);
     deinit_PtrArray(&d->links);
+    deinit_Array(&d->preWidths);
     deinit_Array(&d->headings);
     deinit_Array(&d->layout);
     deinit_String(&d->localHost);
@@ -662,6 +823,7 @@ void reset_GmDocument(iGmDocument *d) {
     clearLinks_GmDocument_(d);
     clear_Array(&d->layout);
     clear_Array(&d->headings);
+    clear_Array(&d->preWidths);
     clear_String(&d->url);
     clear_String(&d->localHost);
     d->themeSeed = 0;
@@ -1086,6 +1248,7 @@ void setThemeSeed_GmDocument(iGmDocument *d, const iBlock *seed) {
 
 void setFormat_GmDocument(iGmDocument *d, enum iGmDocumentFormat format) {
     d->format = format;
+    clear_Array(&d->preWidths);
 }
 
 void setBanner_GmDocument(iGmDocument *d, enum iGmDocumentBanner type) {
@@ -1180,6 +1343,7 @@ void setUrl_GmDocument(iGmDocument *d, const iString *url) {
 void setSource_GmDocument(iGmDocument *d, const iString *source, int width) {
     set_String(&d->source, source);
     normalize_GmDocument(d);
+    clear_Array(&d->preWidths);
     setWidth_GmDocument(d, width); /* re-do layout */
 }
 
@@ -1363,53 +1527,22 @@ iMediaId linkAudio_GmDocument(const iGmDocument *d, iGmLinkId linkId) {
 
 enum iColorId linkColor_GmDocument(const iGmDocument *d, iGmLinkId linkId, enum iGmLinkPart part) {
     const iGmLink *link = link_GmDocument_(d, linkId);
-    const int www_GmLinkFlag = http_GmLinkFlag | mailto_GmLinkFlag;
-    if (link) {
-        const iBool isBad = (link->flags & supportedProtocol_GmLinkFlag) == 0;
-        if (part == icon_GmLinkPart) {
-            if (isBad) {
-                return tmBadLink_ColorId;
-            }
-            if (link->flags & visited_GmLinkFlag) {
-                return link->flags & www_GmLinkFlag
-                           ? tmHypertextLinkIconVisited_ColorId
-                           : link->flags & gopher_GmLinkFlag ? tmGopherLinkIconVisited_ColorId
-                                                             : tmLinkIconVisited_ColorId;
-            }
-            return link->flags & www_GmLinkFlag
-                       ? tmHypertextLinkIcon_ColorId
-                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkIcon_ColorId
-                                                         : tmLinkIcon_ColorId;
-        }
-        if (part == text_GmLinkPart) {
-            return link->flags & www_GmLinkFlag
-                       ? tmHypertextLinkText_ColorId
-                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkText_ColorId
-                                                         : tmLinkText_ColorId;
-        }
-        if (part == textHover_GmLinkPart) {
-            return link->flags & www_GmLinkFlag
-                       ? tmHypertextLinkTextHover_ColorId
-                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkTextHover_ColorId
-                                                         : tmLinkTextHover_ColorId;
-        }
-        if (part == domain_GmLinkPart) {
-            if (isBad) {
-                return tmBadLink_ColorId;
-            }
-            return link->flags & www_GmLinkFlag
-                       ? tmHypertextLinkDomain_ColorId
-                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkDomain_ColorId
-                                                         : tmLinkDomain_ColorId;
-        }
-        if (part == visited_GmLinkPart) {
-            return link->flags & www_GmLinkFlag
-                       ? tmHypertextLinkLastVisitDate_ColorId
-                       : link->flags & gopher_GmLinkFlag ? tmGopherLinkLastVisitDate_ColorId
-                                                         : tmLinkLastVisitDate_ColorId;
-        }
-    }
-    return tmLinkText_ColorId;
+    return link ? link->colors[part] : tmLinkText_ColorId;
+}
+
+const iString *linkHoverText_GmDocument(const iGmDocument *d, iGmLinkId linkId) {
+    const iGmLink *link = link_GmDocument_(d, linkId);
+    return link ? &link->hoverText : NULL;
+}
+
+iInt2 linkHoverTextSize_GmDocument(const iGmDocument *d, iGmLinkId linkId) {
+    const iGmLink *link = link_GmDocument_(d, linkId);
+    return link ? link->hoverTextSize : zero_I2();
+}
+
+iRangei linkSpan_GmDocument(const iGmDocument *d, iGmLinkId linkId) {
+    const iGmLink *link = link_GmDocument_(d, linkId);
+    return link ? link->span : (iRangei){ 0, 0 };
 }
 
 iBool isMediaLink_GmDocument(const iGmDocument *d, iGmLinkId linkId) {
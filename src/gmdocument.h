@@ -156,6 +156,7 @@ enum iGmLinkPart {
     textHover_GmLinkPart,
     domain_GmLinkPart,
     visited_GmLinkPart,
+    max_GmLinkPart
 };
 
 const iGmRun *  findRun_GmDocument      (const iGmDocument *, iInt2 pos);
@@ -167,6 +168,9 @@ iMediaId        linkImage_GmDocument    (const iGmDocument *, iGmLinkId linkId);
 iMediaId        linkAudio_GmDocument    (const iGmDocument *, iGmLinkId linkId);
 int             linkFlags_GmDocument    (const iGmDocument *, iGmLinkId linkId);
 enum iColorId   linkColor_GmDocument    (const iGmDocument *, iGmLinkId linkId, enum iGmLinkPart part);
+const iString * linkHoverText_GmDocument    (const iGmDocument *, iGmLinkId linkId); /* updated after layout */
+iInt2           linkHoverTextSize_GmDocument(const iGmDocument *, iGmLinkId linkId);
+iRangei         linkSpan_GmDocument     (const iGmDocument *, iGmLinkId linkId); /* empty if not laid out */
 const iTime *   linkTime_GmDocument     (const iGmDocument *, iGmLinkId linkId);
 iBool           isMediaLink_GmDocument  (const iGmDocument *, iGmLinkId linkId);
 const iString * title_GmDocument        (const iGmDocument *);
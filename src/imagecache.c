@@ -0,0 +1,164 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "imagecache.h"
+
+#include <the_Foundation/ptrarray.h>
+#include <SDL_timer.h>
+
+iDeclareType(ImageCache)
+
+struct Impl_ImageCache {
+    iPtrArray entries;
+    size_t    textureBytes;
+    iBool     isShutDown;
+};
+
+enum {
+    textureBudget_ImageCache_ = 256 * 1024 * 1024,
+    evictionGrace_ImageCache_ = 2000, /* ms; textures drawn more recently are never evicted */
+};
+
+static iImageCache imageCache_;
+
+static void releaseTexture_CachedImage_(iCachedImage *d) {
+    if (d->texture) {
+        SDL_DestroyTexture(d->texture);
+        d->texture = NULL;
+        imageCache_.textureBytes -= d->textureBytes;
+        d->textureBytes = 0;
+    }
+}
+
+static void delete_CachedImage_(iCachedImage *d) {
+    releaseTexture_CachedImage_(d);
+    if (!imageCache_.isShutDown) {
+        removeOne_PtrArray(&imageCache_.entries, d);
+    }
+    deinit_String(&d->url);
+    free(d);
+}
+
+void init_ImageCache(void) {
+    iImageCache *d = &imageCache_;
+    init_PtrArray(&d->entries);
+    d->textureBytes = 0;
+    d->isShutDown   = iFalse;
+}
+
+void deinit_ImageCache(void) {
+    /* Images still in use by documents are deleted when their last reference goes away. */
+    iImageCache *d = &imageCache_;
+    iForEach(PtrArray, i, &d->entries) {
+        iCachedImage *entry = i.ptr;
+        if (entry->refCount == 0) {
+            releaseTexture_CachedImage_(entry);
+            deinit_String(&entry->url);
+            free(entry);
+            remove_PtrArrayIterator(&i);
+        }
+    }
+    d->isShutDown = iTrue;
+    deinit_PtrArray(&d->entries);
+}
+
+static void evict_ImageCache_(const iCachedImage *keep) {
+    iImageCache *d = &imageCache_;
+    const uint32_t now = SDL_GetTicks();
+    while (d->textureBytes > textureBudget_ImageCache_) {
+        iCachedImage *oldest = NULL;
+        iConstForEach(PtrArray, i, &d->entries) {
+            iCachedImage *entry = (iCachedImage *) i.ptr;
+            if (entry != keep && entry->texture &&
+                now - entry->lastUsed > evictionGrace_ImageCache_ &&
+                (!oldest || entry->lastUsed < oldest->lastUsed)) {
+                oldest = entry;
+            }
+        }
+        if (!oldest) {
+            break; /* everything is on screen */
+        }
+        if (oldest->refCount == 0) {
+            delete_CachedImage_(oldest);
+        }
+        else {
+            releaseTexture_CachedImage_(oldest); /* will be decoded again when drawn */
+        }
+    }
+}
+
+iCachedImage *find_ImageCache(const iString *url, uint32_t hash) {
+    if (!url || isEmpty_String(url)) {
+        return NULL;
+    }
+    iConstForEach(PtrArray, i, &imageCache_.entries) {
+        iCachedImage *entry = (iCachedImage *) i.ptr;
+        if (entry->hash == hash && equal_String(&entry->url, url)) {
+            entry->refCount++;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+iCachedImage *insert_ImageCache(const iString *url, uint32_t hash, iInt2 sourceSize) {
+    iCachedImage *d = calloc(1, sizeof(iCachedImage));
+    if (url) {
+        initCopy_String(&d->url, url);
+    }
+    else {
+        init_String(&d->url);
+    }
+    d->hash       = hash;
+    d->sourceSize = sourceSize;
+    d->refCount   = 1;
+    pushBack_PtrArray(&imageCache_.entries, d);
+    return d;
+}
+
+void release_ImageCache(iCachedImage *d) {
+    if (d) {
+        iAssert(d->refCount > 0);
+        /* Unreferenced private entries can't be found again so there is no use keeping them.
+           Neither is there any use for entries without a texture (evicted or never decoded). */
+        if (--d->refCount == 0 &&
+            (isEmpty_String(&d->url) || !d->texture || imageCache_.isShutDown)) {
+            delete_CachedImage_(d);
+        }
+    }
+}
+
+void setTexture_ImageCache(iCachedImage *d, SDL_Texture *texture, size_t numBytes) {
+    releaseTexture_CachedImage_(d);
+    d->texture      = texture;
+    d->textureBytes = texture ? numBytes : 0;
+    d->lastUsed     = SDL_GetTicks();
+    imageCache_.textureBytes += d->textureBytes;
+    evict_ImageCache_(d);
+}
+
+SDL_Texture *use_ImageCache(iCachedImage *d) {
+    if (d->texture) {
+        d->lastUsed = SDL_GetTicks();
+    }
+    return d->texture;
+}
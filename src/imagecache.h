@@ -0,0 +1,55 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#pragma once
+
+/* Process-wide cache of image textures. Entries are keyed by the image URL and a hash of
+   its compressed data, so the same image shown in several tabs, or again after navigating
+   back, is decoded and uploaded only once. Total texture memory is kept within a budget:
+   unreferenced entries are dropped least recently used first, and referenced ones that
+   haven't been drawn recently lose their texture until they are needed again. */
+
+#include <the_Foundation/string.h>
+#include <the_Foundation/vec2.h>
+#include <SDL_render.h>
+
+iDeclareType(CachedImage)
+
+struct Impl_CachedImage {
+    iString      url;        /* empty for private entries, which are never shared */
+    uint32_t     hash;
+    iInt2        sourceSize;
+    SDL_Texture *texture;    /* NULL if not decoded yet or evicted */
+    size_t       textureBytes;
+    uint32_t     lastUsed;   /* SDL ticks when the texture was last drawn */
+    int          refCount;
+};
+
+void            init_ImageCache         (void);
+void            deinit_ImageCache       (void); /* call while the renderer still exists */
+
+iCachedImage *  find_ImageCache         (const iString *url, uint32_t hash); /* adds a reference */
+iCachedImage *  insert_ImageCache       (const iString *url, uint32_t hash, iInt2 sourceSize);
+void            release_ImageCache      (iCachedImage *);
+
+void            setTexture_ImageCache   (iCachedImage *, SDL_Texture *texture, size_t numBytes);
+SDL_Texture *   use_ImageCache          (iCachedImage *); /* marks as drawn */
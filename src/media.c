@@ -21,33 +21,39 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "media.h"
+#include "decoder.h"
+#include "imagecache.h"
 #include "gmdocument.h"
 #include "gmrequest.h"
 #include "ui/window.h"
 #include "audio/player.h"
 #include "app.h"
 
+#include <the_Foundation/array.h>
 #include <the_Foundation/ptrarray.h>
-#include <stb_image.h>
 #include <SDL_hints.h>
 #include <SDL_render.h>
+#include <SDL_timer.h>
 
 iDeclareType(GmMediaProps)
 
 struct Impl_GmMediaProps {
     iGmLinkId linkId;
+    iString   url;
     iString   mime;
     iBool     isPermanent;
 };
 
 static void init_GmMediaProps_(iGmMediaProps *d) {
     d->linkId = 0;
+    init_String(&d->url);
     init_String(&d->mime);
     d->isPermanent = iFalse;
 }
 
 static void deinit_GmMediaProps_(iGmMediaProps *d) {
     deinit_String(&d->mime);
+    deinit_String(&d->url);
 }
 
 /*----------------------------------------------------------------------------------------------*/
@@ -56,48 +62,146 @@ iDeclareType(GmImage)
 
 struct Impl_GmImage {
     iGmMediaProps props;
-    iBlock        partialData; /* cleared when image is converted to texture */
-    iInt2         size;
+    iBlock        partialData; /* compressed; kept so an evicted texture can be decoded again */
+    iInt2         size;        /* known from the header before decoding finishes */
     size_t        numBytes;
-    SDL_Texture * texture;
+    uint32_t      hash;        /* of the complete data */
+    iCachedImage *cached;      /* shared with identical images of other documents */
+    uint32_t      lastPartialDecode;
+    iBool         isDecoding;
+    iBool         isPartial;   /* latest decode was of incomplete data */
+};
+
+enum {
+    partialDecodeInterval_Media_ = 250, /* ms; limits decoding and uploads while downloading */
 };
 
 void init_GmImage(iGmImage *d, const iBlock *data) {
     init_GmMediaProps_(&d->props);
     initCopy_Block(&d->partialData, data);
-    d->size     = zero_I2();
-    d->numBytes = 0;
-    d->texture  = NULL;
+    d->size       = zero_I2();
+    d->numBytes   = 0;
+    d->hash       = 0;
+    d->cached     = NULL;
+    d->lastPartialDecode = 0;
+    d->isDecoding = iFalse;
+    d->isPartial  = iFalse;
 }
 
 void deinit_GmImage(iGmImage *d) {
+    release_ImageCache(d->cached);
     deinit_Block(&d->partialData);
-    SDL_DestroyTexture(d->texture);
     deinit_GmMediaProps_(&d->props);
 }
 
-void makeTexture_GmImage(iGmImage *d) {
-    iBlock *data     = &d->partialData;
-    d->numBytes      = size_Block(data);
-    uint8_t *imgData = stbi_load_from_memory(
-        constData_Block(data), size_Block(data), &d->size.x, &d->size.y, NULL, 4);
-    if (!imgData) {
-        d->size    = zero_I2();
-        d->texture = NULL;
+static iInt2 maxTextureSize_(void) {
+    /* Images are never shown wider than the window, so there is no point in keeping more
+       pixels than that. Height is only limited by what the renderer supports. */
+    const iWindow *win = get_Window();
+    iInt2 size = zero_I2();
+    if (win) {
+        SDL_RendererInfo info;
+        if (SDL_GetRendererInfo(renderer_Window(win), &info) == 0) {
+            size = init_I2(info.max_texture_width, info.max_texture_height);
+        }
+        const int width = rootSize_Window(win).x;
+        if (width > 0) {
+            size.x = size.x ? iMin(size.x, width) : width;
+        }
+    }
+    return size;
+}
+
+static void decode_GmImage_(iGmImage *d, const iMedia *owner, iBool isPartial) {
+    /* The header tells the size so the layout will not change when decoding finishes. */
+    const iBlock *data = &d->partialData;
+    if (!isPartial) {
+        d->numBytes = size_Block(data);
+    }
+    probe_Decoder(data, &d->size);
+    d->isDecoding = iTrue;
+    d->isPartial  = isPartial;
+    submit_Decoder(owner, d->props.linkId, data, maxTextureSize_());
+}
+
+static void decodePartial_GmImage_(iGmImage *d, const iMedia *owner) {
+    /* Truncated data is decoded as far as it goes: progressive JPEGs show a coarse version
+       of the whole image, baseline ones the rows received so far. Formats that can't be
+       decoded from a prefix keep the placeholder until the download is complete. */
+    const uint32_t now = SDL_GetTicks();
+    if (!d->isDecoding && now - d->lastPartialDecode >= partialDecodeInterval_Media_) {
+        d->lastPartialDecode = now;
+        decode_GmImage_(d, owner, iTrue);
+    }
+}
+
+static void complete_GmImage_(iGmImage *d, const iMedia *owner) {
+    /* All data has been received. If the same image is already on screen elsewhere, or was
+       shown recently, its texture is reused instead of decoding again. */
+    d->hash = crc32_Block(&d->partialData);
+    iCachedImage *cached = find_ImageCache(&d->props.url, d->hash);
+    if (cached) {
+        release_ImageCache(d->cached);
+        d->cached = cached;
+        if (cached->texture) {
+            cancel_Decoder(owner, d->props.linkId);
+            d->numBytes   = size_Block(&d->partialData);
+            d->size       = cached->sourceSize;
+            d->isDecoding = iFalse;
+            d->isPartial  = iFalse;
+            return;
+        }
+    }
+    decode_GmImage_(d, owner, iFalse);
+}
+
+static void makeTexture_GmImage_(iGmImage *d, const iDecodedImage *img) {
+    /* Only the texture upload happens in the main thread. */
+    d->isDecoding = iFalse;
+    if (!img->pixels) {
+        if (!d->isPartial) {
+            clear_Block(&d->partialData); /* don't try again */
+            release_ImageCache(d->cached);
+            d->cached = NULL;
+        }
+        return; /* a partial update keeps showing the previous one */
+    }
+    d->size = img->sourceSize; /* layout uses the original size */
+    if (d->isPartial) {
+        if (!d->cached) {
+            d->cached = insert_ImageCache(NULL, 0, img->sourceSize); /* private */
+        }
+    }
+    else if (!d->cached || isEmpty_String(&d->cached->url)) {
+        iCachedImage *shared = find_ImageCache(&d->props.url, d->hash);
+        if (!shared) {
+            shared = insert_ImageCache(&d->props.url, d->hash, img->sourceSize);
+        }
+        release_ImageCache(d->cached);
+        d->cached = shared;
     }
-    else {
-        /* TODO: Save some memory by checking if the alpha channel is actually in use. */
-        /* TODO: Resize down to min(maximum texture size, window size). */
-        SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(
-            imgData, d->size.x, d->size.y, 32, d->size.x * 4, SDL_PIXELFORMAT_ABGR8888);
-        /* TODO: In multiwindow case, all windows must have the same shared renderer?
-           Or at least a shared context. */
-        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1"); /* linear scaling */
-        d->texture = SDL_CreateTextureFromSurface(renderer_Window(get_Window()), surface);
-        SDL_FreeSurface(surface);
-        stbi_image_free(imgData);
+    if (!d->isPartial && d->cached->texture) {
+        return; /* another document uploaded it meanwhile */
     }
-    clear_Block(data);
+    /* Opaque images don't need blending when drawn. */
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(
+        img->pixels, img->size.x, img->size.y, 32, img->size.x * 4, SDL_PIXELFORMAT_ABGR8888);
+    if (!img->hasAlpha) {
+        SDL_Surface *opaque = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_BGR888, 0);
+        if (opaque) {
+            SDL_FreeSurface(surface);
+            surface = opaque;
+        }
+    }
+    /* TODO: In multiwindow case, all windows must have the same shared renderer?
+       Or at least a shared context. */
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1"); /* linear scaling */
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer_Window(get_Window()), surface);
+    SDL_FreeSurface(surface);
+    if (texture) {
+        SDL_SetTextureBlendMode(texture, img->hasAlpha ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+    }
+    setTexture_ImageCache(d->cached, texture, 4 * (size_t) img->size.x * img->size.y);
 }
 
 iDefineTypeConstructionArgs(GmImage, (const iBlock *data), data)
@@ -125,9 +229,17 @@ iDefineTypeConstruction(GmAudio)
 
 /*----------------------------------------------------------------------------------------------*/
 
+iDeclareType(MediaLink)
+
+struct Impl_MediaLink {
+    iMediaId image;
+    iMediaId audio;
+};
+
 struct Impl_Media {
     iPtrArray images;
-    iPtrArray audio;   
+    iPtrArray audio;
+    iArray    links; /* iMediaLink indexed by link ID; link IDs are small and dense */
 };
 
 iDefineTypeConstruction(Media)
@@ -135,27 +247,51 @@ iDefineTypeConstruction(Media)
 void init_Media(iMedia *d) {
     init_PtrArray(&d->images);
     init_PtrArray(&d->audio);
+    init_Array(&d->links, sizeof(iMediaLink));
 }
 
 void deinit_Media(iMedia *d) {
     clear_Media(d);
+    deinit_Array(&d->links);
     deinit_PtrArray(&d->audio);
     deinit_PtrArray(&d->images);
 }
 
+static iMediaLink *link_Media_(iMedia *d, iGmLinkId linkId) {
+    while (size_Array(&d->links) <= linkId) {
+        pushBack_Array(&d->links, &(iMediaLink){ 0, 0 });
+    }
+    return at_Array(&d->links, linkId);
+}
+
+static void reindex_Media_(iMedia *d) {
+    /* Removing an item shifts the IDs of the ones after it. */
+    clear_Array(&d->links);
+    iConstForEach(PtrArray, i, &d->images) {
+        const iGmImage *img = i.ptr;
+        link_Media_(d, img->props.linkId)->image = index_PtrArrayConstIterator(&i) + 1;
+    }
+    iConstForEach(PtrArray, a, &d->audio) {
+        const iGmAudio *audio = a.ptr;
+        link_Media_(d, audio->props.linkId)->audio = index_PtrArrayConstIterator(&a) + 1;
+    }
+}
+
 void clear_Media(iMedia *d) {
+    cancel_Decoder(d, 0);
     iForEach(PtrArray, i, &d->images) {
-        deinit_GmImage(i.ptr);
+        delete_GmImage(i.ptr);
     }
     clear_PtrArray(&d->images);
     iForEach(PtrArray, a, &d->audio) {
-        deinit_GmAudio(a.ptr);
+        delete_GmAudio(a.ptr);
     }
     clear_PtrArray(&d->audio);
+    clear_Array(&d->links);
 }
 
-iBool setData_Media(iMedia *d, iGmLinkId linkId, const iString *mime, const iBlock *data,
-                    int flags) {
+iBool setData_Media(iMedia *d, iGmLinkId linkId, const iString *url, const iString *mime,
+                    const iBlock *data, int flags) {
     const iBool isPartial  = (flags & partialData_MediaFlag) != 0;
     const iBool allowHide  = (flags & allowHide_MediaFlag) != 0;
     const iBool isDeleting = (!mime || !data);
@@ -165,14 +301,19 @@ iBool setData_Media(iMedia *d, iGmLinkId linkId, const iString *mime, const iBlo
         iGmImage *img;
         if (isDeleting) {
             take_PtrArray(&d->images, existing - 1, (void **) &img);
+            cancel_Decoder(d, linkId);
             delete_GmImage(img);
+            reindex_Media_(d);
         }
         else {
             img = at_PtrArray(&d->images, existing - 1);
             iAssert(equal_String(&img->props.mime, mime)); /* MIME cannot change */
             set_Block(&img->partialData, data);
             if (!isPartial) {
-                makeTexture_GmImage(img);
+                complete_GmImage_(img, d);
+            }
+            else {
+                decodePartial_GmImage_(img, d);
             }
         }
     }
@@ -181,6 +322,7 @@ iBool setData_Media(iMedia *d, iGmLinkId linkId, const iString *mime, const iBlo
         if (isDeleting) {
             take_PtrArray(&d->audio, existing - 1, (void **) &audio);
             delete_GmAudio(audio);
+            reindex_Media_(d);
         }
         else {
             audio = at_PtrArray(&d->audio, existing - 1);
@@ -197,27 +339,42 @@ iBool setData_Media(iMedia *d, iGmLinkId linkId, const iString *mime, const iBlo
     }
     else if (!isDeleting) {
         if (startsWith_String(mime, "image/")) {
+            iInt2 size;
+            if (isPartial && !probe_Decoder(data, &size)) {
+                return iFalse; /* layout needs the image size; wait for the complete header */
+            }
             /* Copy the image to a texture. */
             iGmImage *img = new_GmImage(data);
-            img->props.linkId = linkId; /* TODO: use a hash? */
+            img->props.linkId = linkId;
             img->props.isPermanent = !allowHide;
+            if (url) {
+                set_String(&img->props.url, url);
+            }
             set_String(&img->props.mime, mime);
             pushBack_PtrArray(&d->images, img);
+            link_Media_(d, linkId)->image = size_PtrArray(&d->images);
             if (!isPartial) {
-                makeTexture_GmImage(img);
+                complete_GmImage_(img, d);
+            }
+            else {
+                decodePartial_GmImage_(img, d);
             }
             isNew = iTrue;
         }
         else if (startsWith_String(mime, "audio/")) {
             iGmAudio *audio = new_GmAudio();
-            audio->props.linkId = linkId; /* TODO: use a hash? */
+            audio->props.linkId = linkId;
             audio->props.isPermanent = !allowHide;
+            if (url) {
+                set_String(&audio->props.url, url);
+            }
             set_String(&audio->props.mime, mime);
             updateSourceData_Player(audio->player, mime, data, replace_PlayerUpdate);
             if (!isPartial) {
                 updateSourceData_Player(audio->player, NULL, NULL, complete_PlayerUpdate);
             }
             pushBack_PtrArray(&d->audio, audio);
+            link_Media_(d, linkId)->audio = size_PtrArray(&d->audio);
             /* Start playing right away. */
             start_Player(audio->player);
             postCommandf_App("media.player.started player:%p", audio->player);
@@ -227,13 +384,29 @@ iBool setData_Media(iMedia *d, iGmLinkId linkId, const iString *mime, const iBlo
     return isNew;
 }
 
-iMediaId findLinkImage_Media(const iMedia *d, iGmLinkId linkId) {
-    /* TODO: use a hash */
-    iConstForEach(PtrArray, i, &d->images) {
-        const iGmImage *img = i.ptr;
-        if (img->props.linkId == linkId) {
-            return index_PtrArrayConstIterator(&i) + 1;
+iBool updateDecoded_Media(iMedia *d, iArray *decodedLinkIds_out) {
+    iBool isSizeChanged = iFalse;
+    iDecodedImage decoded;
+    while (takeFinished_Decoder(d, &decoded)) {
+        const iMediaId imageId = findLinkImage_Media(d, decoded.id);
+        if (imageId) {
+            iGmImage *img = at_PtrArray(&d->images, imageId - 1);
+            if (!isEqual_I2(img->size, decoded.sourceSize)) {
+                isSizeChanged = iTrue;
+            }
+            makeTexture_GmImage_(img, &decoded);
+            if (decodedLinkIds_out) {
+                pushBack_Array(decodedLinkIds_out, &img->props.linkId);
+            }
         }
+        deinit_DecodedImage(&decoded);
+    }
+    return isSizeChanged;
+}
+
+iMediaId findLinkImage_Media(const iMedia *d, iGmLinkId linkId) {
+    if (linkId < size_Array(&d->links)) {
+        return ((const iMediaLink *) constAt_Array(&d->links, linkId))->image;
     }
     return 0;
 }
@@ -243,20 +416,22 @@ size_t numAudio_Media(const iMedia *d) {
 }
 
 iMediaId findLinkAudio_Media(const iMedia *d, iGmLinkId linkId) {
-    /* TODO: use a hash */
-    iConstForEach(PtrArray, i, &d->audio) {
-        const iGmAudio *audio = i.ptr;
-        if (audio->props.linkId == linkId) {
-            return index_PtrArrayConstIterator(&i) + 1;
-        }
+    if (linkId < size_Array(&d->links)) {
+        return ((const iMediaLink *) constAt_Array(&d->links, linkId))->audio;
     }
     return 0;
 }
 
 SDL_Texture *imageTexture_Media(const iMedia *d, uint16_t imageId) {
+    /* Called when the image is about to be drawn. */
     if (imageId > 0 && imageId <= size_PtrArray(&d->images)) {
-        const iGmImage *img = constAt_PtrArray(&d->images, imageId - 1);
-        return img->texture;
+        iGmImage *   img     = iConstCast(iGmImage *, constAt_PtrArray(&d->images, imageId - 1));
+        SDL_Texture *texture = img->cached ? use_ImageCache(img->cached) : NULL;
+        if (!texture && !img->isDecoding && !isEmpty_Block(&img->partialData) && img->numBytes) {
+            /* The texture was evicted; it will be back after decoding. */
+            decode_GmImage_(img, d, iFalse);
+        }
+        return texture;
     }
     return NULL;
 }
@@ -265,7 +440,7 @@ iBool imageInfo_Media(const iMedia *d, iMediaId imageId, iGmImageInfo *info_out)
     if (imageId > 0 && imageId <= size_PtrArray(&d->images)) {
         const iGmImage *img   = constAt_PtrArray(&d->images, imageId - 1);
         info_out->size        = img->size;
-        info_out->numBytes    = img->numBytes;
+        info_out->numBytes    = img->numBytes ? img->numBytes : size_Block(&img->partialData);
         info_out->mime        = cstr_String(&img->props.mime);
         info_out->isPermanent = img->props.isPermanent;
         return iTrue;
@@ -313,20 +488,49 @@ static void finished_MediaRequest_(iAnyObject *obj) {
     postCommandf_App("media.finished link:%u request:%p", d->linkId, d);
 }
 
-void init_MediaRequest(iMediaRequest *d, iDocumentWidget *doc, unsigned int linkId, const iString *url) {
-    d->doc    = doc;
-    d->linkId = linkId;
-    d->req    = new_GmRequest(certs_App());
+static void newRequest_MediaRequest_(iMediaRequest *d, const iString *url) {
+    d->req = new_GmRequest(certs_App());
     setUrl_GmRequest(d->req, url);
     iConnect(GmRequest, d->req, updated, d, updated_MediaRequest_);
     iConnect(GmRequest, d->req, finished, d, finished_MediaRequest_);
-    submit_GmRequest(d->req);
+    d->isSubmitted = iFalse;
 }
 
-void deinit_MediaRequest(iMediaRequest *d) {
+static void releaseRequest_MediaRequest_(iMediaRequest *d) {
     iDisconnect(GmRequest, d->req, updated, d, updated_MediaRequest_);
     iDisconnect(GmRequest, d->req, finished, d, finished_MediaRequest_);
     iRelease(d->req);
+    d->req = NULL;
+}
+
+void init_MediaRequest(iMediaRequest *d, iDocumentWidget *doc, unsigned int linkId, const iString *url) {
+    d->doc        = doc;
+    d->linkId     = linkId;
+    d->isExplicit = iFalse;
+    newRequest_MediaRequest_(d, url);
+}
+
+void deinit_MediaRequest(iMediaRequest *d) {
+    releaseRequest_MediaRequest_(d);
+}
+
+void submit_MediaRequest(iMediaRequest *d) {
+    if (!d->isSubmitted) {
+        d->isSubmitted = iTrue;
+        submit_GmRequest(d->req);
+    }
+}
+
+void requeue_MediaRequest(iMediaRequest *d) {
+    if (d->isSubmitted) {
+        /* Signals are disconnected first so the cancellation isn't reported as an error. */
+        const iString *url = collect_String(copy_String(url_GmRequest(d->req)));
+        iDisconnect(GmRequest, d->req, updated, d, updated_MediaRequest_);
+        iDisconnect(GmRequest, d->req, finished, d, finished_MediaRequest_);
+        cancel_GmRequest(d->req);
+        iRelease(d->req);
+        newRequest_MediaRequest_(d, url);
+    }
 }
 
 iDefineObjectConstructionArgs(MediaRequest,
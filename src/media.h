@@ -22,6 +22,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #pragma once
 
+#include <the_Foundation/array.h>
 #include <the_Foundation/block.h>
 #include <the_Foundation/string.h>
 #include <the_Foundation/vec2.h>
@@ -54,7 +55,10 @@ enum iMediaFlags {
 };
 
 void    clear_Media     (iMedia *);
-iBool   setData_Media   (iMedia *, uint16_t linkId, const iString *mime, const iBlock *data, int flags);
+iBool   setData_Media   (iMedia *, uint16_t linkId, const iString *url, const iString *mime,
+                         const iBlock *data, int flags);
+iBool   updateDecoded_Media (iMedia *, iArray *decodedLinkIds_out /* uint16_t; optional */);
+                                /* returns True if an image's size changed */
 
 iMediaId        findLinkImage_Media (const iMedia *, uint16_t linkId);
 iBool           imageInfo_Media     (const iMedia *, iMediaId imageId, iGmImageInfo *info_out);
@@ -78,7 +82,13 @@ struct Impl_MediaRequest {
     iDocumentWidget *doc;
     unsigned int     linkId;
     iGmRequest *     req;
+    iBool            isSubmitted;
+    iBool            isExplicit; /* requested by the user rather than scheduled automatically */
 };
 
 iDeclareObjectConstructionArgs(MediaRequest, iDocumentWidget *doc, unsigned int linkId,
                                const iString *url)
+
+/* Requests are created queued; the owner decides when to submit them. */
+void    submit_MediaRequest     (iMediaRequest *);
+void    requeue_MediaRequest    (iMediaRequest *); /* cancels a submitted request */
@@ -33,6 +33,7 @@ void init_Prefs(iPrefs *d) {
     d->hoverOutline      = iFalse;
     d->smoothScrolling   = iTrue;
     d->loadImageInsteadOfScrolling = iFalse;
+    d->maxMediaFetches   = 4;
     d->font              = nunito_TextFont;
     d->headingFont       = nunito_TextFont;
     d->monospaceGemini   = iFalse;
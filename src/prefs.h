@@ -47,6 +47,7 @@ struct Impl_Prefs {
     iBool            hoverOutline;
     iBool            smoothScrolling;
     iBool            loadImageInsteadOfScrolling;
+    int              maxMediaFetches; /* concurrent inline media requests per document */
     /* Network */
     iString          geminiProxy;
     iString          gopherProxy;
@@ -0,0 +1,222 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "profiler.h"
+
+#include <the_Foundation/atomic.h>
+#include <the_Foundation/mutex.h>
+#include <the_Foundation/ptrarray.h>
+#include <SDL_timer.h>
+#include <SDL_thread.h>
+
+iDeclareType(ProfileEvent)
+iDeclareType(ProfileRing)
+iDeclareType(Profiler)
+
+struct Impl_ProfileEvent {
+    uint64_t begin;
+    uint64_t end;
+    int      zone;
+};
+
+#define ringSize_Profiler_  8192 /* events per thread; must be a power of two */
+#define historySize_Profiler_ 64 /* frames */
+
+/* Only the owning thread writes to its ring. Exporting reads the rings without locking,
+   so an event being overwritten at the same time may come out garbled. */
+struct Impl_ProfileRing {
+    SDL_threadID     thread;
+    iAtomicInt       written;
+    iProfileEvent    events[ringSize_Profiler_];
+    iProfileFrame    frame; /* accumulated since the thread's previous endFrame_Profiler */
+};
+
+struct Impl_Profiler {
+    iAtomicInt    enabled;
+    iMutex *      mtx;
+    iPtrArray     rings;
+    uint64_t      epoch;
+    uint64_t      frequency;
+    uint64_t      lastFrameTime;
+    iProfileFrame history[historySize_Profiler_];
+    size_t        historyPos;
+    iProfileFrame peak;
+};
+
+static iProfiler profiler_;
+static _Thread_local iProfileRing *threadRing_Profiler_;
+
+static const char *zoneNames_Profiler_[max_ProfileZone] = {
+    "processEvents_App",
+    "draw_Window",
+    "draw_DocumentWidget",
+    "doLayout_GmDocument",
+    "glyph_Font",
+};
+
+static iProfileRing *ring_Profiler_(iProfiler *d) {
+    if (!threadRing_Profiler_) {
+        iProfileRing *ring = calloc(1, sizeof(iProfileRing));
+        ring->thread = SDL_ThreadID();
+        iGuardMutex(d->mtx, pushBack_PtrArray(&d->rings, ring));
+        threadRing_Profiler_ = ring;
+    }
+    return threadRing_Profiler_;
+}
+
+static uint32_t micros_Profiler_(const iProfiler *d, uint64_t ticks) {
+    return (uint32_t) (ticks * 1000000 / d->frequency);
+}
+
+void init_Profiler(void) {
+    iProfiler *d = &profiler_;
+    set_Atomic(&d->enabled, iFalse);
+    d->mtx = new_Mutex();
+    init_PtrArray(&d->rings);
+    d->epoch         = SDL_GetPerformanceCounter();
+    d->frequency     = SDL_GetPerformanceFrequency();
+    d->lastFrameTime = 0;
+    d->historyPos    = 0;
+    iZap(d->history);
+    iZap(d->peak);
+}
+
+void deinit_Profiler(void) {
+    iProfiler *d = &profiler_;
+    set_Atomic(&d->enabled, iFalse);
+    iForEach(PtrArray, i, &d->rings) {
+        free(i.ptr);
+    }
+    deinit_PtrArray(&d->rings);
+    delete_Mutex(d->mtx);
+    d->mtx = NULL;
+    threadRing_Profiler_ = NULL;
+}
+
+void setEnabled_Profiler(iBool enabled) {
+    iProfiler *d = &profiler_;
+    if (enabled && !isEnabled_Profiler()) {
+        d->lastFrameTime = 0;
+    }
+    set_Atomic(&d->enabled, enabled);
+}
+
+iBool isEnabled_Profiler(void) {
+    return value_Atomic(&profiler_.enabled) != 0;
+}
+
+uint64_t begin_Profiler(void) {
+    if (!isEnabled_Profiler()) {
+        return 0;
+    }
+    return SDL_GetPerformanceCounter();
+}
+
+void end_Profiler(enum iProfileZone zone, uint64_t beginTime) {
+    iProfiler *d = &profiler_;
+    if (!beginTime || !isEnabled_Profiler()) {
+        return;
+    }
+    const uint64_t endTime = SDL_GetPerformanceCounter();
+    iProfileRing *ring = ring_Profiler_(d);
+    const int pos = value_Atomic(&ring->written);
+    ring->events[pos & (ringSize_Profiler_ - 1)] =
+        (iProfileEvent){ .begin = beginTime, .end = endTime, .zone = zone };
+    set_Atomic(&ring->written, pos + 1);
+    ring->frame.zoneTime[zone] += micros_Profiler_(d, endTime - beginTime);
+}
+
+void count_Profiler(enum iProfileCounter counter) {
+    if (isEnabled_Profiler()) {
+        ring_Profiler_(&profiler_)->frame.counters[counter]++;
+    }
+}
+
+void endFrame_Profiler(void) {
+    iProfiler *d = &profiler_;
+    if (!isEnabled_Profiler()) {
+        return;
+    }
+    iProfileRing * ring  = ring_Profiler_(d);
+    iProfileFrame *frame = &d->history[d->historyPos];
+    const uint64_t now   = SDL_GetPerformanceCounter();
+    *frame = ring->frame;
+    frame->interval = (d->lastFrameTime ? micros_Profiler_(d, now - d->lastFrameTime) : 0);
+    d->lastFrameTime = now;
+    d->historyPos = (d->historyPos + 1) % historySize_Profiler_;
+    iZap(ring->frame);
+    /* Update the peaks over the recent frames. */
+    iZap(d->peak);
+    iForIndices(i, d->history) {
+        const iProfileFrame *f = &d->history[i];
+        d->peak.interval = iMax(d->peak.interval, f->interval);
+        iForIndices(z, f->zoneTime) {
+            d->peak.zoneTime[z] = iMax(d->peak.zoneTime[z], f->zoneTime[z]);
+        }
+        iForIndices(c, f->counters) {
+            d->peak.counters[c] = iMax(d->peak.counters[c], f->counters[c]);
+        }
+    }
+}
+
+const char *zoneName_Profiler(enum iProfileZone zone) {
+    return zoneNames_Profiler_[zone];
+}
+
+const iProfileFrame *lastFrame_Profiler(void) {
+    const iProfiler *d = &profiler_;
+    return &d->history[(d->historyPos + historySize_Profiler_ - 1) % historySize_Profiler_];
+}
+
+const iProfileFrame *peakFrame_Profiler(void) {
+    return &profiler_.peak;
+}
+
+iString *traceJson_Profiler(void) {
+    iProfiler *d = &profiler_;
+    iString *json = newCStr_String("{\"traceEvents\":[\n");
+    iBool isFirst = iTrue;
+    lock_Mutex(d->mtx);
+    iConstForEach(PtrArray, i, &d->rings) {
+        const iProfileRing *ring    = i.ptr;
+        const int           written = value_Atomic(&ring->written);
+        for (int pos = iMax(0, written - ringSize_Profiler_); pos < written; pos++) {
+            const iProfileEvent *ev = &ring->events[pos & (ringSize_Profiler_ - 1)];
+            if (ev->zone < 0 || ev->zone >= max_ProfileZone || ev->begin < d->epoch ||
+                ev->end < ev->begin) {
+                continue;
+            }
+            appendFormat_String(json,
+                                "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,"
+                                "\"ts\":%.3f,\"dur\":%.3f}",
+                                isFirst ? "" : ",\n",
+                                zoneNames_Profiler_[ev->zone],
+                                (unsigned long) ring->thread,
+                                (ev->begin - d->epoch) * 1.0e6 / d->frequency,
+                                (ev->end - ev->begin) * 1.0e6 / d->frequency);
+            isFirst = iFalse;
+        }
+    }
+    unlock_Mutex(d->mtx);
+    appendCStr_String(json, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return json;
+}
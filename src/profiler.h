@@ -0,0 +1,68 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#pragma once
+
+/* Lightweight instrumentation of hot paths. While enabled, timed zones are recorded
+   in per-thread ring buffers that can be exported in Chrome's trace event format. */
+
+#include <the_Foundation/string.h>
+
+enum iProfileZone {
+    events_ProfileZone,         /* processEvents_App */
+    drawWindow_ProfileZone,     /* draw_Window */
+    drawDocument_ProfileZone,   /* draw_DocumentWidget_ */
+    layoutDocument_ProfileZone, /* doLayout_GmDocument_ */
+    cacheGlyph_ProfileZone,     /* glyph_Font_ rasterizing a new glyph */
+    max_ProfileZone
+};
+
+enum iProfileCounter {
+    glyphCacheMiss_ProfileCounter,
+    glyphCacheFlush_ProfileCounter, /* glyph cache was full and had to be cleared */
+    missedFrame_ProfileCounter, /* frame work took longer than the display refresh period */
+    max_ProfileCounter
+};
+
+iDeclareType(ProfileFrame)
+
+struct Impl_ProfileFrame {
+    uint32_t interval;                   /* microseconds since the previous frame */
+    uint32_t zoneTime[max_ProfileZone];  /* microseconds spent in each zone */
+    uint32_t counters[max_ProfileCounter];
+};
+
+void    init_Profiler       (void);
+void    deinit_Profiler     (void);
+
+void    setEnabled_Profiler (iBool enabled);
+iBool   isEnabled_Profiler  (void);
+
+uint64_t begin_Profiler     (void); /* returns zero when disabled */
+void    end_Profiler        (enum iProfileZone zone, uint64_t beginTime);
+void    count_Profiler      (enum iProfileCounter counter);
+void    endFrame_Profiler   (void); /* call from the main thread after presenting */
+
+const char *        zoneName_Profiler   (enum iProfileZone zone);
+const iProfileFrame *lastFrame_Profiler (void);
+const iProfileFrame *peakFrame_Profiler (void); /* per-field maximum over recent frames */
+iString *           traceJson_Profiler  (void); /* Chrome trace event JSON */
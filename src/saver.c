@@ -0,0 +1,259 @@
+/* Copyright 2020 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "saver.h"
+
+#include <the_Foundation/file.h>
+#include <the_Foundation/mutex.h>
+#include <the_Foundation/path.h>
+#include <the_Foundation/ptrarray.h>
+#include <the_Foundation/thread.h>
+#include <stdio.h>
+#if defined (iPlatformMsys)
+#   include <io.h>
+#else
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+iDeclareType(Saver)
+iDeclareType(SaverJob)
+
+struct Impl_SaverJob {
+    iString path;
+    iBlock  data;
+    iBool   isText; /* line endings are translated like in text_FileMode */
+};
+
+static void init_SaverJob(iSaverJob *d, const iString *path, const iBlock *data, iBool isText) {
+    initCopy_String(&d->path, path); /* expected to be cleaned */
+    initCopy_Block(&d->data, data);
+    d->isText = isText;
+}
+
+static void deinit_SaverJob(iSaverJob *d) {
+    deinit_Block(&d->data);
+    deinit_String(&d->path);
+}
+
+iDefineTypeConstructionArgs(SaverJob,
+                            (const iString *path, const iBlock *data, iBool isText),
+                            path, data, isText)
+
+static iBool sync_SaverJob_(FILE *f) {
+    /* Make sure the contents are on disk before the file is renamed. */
+    if (fflush(f)) {
+        return iFalse;
+    }
+#if defined (iPlatformMsys)
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+static void syncDir_SaverJob_(const iSaverJob *d) {
+#if !defined (iPlatformMsys)
+    /* The rename itself is only durable once the directory entry is synced. */
+    const iString *dir = collect_String(newRange_String(dirName_Path(&d->path)));
+    const int fd = open(isEmpty_String(dir) ? "." : cstr_String(dir), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#else
+    iUnused(d);
+#endif
+}
+
+static void write_SaverJob_(const iSaverJob *d) {
+    /* The new contents are written to a temporary file that then replaces the old one,
+       so a crash in the middle of writing does not lose the previous contents. */
+    iString *tmpPath = copy_String(&d->path);
+    appendCStr_String(tmpPath, ".tmp");
+    iBool ok = iFalse;
+    FILE *f = fopen(cstr_String(tmpPath), d->isText ? "w" : "wb");
+    if (f) {
+        ok = (fwrite(constData_Block(&d->data), 1, size_Block(&d->data), f) ==
+              size_Block(&d->data));
+        ok = sync_SaverJob_(f) && ok;
+        ok = (fclose(f) == 0) && ok;
+    }
+    if (ok) {
+#if defined (iPlatformMsys)
+        remove(cstr_String(&d->path)); /* rename() does not replace existing files */
+#endif
+        ok = (rename(cstr_String(tmpPath), cstr_String(&d->path)) == 0);
+        if (ok) {
+            syncDir_SaverJob_(d);
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "[Saver] failed to write %s\n", cstr_String(&d->path));
+        remove(cstr_String(tmpPath));
+    }
+    delete_String(tmpPath);
+}
+
+/*----------------------------------------------------------------------------------------------*/
+
+static const double coalesceSeconds_Saver_ = 0.5; /* wait for more changes before writing */
+
+struct Impl_Saver {
+    iMutex *   mtx;
+    iCondition changed;   /* new jobs or stopping */
+    iCondition finished;  /* all pending jobs written */
+    iThread *  worker;
+    iBool      stopWorker;
+    iBool      isWriting;
+    iPtrArray  pending;   /* at most one job per path */
+};
+
+static iSaver saver_;
+
+static iThreadResult run_Saver_(iThread *thread) {
+    iSaver *d = userData_Thread(thread);
+    iPtrArray jobs;
+    init_PtrArray(&jobs);
+    lock_Mutex(d->mtx);
+    for (;;) {
+        while (isEmpty_PtrArray(&d->pending) && !d->stopWorker) {
+            signal_Condition(&d->finished);
+            wait_Condition(&d->changed, d->mtx);
+        }
+        if (isEmpty_PtrArray(&d->pending)) {
+            break; /* Stopping and nothing left to do. */
+        }
+        if (!d->stopWorker) {
+            /* Bursts of changes are written out only once. */
+            unlock_Mutex(d->mtx);
+            sleep_Thread(coalesceSeconds_Saver_);
+            lock_Mutex(d->mtx);
+        }
+        /* Take the current snapshots. */
+        iForEach(PtrArray, i, &d->pending) {
+            pushBack_PtrArray(&jobs, i.ptr);
+        }
+        clear_PtrArray(&d->pending);
+        d->isWriting = iTrue;
+        unlock_Mutex(d->mtx);
+        iForEach(PtrArray, j, &jobs) {
+            write_SaverJob_(j.ptr);
+            delete_SaverJob(j.ptr);
+        }
+        clear_PtrArray(&jobs);
+        lock_Mutex(d->mtx);
+        d->isWriting = iFalse;
+    }
+    signal_Condition(&d->finished);
+    unlock_Mutex(d->mtx);
+    deinit_PtrArray(&jobs);
+    return 0;
+}
+
+void init_Saver(void) {
+    iSaver *d = &saver_;
+    d->mtx = new_Mutex();
+    init_Condition(&d->changed);
+    init_Condition(&d->finished);
+    init_PtrArray(&d->pending);
+    d->stopWorker = iFalse;
+    d->isWriting  = iFalse;
+    d->worker     = new_Thread(run_Saver_);
+    setUserData_Thread(d->worker, d);
+    start_Thread(d->worker);
+}
+
+void deinit_Saver(void) {
+    iSaver *d = &saver_;
+    if (!d->worker) return;
+    iGuardMutex(d->mtx, {
+        d->stopWorker = iTrue;
+        signal_Condition(&d->changed);
+    });
+    join_Thread(d->worker);
+    iReleasePtr(&d->worker);
+    iAssert(isEmpty_PtrArray(&d->pending));
+    deinit_PtrArray(&d->pending);
+    deinit_Condition(&d->finished);
+    deinit_Condition(&d->changed);
+    delete_Mutex(d->mtx);
+}
+
+static void submit_Saver_(const iString *path, const iBlock *data, iBool isText) {
+    iSaver *d = &saver_;
+    path = collect_String(cleaned_Path(path)); /* expand "~" for rename() */
+    if (!d->worker) {
+        /* Not running; write immediately. */
+        iSaverJob job;
+        init_SaverJob(&job, path, data, isText);
+        write_SaverJob_(&job);
+        deinit_SaverJob(&job);
+        return;
+    }
+    lock_Mutex(d->mtx);
+    /* A newer snapshot of the same file replaces the pending one. */
+    iForEach(PtrArray, i, &d->pending) {
+        iSaverJob *job = i.ptr;
+        if (equal_String(&job->path, path)) {
+            set_Block(&job->data, data);
+            job->isText = isText;
+            unlock_Mutex(d->mtx);
+            return;
+        }
+    }
+    pushBack_PtrArray(&d->pending, new_SaverJob(path, data, isText));
+    signal_Condition(&d->changed);
+    unlock_Mutex(d->mtx);
+}
+
+void submit_Saver(const iString *path, const iBlock *data) {
+    submit_Saver_(path, data, iFalse);
+}
+
+void submitCStr_Saver(const char *path, const iBlock *data) {
+    iString str;
+    initCStr_String(&str, path);
+    submit_Saver_(&str, data, iFalse);
+    deinit_String(&str);
+}
+
+void submitText_Saver(const iString *path, const iString *text) {
+    submit_Saver_(path, &text->chars, iTrue);
+}
+
+void submitTextCStr_Saver(const char *path, const iString *text) {
+    iString str;
+    initCStr_String(&str, path);
+    submit_Saver_(&str, &text->chars, iTrue);
+    deinit_String(&str);
+}
+
+void flush_Saver(void) {
+    iSaver *d = &saver_;
+    if (!d->worker) return;
+    lock_Mutex(d->mtx);
+    while (!isEmpty_PtrArray(&d->pending) || d->isWriting) {
+        wait_Condition(&d->finished, d->mtx);
+    }
+    unlock_Mutex(d->mtx);
+}
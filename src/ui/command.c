@@ -24,24 +24,182 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "app.h"
 
 #include <the_Foundation/string.h>
+#include <SDL_atomic.h>
 #include <ctype.h>
 
+#define maxPooled_Command_ 64
+
+static SDL_SpinLock  lock_Command_;
+static iCommand *    pool_Command_[maxPooled_Command_];
+static size_t        numPooled_Command_;
+static const iCommand *dispatched_Command_;
+
+/* In the order of enum iCommandId. Never modified, so it can be searched without locking. */
+static const char *names_Command_[max_CommandId] = {
+    "",
+    "document.request.finished",
+    "document.request.updated",
+    "media.decoded",
+    "media.finished",
+    "media.player.update",
+    "media.updated",
+    "mouse.clicked",
+    "scroll.bottom",
+    "scroll.page",
+    "scroll.step",
+    "scroll.top",
+    "window.resized",
+};
+
+static int cmpName_Command_(iRangecc name, const char *str) {
+    const size_t len = size_Range(&name);
+    const int    cmp = strncmp(name.start, str, len);
+    return cmp ? cmp : (str[len] ? -1 : 0);
+}
+
+static enum iCommandId findId_Command_(iRangecc name) {
+    size_t first = 1, last = max_CommandId;
+    while (first < last) {
+        const size_t mid = (first + last) / 2;
+        const int    cmp = cmpName_Command_(name, names_Command_[mid]);
+        if (cmp == 0) {
+            return (enum iCommandId) mid;
+        }
+        if (cmp < 0) {
+            last = mid;
+        }
+        else {
+            first = mid + 1;
+        }
+    }
+    return unknown_CommandId;
+}
+
+static iRangecc name_Command_(const char *text) {
+    /* Without arguments, the whole text is the name (see equal_Command). */
+    const char *nameEnd = (strchr(text, ':') ? strchr(text, ' ') : NULL);
+    return (iRangecc){ text, nameEnd ? nameEnd : text + strlen(text) };
+}
+
+iLocalDef iBool isLabelChar_(char ch) {
+    return isalnum((unsigned char) ch) || ch == '_' || ch == '.' || ch == '-';
+}
+
+static void parse_Command_(iCommand *d) {
+    const char *text = d->text;
+    const char *end  = text + strlen(text);
+    d->name    = name_Command_(text);
+    d->id      = findId_Command_(d->name);
+    d->numArgs = 0;
+    /* Note every " label:" just like the string searches would find them, in order. */
+    for (const char *ch = d->name.end; ch && ch < end; ch = strchr(ch + 1, ' ')) {
+        const char *label = ch + 1;
+        const char *pos   = label;
+        while (isLabelChar_(*pos)) {
+            pos++;
+        }
+        if (*pos != ':' || pos == label) {
+            continue;
+        }
+        if (d->numArgs == maxArgs_Command) {
+            d->numArgs = -1; /* must search the string instead */
+            break;
+        }
+        d->args[d->numArgs++] = (iCommandArg){ { label, pos }, pos + 1 };
+    }
+}
+
+iCommand *new_Command(const char *text) {
+    iCommand *d = NULL;
+    const size_t len = strlen(text);
+    SDL_AtomicLock(&lock_Command_);
+    if (numPooled_Command_) {
+        d = pool_Command_[--numPooled_Command_];
+    }
+    SDL_AtomicUnlock(&lock_Command_);
+    if (!d) {
+        d = malloc(sizeof(iCommand));
+    }
+    d->text = (len < sizeof(d->buffer) ? d->buffer : malloc(len + 1));
+    memcpy(d->text, text, len + 1);
+    parse_Command_(d);
+    return d;
+}
+
+void delete_Command(iCommand *d) {
+    if (!d) return;
+    if (d == dispatched_Command_) {
+        dispatched_Command_ = NULL;
+    }
+    if (d->text != d->buffer) {
+        free(d->text);
+    }
+    SDL_AtomicLock(&lock_Command_);
+    if (numPooled_Command_ < maxPooled_Command_) {
+        pool_Command_[numPooled_Command_++] = d;
+        d = NULL;
+    }
+    SDL_AtomicUnlock(&lock_Command_);
+    free(d);
+}
+
+const iCommand *setDispatched_Command(const iCommand *d) {
+    const iCommand *prev = dispatched_Command_;
+    dispatched_Command_ = d;
+    return prev;
+}
+
+static const iCommand *parsed_Command_(const char *cmd) {
+    const iCommand *d = dispatched_Command_;
+    return d && d->text == cmd && d->numArgs >= 0 ? d : NULL;
+}
+
+static const char *findLabel_Command_(const char *cmd, const char *label) {
+    /* Returns a pointer to the value. */
+    const size_t    labelLen = strlen(label);
+    const iCommand *parsed   = parsed_Command_(cmd);
+    if (parsed) {
+        for (int i = 0; i < parsed->numArgs; i++) {
+            const iCommandArg *arg = &parsed->args[i];
+            if (size_Range(&arg->label) == labelLen &&
+                !memcmp(arg->label.start, label, labelLen)) {
+                return arg->value;
+            }
+        }
+        return NULL;
+    }
+    for (const char *ch = strchr(cmd, ' '); ch; ch = strchr(ch + 1, ' ')) {
+        if (!strncmp(ch + 1, label, labelLen) && ch[1 + labelLen] == ':') {
+            return ch + 2 + labelLen;
+        }
+    }
+    return NULL;
+}
+
 iBool equal_Command(const char *cmdWithArgs, const char *cmd) {
+    const iCommand *parsed = parsed_Command_(cmdWithArgs);
+    if (parsed) {
+        const size_t len = strlen(cmd);
+        return size_Range(&parsed->name) == len && !memcmp(parsed->name.start, cmd, len);
+    }
     if (strchr(cmdWithArgs, ':')) {
         return startsWith_CStr(cmdWithArgs, cmd) && cmdWithArgs[strlen(cmd)] == ' ';
     }
     return equal_CStr(cmdWithArgs, cmd);
 }
 
-static const iString *tokenString_(const char *label) {
-    return collectNewFormat_String(" %s:", label);
+enum iCommandId id_Command(const char *cmdWithArgs) {
+    const iCommand *d = dispatched_Command_;
+    if (d && d->text == cmdWithArgs) {
+        return d->id;
+    }
+    return findId_Command_(name_Command_(cmdWithArgs));
 }
 
 int argLabel_Command(const char *cmd, const char *label) {
-    const iString *tok = tokenString_(label);
-    const char *ptr = strstr(cmd, cstr_String(tok));
+    const char *ptr = findLabel_Command_(cmd, label);
     if (ptr) {
-        return atoi(ptr + size_String(tok));
+        return atoi(ptr);
     }
     return 0;
 }
@@ -51,28 +209,22 @@ int arg_Command(const char *cmd) {
 }
 
 float argfLabel_Command(const char *cmd, const char *label) {
-    const iString *tok = tokenString_(label);
-    const char *ptr = strstr(cmd, cstr_String(tok));
+    const char *ptr = findLabel_Command_(cmd, label);
     if (ptr) {
-        return strtof(ptr + size_String(tok), NULL);
+        return strtof(ptr, NULL);
     }
     return 0.0f;
 }
 
 float argf_Command(const char *cmd) {
-    const char *ptr = strstr(cmd, " arg:");
-    if (ptr) {
-        return strtof(ptr + 5, NULL);
-    }
-    return 0;
+    return argfLabel_Command(cmd, "arg");
 }
 
 void *pointerLabel_Command(const char *cmd, const char *label) {
-    const iString *tok = tokenString_(label);
-    const char *ptr = strstr(cmd, cstr_String(tok));
+    const char *ptr = findLabel_Command_(cmd, label);
     if (ptr) {
         void *val = NULL;
-        sscanf(ptr + size_String(tok), "%p", &val);
+        sscanf(ptr, "%p", &val);
         return val;
     }
     return NULL;
@@ -83,12 +235,7 @@ void *pointer_Command(const char *cmd) {
 }
 
 const char *suffixPtr_Command(const char *cmd, const char *label) {
-    const iString *tok = tokenString_(label);
-    const char *ptr = strstr(cmd, cstr_String(tok));
-    if (ptr) {
-        return ptr + size_String(tok);
-    }
-    return NULL;
+    return findLabel_Command_(cmd, label);
 }
 
 iString *suffix_Command(const char *cmd, const char *label) {
@@ -109,10 +256,10 @@ iRangecc range_Command(const char *cmd, const char *label) {
 }
 
 iInt2 dir_Command(const char *cmd) {
-    const char *ptr = strstr(cmd, " dir:");
+    const char *ptr = findLabel_Command_(cmd, "dir");
     if (ptr) {
         iInt2 dir;
-        sscanf(ptr + 5, "%d%d", &dir.x, &dir.y);
+        sscanf(ptr, "%d%d", &dir.x, &dir.y);
         return dir;
     }
     return zero_I2();
@@ -120,9 +267,9 @@ iInt2 dir_Command(const char *cmd) {
 
 iInt2 coord_Command(const char *cmd) {
     iInt2 coord = zero_I2();
-    const char *ptr = strstr(cmd, " coord:");
+    const char *ptr = findLabel_Command_(cmd, "coord");
     if (ptr) {
-        sscanf(ptr + 7, "%d%d", &coord.x, &coord.y);
+        sscanf(ptr, "%d%d", &coord.x, &coord.y);
     }
     return coord;
 }
@@ -25,7 +25,60 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <the_Foundation/range.h>
 #include <the_Foundation/vec2.h>
 
+iDeclareType(Command)
+iDeclareType(CommandArg)
+
+#define maxArgs_Command     8
+#define bufferSize_Command  120
+
+/* Frequently posted commands have a numeric ID so that hot handlers can recognize them
+   without comparing strings. Sorted by name. */
+enum iCommandId {
+    unknown_CommandId,
+    documentRequestFinished_CommandId,
+    documentRequestUpdated_CommandId,
+    mediaDecoded_CommandId,
+    mediaFinished_CommandId,
+    mediaPlayerUpdate_CommandId,
+    mediaUpdated_CommandId,
+    mouseClicked_CommandId,
+    scrollBottom_CommandId,
+    scrollPage_CommandId,
+    scrollStep_CommandId,
+    scrollTop_CommandId,
+    windowResized_CommandId,
+    max_CommandId
+};
+
+struct Impl_CommandArg {
+    iRangecc    label; /* without the colon */
+    const char *value;
+};
+
+/* A posted command. The name and argument labels are parsed once when the command is
+   created; the string form remains available for bindings, echoing, and handlers. */
+struct Impl_Command {
+    enum iCommandId id;
+    iRangecc    name;
+    int         numArgs;    /* -1 if there were too many to index */
+    iCommandArg args[maxArgs_Command];
+    char *      text;       /* `buffer` or a heap allocation if it did not fit */
+    char        buffer[bufferSize_Command];
+};
+
+iCommand *  new_Command             (const char *text); /* pooled; thread-safe */
+void        delete_Command          (iCommand *);
+const iCommand *setDispatched_Command(const iCommand *); /* main thread; returns previous */
+
+iLocalDef const char *cstr_Command(const iCommand *d) {
+    return d->text;
+}
+
+/* The functions below accept any command string. When given the text of the command
+   that is being dispatched, they use its parsed form instead of searching the string. */
+
 iBool   equal_Command           (const char *commandWithArgs, const char *command);
+enum iCommandId id_Command      (const char *commandWithArgs);
 
 int     arg_Command             (const char *); /* arg: */
 float   argf_Command            (const char *); /* arg: */
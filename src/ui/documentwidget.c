@@ -38,11 +38,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "media.h"
 #include "paint.h"
 #include "playerui.h"
+#include "profiler.h"
 #include "scrollwidget.h"
 #include "util.h"
 #include "visbuf.h"
 #include "visited.h"
 
+#include <the_Foundation/buffer.h>
 #include <the_Foundation/file.h>
 #include <the_Foundation/fileinfo.h>
 #include <the_Foundation/objectlist.h>
@@ -56,6 +58,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <SDL_render.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 
 /*----------------------------------------------------------------------------------------------*/
 
@@ -108,8 +111,30 @@ struct Impl_OutlineItem {
 
 /*----------------------------------------------------------------------------------------------*/
 
+iDeclareType(WideBlockBuf)
+
+/* Offscreen copy of a horizontally scrollable preformatted block, in tiles of fixed height
+   so that only the part in view needs texture memory. */
+struct Impl_WideBlockBuf {
+    uint16_t      preId;
+    iRect         bounds; /* document coordinates */
+    size_t        numTiles;
+    SDL_Texture **tiles; /* NULL until rendered; no tiles if the block is too wide */
+};
+
+enum { tileHeight_WideBlockBuf_ = 512 };
+
+/*----------------------------------------------------------------------------------------------*/
+
 static void animatePlayers_DocumentWidget_      (iDocumentWidget *d);
 static void updateSideIconBuf_DocumentWidget_   (iDocumentWidget *d);
+static void scheduleMediaRequests_DocumentWidget_(iDocumentWidget *d);
+static iBool hasPendingMedia_DocumentWidget_    (const iDocumentWidget *d);
+static iBool isMediaScheduleStale_DocumentWidget_(const iDocumentWidget *d);
+static iRect playerRect_DocumentWidget_         (const iDocumentWidget *d, const iGmRun *run);
+static void releaseWideBlockBufs_DocumentWidget_(iDocumentWidget *d);
+static iRangei visibleRange_DocumentWidget_     (const iDocumentWidget *d);
+static int  runOffset_DocumentWidget_           (const iDocumentWidget *d, const iGmRun *run);
 
 static const int smoothDuration_DocumentWidget_  = 600; /* milliseconds */
 static const int outlineMinWidth_DocumentWdiget_ = 45;  /* times gap_UI */
@@ -127,6 +152,7 @@ enum iDocumentWidgetFlag {
     selecting_DocumentWidgetFlag             = iBit(1),
     noHoverWhileScrolling_DocumentWidgetFlag = iBit(2),
     showLinkNumbers_DocumentWidgetFlag       = iBit(3),
+    pendingSideIcon_DocumentWidgetFlag       = iBit(4), /* postponed by a busy frame */
 };
 
 enum iDocumentLinkOrdinalMode {
@@ -144,6 +170,7 @@ struct Impl_DocumentWidget {
     iGmRequest *   request;
     iAtomicInt     isRequestUpdated; /* request has new content, need to parse it */
     iObjectList *  media;
+    int            mediaScheduleTop; /* visible range top when media was last scheduled */
     iString        sourceMime;
     iBlock         sourceContent; /* original content as received, for saving */
     iTime          sourceTime;
@@ -157,13 +184,19 @@ struct Impl_DocumentWidget {
     iRangecc       foundMark;
     int            pageMargin;
     iPtrArray      visibleLinks;
+    iArray         visibleLinkRows; /* iRanges of visibleLinks overlapping each hover grid row */
+    int            visibleLinkRowsTop;
+    int            visibleLinkRowHeight;
+    iArray         visibleLinkIds; /* iRanges of visibleLinks for each link ID from the first */
+    iGmLinkId      firstVisibleLinkId;
     iPtrArray      visibleWideRuns; /* scrollable blocks */
     iArray         wideRunOffsets;
     iAnim          animWideRunOffset;
     uint16_t       animWideRunId;
     iGmRunRange    animWideRunRange;
+    iArray         wideBlockBufs; /* rendered lazily for the visible wide runs */
     iPtrArray      visiblePlayers; /* currently playing audio */
-    const iGmRun * grabbedPlayer; /* currently adjusting volume in a player */
+    const iGmRun * grabbedPlayer; /* currently adjusting volume or seeking in a player */
     float          grabbedStartVolume;
     int            playerTimer;
     const iGmRun * hoverLink;
@@ -184,6 +217,11 @@ struct Impl_DocumentWidget {
     iPtrSet *      invalidRuns;
     SDL_Texture *  sideIconBuf;
     iTextBuf *     timestampBuf;
+    iBlock *       pendingState; /* serialized state not yet deserialized (background tab) */
+    size_t         pendingStatePos;
+    size_t         pendingStateSize;
+    iString        pendingTitle; /* title of the document when it was saved */
+    iChar          pendingSiteIcon;
 };
 
 iDefineObjectConstruction(DocumentWidget)
@@ -204,6 +242,7 @@ void init_DocumentWidget(iDocumentWidget *d) {
     d->request          = NULL;
     d->isRequestUpdated = iFalse;
     d->media            = new_ObjectList();
+    d->mediaScheduleTop = 0;
     d->doc              = new_GmDocument();
     d->redirectCount    = 0;
     d->initNormScrollY  = 0;
@@ -218,6 +257,8 @@ void init_DocumentWidget(iDocumentWidget *d) {
     d->firstVisibleRun  = NULL;
     d->lastVisibleRun   = NULL;
     d->visBuf           = new_VisBuf();
+    /* Quarter-page tiles with extra ones for prerendering ahead of scrolling. */
+    setTiles_VisBuf(d->visBuf, 10, 4);
     d->invalidRuns      = new_PtrSet();
     init_Array(&d->outline, sizeof(iOutlineItem));
     init_Anim(&d->sideOpacity, 0);
@@ -226,8 +267,14 @@ void init_DocumentWidget(iDocumentWidget *d) {
     init_Block(&d->sourceContent, 0);
     iZap(d->sourceTime);
     init_PtrArray(&d->visibleLinks);
+    init_Array(&d->visibleLinkRows, sizeof(iRanges));
+    d->visibleLinkRowsTop   = 0;
+    d->visibleLinkRowHeight = 1;
+    init_Array(&d->visibleLinkIds, sizeof(iRanges));
+    d->firstVisibleLinkId   = 0;
     init_PtrArray(&d->visibleWideRuns);
     init_Array(&d->wideRunOffsets, sizeof(int));
+    init_Array(&d->wideBlockBufs, sizeof(iWideBlockBuf));
     init_PtrArray(&d->visiblePlayers);
     d->grabbedPlayer = NULL;
     d->playerTimer   = 0;
@@ -238,6 +285,11 @@ void init_DocumentWidget(iDocumentWidget *d) {
     d->playerMenu   = NULL;
     d->sideIconBuf  = NULL;
     d->timestampBuf = NULL;
+    d->pendingState     = NULL;
+    d->pendingStatePos  = 0;
+    d->pendingStateSize = 0;
+    init_String(&d->pendingTitle);
+    d->pendingSiteIcon  = 0;
     addChildFlags_Widget(w,
                          iClob(new_IndicatorWidget()),
                          resizeToParentWidth_WidgetFlag | resizeToParentHeight_WidgetFlag);
@@ -256,6 +308,10 @@ void deinit_DocumentWidget(iDocumentWidget *d) {
         SDL_DestroyTexture(d->sideIconBuf);
     }
     delete_TextBuf(d->timestampBuf);
+    if (d->pendingState) {
+        delete_Block(d->pendingState);
+    }
+    deinit_String(&d->pendingTitle);
     delete_VisBuf(d->visBuf);
     delete_PtrSet(d->invalidRuns);
     deinit_Array(&d->outline);
@@ -268,9 +324,13 @@ void deinit_DocumentWidget(iDocumentWidget *d) {
     if (d->playerTimer) {
         SDL_RemoveTimer(d->playerTimer);
     }
+    releaseWideBlockBufs_DocumentWidget_(d);
+    deinit_Array(&d->wideBlockBufs);
     deinit_Array(&d->wideRunOffsets);
     deinit_PtrArray(&d->visiblePlayers);
     deinit_PtrArray(&d->visibleWideRuns);
+    deinit_Array(&d->visibleLinkIds);
+    deinit_Array(&d->visibleLinkRows);
     deinit_PtrArray(&d->visibleLinks);
     delete_Block(d->certFingerprint);
     delete_String(d->certSubject);
@@ -278,6 +338,187 @@ void deinit_DocumentWidget(iDocumentWidget *d) {
     deinit_PersistentDocumentState(&d->mod);
 }
 
+static void materializeState_DocumentWidget_(iDocumentWidget *d) {
+    if (d->pendingState) {
+        iBlock *state = d->pendingState;
+        d->pendingState = NULL;
+        iBuffer *buf = new_Buffer();
+        open_Buffer(buf, state);
+        setVersion_Stream(stream_Buffer(buf), latest_FileVersion);
+        seek_Stream(stream_Buffer(buf), d->pendingStatePos);
+        deserializeState_DocumentWidget(d, stream_Buffer(buf));
+        iRelease(buf);
+        delete_Block(state);
+        clear_String(&d->pendingTitle);
+        d->pendingSiteIcon = 0;
+    }
+}
+
+static void deinit_WideBlockBuf_(iWideBlockBuf *d) {
+    for (size_t i = 0; i < d->numTiles; i++) {
+        if (d->tiles[i]) {
+            SDL_DestroyTexture(d->tiles[i]);
+        }
+    }
+    free(d->tiles);
+}
+
+static iRangei tileRange_WideBlockBuf_(const iWideBlockBuf *d, size_t index) {
+    const int top = top_Rect(d->bounds) + (int) index * tileHeight_WideBlockBuf_;
+    return (iRangei){ top, iMin(top + tileHeight_WideBlockBuf_, bottom_Rect(d->bounds)) };
+}
+
+static void releaseWideBlockBufs_DocumentWidget_(iDocumentWidget *d) {
+    iForEach(Array, i, &d->wideBlockBufs) {
+        deinit_WideBlockBuf_(i.value);
+    }
+    clear_Array(&d->wideBlockBufs);
+}
+
+static const iWideBlockBuf *findWideBlockBuf_DocumentWidget_(const iDocumentWidget *d,
+                                                             uint16_t preId) {
+    iConstForEach(Array, i, &d->wideBlockBufs) {
+        const iWideBlockBuf *buf = i.value;
+        if (buf->preId == preId) {
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+static void pruneWideBlockBufs_DocumentWidget_(iDocumentWidget *d) {
+    /* Buffers are only kept for blocks that are still visible, and only the tiles that are
+       in or next to the view. */
+    const iRangei visRange = visibleRange_DocumentWidget_(d);
+    const iRangei keep     = { visRange.start - tileHeight_WideBlockBuf_,
+                               visRange.end + tileHeight_WideBlockBuf_ };
+    iForEach(Array, i, &d->wideBlockBufs) {
+        iWideBlockBuf *buf = i.value;
+        iBool isVisible = iFalse;
+        iConstForEach(PtrArray, j, &d->visibleWideRuns) {
+            const iGmRun *run = j.ptr;
+            if (run->preId == buf->preId) {
+                isVisible = iTrue;
+                break;
+            }
+        }
+        if (!isVisible) {
+            deinit_WideBlockBuf_(buf);
+            remove_ArrayIterator(&i);
+            continue;
+        }
+        for (size_t t = 0; t < buf->numTiles; t++) {
+            if (buf->tiles[t] && !isOverlapping_Rangei(keep, tileRange_WideBlockBuf_(buf, t))) {
+                SDL_DestroyTexture(buf->tiles[t]);
+                buf->tiles[t] = NULL;
+            }
+        }
+    }
+}
+
+static void updateWideBlockBufs_DocumentWidget_(iDocumentWidget *d) {
+    /* Blocks get a buffer once they have been scrolled sideways. The tiles overlapping the
+       view are rendered when first needed. */
+    SDL_Renderer *render = renderer_Window(get_Window());
+    SDL_RendererInfo info;
+    SDL_GetRendererInfo(render, &info);
+    const iRangei visRange = visibleRange_DocumentWidget_(d);
+    iConstForEach(PtrArray, i, &d->visibleWideRuns) {
+        const iGmRun *run = i.ptr;
+        iWideBlockBuf *buf = iConstCast(iWideBlockBuf *, findWideBlockBuf_DocumentWidget_(d, run->preId));
+        if (!buf) {
+            if (!runOffset_DocumentWidget_(d, run)) {
+                continue; /* not scrolled */
+            }
+            const iGmRunRange range = findPreformattedRange_GmDocument(d->doc, run);
+            iInt2 topLeft = range.start->visBounds.pos, bottomRight = topLeft;
+            for (const iGmRun *r = range.start; r != range.end; r++) {
+                topLeft     = min_I2(topLeft, topLeft_Rect(r->visBounds));
+                bottomRight = max_I2(bottomRight, bottomRight_Rect(r->visBounds));
+            }
+            iWideBlockBuf newBuf = { .preId = run->preId,
+                                     .bounds = initCorners_Rect(topLeft, bottomRight) };
+            /* Blocks wider than a texture keep being drawn directly. */
+            if (!isEmpty_Rect(newBuf.bounds) &&
+                (info.max_texture_width <= 0 || width_Rect(newBuf.bounds) <= info.max_texture_width)) {
+                newBuf.numTiles = (height_Rect(newBuf.bounds) + tileHeight_WideBlockBuf_ - 1) /
+                                  tileHeight_WideBlockBuf_;
+                newBuf.tiles = calloc(newBuf.numTiles, sizeof(SDL_Texture *));
+            }
+            pushBack_Array(&d->wideBlockBufs, &newBuf);
+            buf = (iWideBlockBuf *) back_Array(&d->wideBlockBufs);
+        }
+        for (size_t t = 0; t < buf->numTiles; t++) {
+            const iRangei tileRange = tileRange_WideBlockBuf_(buf, t);
+            if (buf->tiles[t] || !isOverlapping_Rangei(visRange, tileRange)) {
+                continue;
+            }
+            SDL_Texture *tile = SDL_CreateTexture(render,
+                                                  SDL_PIXELFORMAT_RGBA8888,
+                                                  SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET,
+                                                  width_Rect(buf->bounds),
+                                                  size_Range(&tileRange));
+            if (!tile) {
+                continue;
+            }
+            const iInt2 origin = init_I2(left_Rect(buf->bounds), tileRange.start);
+            const iGmRunRange range = findPreformattedRange_GmDocument(d->doc, run);
+            iPaint p;
+            init_Paint(&p);
+            beginTarget_Paint(&p, tile);
+            fillRect_Paint(&p, (iRect){ zero_I2(), init_I2(width_Rect(buf->bounds),
+                                                           size_Range(&tileRange)) },
+                           tmBackground_ColorId);
+            for (const iGmRun *r = range.start; r != range.end; r++) {
+                if (isOverlapping_Rangei(tileRange, (iRangei){ top_Rect(r->visBounds),
+                                                              bottom_Rect(r->visBounds) })) {
+                    drawRange_Text(r->font, sub_I2(r->visBounds.pos, origin), r->color, r->text);
+                }
+            }
+            endTarget_Paint(&p);
+            buf->tiles[t] = tile;
+        }
+    }
+}
+
+static iBool drawRun_WideBlockBuf_(const iWideBlockBuf *d, SDL_Renderer *render,
+                                   const iGmRun *run, iInt2 visPos) {
+    /* Copies the run from the tiles it overlaps. Scrolling only moves the source rectangle
+       within the prerendered block. Returns False if a tile is missing. */
+    const int top      = top_Rect(run->visBounds);
+    const int bottom   = bottom_Rect(run->visBounds);
+    const int first    = (top - top_Rect(d->bounds)) / tileHeight_WideBlockBuf_;
+    const int last     = (bottom - 1 - top_Rect(d->bounds)) / tileHeight_WideBlockBuf_;
+    const int clipLeft = iMax(0, -visPos.x);
+    const int width    = width_Rect(run->visBounds) - clipLeft;
+    if (first < 0 || last >= (int) d->numTiles) {
+        return iFalse;
+    }
+    for (int t = first; t <= last; t++) {
+        if (!d->tiles[t]) {
+            return iFalse;
+        }
+    }
+    if (width <= 0) {
+        return iTrue;
+    }
+    for (int t = first; t <= last; t++) {
+        const iRangei tileRange = tileRange_WideBlockBuf_(d, t);
+        const iRangei part      = { iMax(top, tileRange.start), iMin(bottom, tileRange.end) };
+        SDL_RenderCopy(render,
+                       d->tiles[t],
+                       &(SDL_Rect){ run->visBounds.pos.x - d->bounds.pos.x + clipLeft,
+                                    part.start - tileRange.start,
+                                    width,
+                                    size_Range(&part) },
+                       &(SDL_Rect){ visPos.x + clipLeft,
+                                    visPos.y + part.start - top,
+                                    width,
+                                    size_Range(&part) });
+    }
+    return iTrue;
+}
+
 static void resetWideRuns_DocumentWidget_(iDocumentWidget *d) {
     clear_Array(&d->wideRunOffsets);
     d->animWideRunId = 0;
@@ -350,6 +591,25 @@ static iRangei visibleRange_DocumentWidget_(const iDocumentWidget *d) {
                           margin };
 }
 
+static iRangei aheadRange_DocumentWidget_(const iDocumentWidget *d) {
+    /* Where the view will be when scrolling stops, and some more in the same direction. */
+    const iRangei vis    = visibleRange_DocumentWidget_(d);
+    const int     height = vis.end - vis.start;
+    const int     delta  = targetValue_Anim(&d->scrollY) - value_Anim(&d->scrollY);
+    iRangei       ahead  = { iMin(vis.start, vis.start + delta), iMax(vis.end, vis.end + delta) };
+    if (delta > 0) {
+        ahead.end += height;
+    }
+    else if (delta < 0) {
+        ahead.start -= height;
+    }
+    else {
+        ahead.start -= height / 2;
+        ahead.end   += height / 2;
+    }
+    return ahead;
+}
+
 static void addVisible_DocumentWidget_(void *context, const iGmRun *run) {
     iDocumentWidget *d = context;
     if (~run->flags & decoration_GmRunFlag && !run->imageId) {
@@ -382,10 +642,81 @@ static int scrollMax_DocumentWidget_(const iDocumentWidget *d) {
            (hasSiteBanner_GmDocument(d->doc) ? 1 : 2) * d->pageMargin * gap_UI;
 }
 
+static void indexVisibleLinks_DocumentWidget_(iDocumentWidget *d, iRangei visRange) {
+    /* The visible range is divided into rows of about one line of text. Each row and each
+       link ID gets the range of visible link runs it covers, so finding the runs under the
+       mouse or belonging to a link does not need to go through all of them. Runs are in
+       document order, so the ranges are short. */
+    const size_t numRuns = size_PtrArray(&d->visibleLinks);
+    d->visibleLinkRowHeight = iMax(1, lineHeight_Text(paragraph_FontId));
+    d->visibleLinkRowsTop   = visRange.start;
+    const int numRows = iMax(1, size_Range(&visRange) / d->visibleLinkRowHeight + 1);
+    resize_Array(&d->visibleLinkRows, numRows);
+    memset(data_Array(&d->visibleLinkRows), 0, sizeof(iRanges) * numRows);
+    clear_Array(&d->visibleLinkIds);
+    d->firstVisibleLinkId = 0;
+    iConstForEach(PtrArray, j, &d->visibleLinks) {
+        const iGmRun *run = j.ptr;
+        if (!d->firstVisibleLinkId || run->linkId < d->firstVisibleLinkId) {
+            d->firstVisibleLinkId = run->linkId;
+        }
+    }
+    for (size_t i = 0; i < numRuns; i++) {
+        const iGmRun *run = constAt_PtrArray(&d->visibleLinks, i);
+        /* Rows. */ {
+            const int first = iClamp((top_Rect(run->bounds) - d->visibleLinkRowsTop) /
+                                         d->visibleLinkRowHeight, 0, numRows - 1);
+            const int last  = iClamp((bottom_Rect(run->bounds) - 1 - d->visibleLinkRowsTop) /
+                                         d->visibleLinkRowHeight, 0, numRows - 1);
+            for (int row = first; row <= last; row++) {
+                iRanges *runs = at_Array(&d->visibleLinkRows, row);
+                if (isEmpty_Range(runs)) {
+                    runs->start = i;
+                }
+                runs->end = i + 1;
+            }
+        }
+        /* Link IDs. */ {
+            const size_t index = run->linkId - d->firstVisibleLinkId;
+            if (index >= size_Array(&d->visibleLinkIds)) {
+                const size_t oldSize = size_Array(&d->visibleLinkIds);
+                resize_Array(&d->visibleLinkIds, index + 1);
+                memset(at_Array(&d->visibleLinkIds, oldSize), 0,
+                       sizeof(iRanges) * (index + 1 - oldSize));
+            }
+            iRanges *runs = at_Array(&d->visibleLinkIds, index);
+            if (isEmpty_Range(runs)) {
+                runs->start = i;
+            }
+            runs->end = i + 1;
+        }
+    }
+}
+
+static const iGmRun *findVisibleLink_DocumentWidget_(const iDocumentWidget *d, iInt2 docPos) {
+    const int row = (docPos.y - d->visibleLinkRowsTop) / d->visibleLinkRowHeight;
+    if (docPos.y < d->visibleLinkRowsTop || row >= (int) size_Array(&d->visibleLinkRows)) {
+        return NULL;
+    }
+    const iRanges *runs = constAt_Array(&d->visibleLinkRows, row);
+    for (size_t i = runs->start; i < runs->end; i++) {
+        const iGmRun *run = constAt_PtrArray(&d->visibleLinks, i);
+        if (contains_Rect(run->bounds, docPos)) {
+            return run;
+        }
+    }
+    return NULL;
+}
+
 static void invalidateLink_DocumentWidget_(iDocumentWidget *d, iGmLinkId id) {
     /* A link has multiple runs associated with it. */
-    iConstForEach(PtrArray, i, &d->visibleLinks) {
-        const iGmRun *run = i.ptr;
+    if (id < d->firstVisibleLinkId ||
+        id - d->firstVisibleLinkId >= size_Array(&d->visibleLinkIds)) {
+        return; /* not visible */
+    }
+    const iRanges *runs = constAt_Array(&d->visibleLinkIds, id - d->firstVisibleLinkId);
+    for (size_t i = runs->start; i < runs->end; i++) {
+        const iGmRun *run = constAt_PtrArray(&d->visibleLinks, i);
         if (run->linkId == id) {
             insert_PtrSet(d->invalidRuns, run);
         }
@@ -432,13 +763,7 @@ static void updateHover_DocumentWidget_(iDocumentWidget *d, iInt2 mouse) {
     const iInt2 hoverPos = addY_I2(sub_I2(mouse, topLeft_Rect(docBounds)), value_Anim(&d->scrollY));
     if (isHover_Widget(w) && (~d->flags & noHoverWhileScrolling_DocumentWidgetFlag) &&
         (d->state == ready_RequestState || d->state == receivedPartialResponse_RequestState)) {
-        iConstForEach(PtrArray, i, &d->visibleLinks) {
-            const iGmRun *run = i.ptr;
-            if (contains_Rect(run->bounds, hoverPos)) {
-                d->hoverLink = run;
-                break;
-            }
-        }
+        d->hoverLink = findVisibleLink_DocumentWidget_(d, hoverPos);
     }
     if (d->hoverLink != oldHoverLink) {
         if (oldHoverLink) {
@@ -461,6 +786,7 @@ static void updateHover_DocumentWidget_(iDocumentWidget *d, iInt2 mouse) {
 
 static void animate_DocumentWidget_(void *ticker) {
     iDocumentWidget *d = ticker;
+    refresh_Widget(d);
     if (!isFinished_Anim(&d->sideOpacity) || !isFinished_Anim(&d->outlineOpacity)) {
         addTicker_App(animate_DocumentWidget_, d);
     }
@@ -514,10 +840,10 @@ static uint32_t postPlayerUpdate_DocumentWidget_(uint32_t interval, void *contex
 
 static void updatePlayers_DocumentWidget_(iDocumentWidget *d) {
     if (document_App() == d) {
-        refresh_Widget(d);
         iConstForEach(PtrArray, i, &d->visiblePlayers) {
             const iGmRun *run = i.ptr;
             iPlayer *     plr = audioPlayer_Media(media_GmDocument(d->doc), run->audioId);
+            postRefreshRect_App(playerRect_DocumentWidget_(d, run)); /* only the player changes */
             if (idleTimeMs_Player(plr) > 3000 && ~flags_Player(plr) & volumeGrabbed_PlayerFlag &&
                 flags_Player(plr) & adjustingVolume_PlayerFlag) {
                 setFlags_Player(plr, adjustingVolume_PlayerFlag, iFalse);
@@ -577,14 +903,25 @@ static void updateVisible_DocumentWidget_(iDocumentWidget *d) {
     /* Scan for visible runs. */ {
         d->firstVisibleRun = NULL;
         render_GmDocument(d->doc, visRange, addVisible_DocumentWidget_, d);
+        indexVisibleLinks_DocumentWidget_(d, visRange);
+        pruneWideBlockBufs_DocumentWidget_(d);
     }
     const iRangecc newHeading = currentHeading_DocumentWidget_(d);
     if (memcmp(&oldHeading, &newHeading, sizeof(oldHeading))) {
-        updateSideIconBuf_DocumentWidget_(d);
+        /* The side heading can wait until there is time to spare in a frame. */
+        if (isFrameLate_App()) {
+            d->flags |= pendingSideIcon_DocumentWidgetFlag;
+        }
+        else {
+            updateSideIconBuf_DocumentWidget_(d);
+        }
     }
     updateHover_DocumentWidget_(d, mouseCoord_Window(get_Window()));
     updateSideOpacity_DocumentWidget_(d, iTrue);
     animatePlayers_DocumentWidget_(d);
+    if (isMediaScheduleStale_DocumentWidget_(d) && hasPendingMedia_DocumentWidget_(d)) {
+        scheduleMediaRequests_DocumentWidget_(d);
+    }
     /* Remember scroll positions of recently visited pages. */ {
         iRecentUrl *recent = mostRecentUrl_History(d->mod.history);
         if (recent && docSize && d->state == ready_RequestState) {
@@ -600,8 +937,10 @@ static void updateWindowTitle_DocumentWidget_(const iDocumentWidget *d) {
         return;
     }
     iStringArray *title = iClob(new_StringArray());
-    if (!isEmpty_String(title_GmDocument(d->doc))) {
-        pushBack_StringArray(title, title_GmDocument(d->doc));
+    /* Tabs not yet shown use the title that was saved with them. */
+    const iString *docTitle = d->pendingState ? &d->pendingTitle : title_GmDocument(d->doc);
+    if (!isEmpty_String(docTitle)) {
+        pushBack_StringArray(title, docTitle);
     }
     if (!isEmpty_String(d->titleUser)) {
         pushBack_StringArray(title, d->titleUser);
@@ -629,7 +968,8 @@ static void updateWindowTitle_DocumentWidget_(const iDocumentWidget *d) {
             setTitle_Window(get_Window(), text);
             setWindow = iFalse;
         }
-        const iChar siteIcon = siteIcon_GmDocument(d->doc);
+        const iChar siteIcon =
+            d->pendingState ? d->pendingSiteIcon : siteIcon_GmDocument(d->doc);
         if (siteIcon) {
             if (!isEmpty_String(text)) {
                 prependCStr_String(text, " ");
@@ -674,6 +1014,7 @@ static void updateTimestampBuf_DocumentWidget_(iDocumentWidget *d) {
 static void invalidate_DocumentWidget_(iDocumentWidget *d) {
     invalidate_VisBuf(d->visBuf);
     clear_PtrSet(d->invalidRuns);
+    releaseWideBlockBufs_DocumentWidget_(d);
 }
 
 static int outlineWidth_DocumentWidget_(const iDocumentWidget *d) {
@@ -885,6 +1226,7 @@ static void updateDocument_DocumentWidget_(iDocumentWidget *d, const iGmResponse
                         format_String(&str, "=> %s %s\n", cstr_String(d->mod.url), linkTitle);
                         setData_Media(media_GmDocument(d->doc),
                                       1,
+                                      d->mod.url,
                                       mimeStr,
                                       &response->body,
                                       !isRequestFinished ? partialData_MediaFlag : 0);
@@ -894,6 +1236,7 @@ static void updateDocument_DocumentWidget_(iDocumentWidget *d, const iGmResponse
                         /* Update the audio content. */
                         setData_Media(media_GmDocument(d->doc),
                                       1,
+                                      d->mod.url,
                                       mimeStr,
                                       &response->body,
                                       !isRequestFinished ? partialData_MediaFlag : 0);
@@ -1029,6 +1372,7 @@ static void refreshWhileScrolling_DocumentWidget_(iAny *ptr) {
     updateVisible_DocumentWidget_(d);
     refresh_Widget(d);
     if (d->animWideRunId) {
+        /* Cheap to redraw: the runs are copied from the block's offscreen buffer. */
         for (const iGmRun *r = d->animWideRunRange.start; r != d->animWideRunRange.end; r++) {
             insert_PtrSet(d->invalidRuns, r);
         }
@@ -1036,7 +1380,11 @@ static void refreshWhileScrolling_DocumentWidget_(iAny *ptr) {
     if (isFinished_Anim(&d->animWideRunOffset)) {
         d->animWideRunId = 0;
     }
-    if (!isFinished_Anim(&d->scrollY) || !isFinished_Anim(&d->animWideRunOffset)) {
+    if (d->flags & pendingSideIcon_DocumentWidgetFlag && !isFrameLate_App()) {
+        updateSideIconBuf_DocumentWidget_(d);
+    }
+    if (!isFinished_Anim(&d->scrollY) || !isFinished_Anim(&d->animWideRunOffset) ||
+        d->flags & pendingSideIcon_DocumentWidgetFlag) {
         addTicker_App(refreshWhileScrolling_DocumentWidget_, d);
     }
 }
@@ -1291,10 +1639,102 @@ static iMediaRequest *findMediaRequest_DocumentWidget_(const iDocumentWidget *d,
     return NULL;
 }
 
-static iBool requestMedia_DocumentWidget_(iDocumentWidget *d, iGmLinkId linkId) {
+iDeclareType(MediaSchedule)
+
+struct Impl_MediaSchedule {
+    iMediaRequest *req;
+    int            distance; /* from the visible range; INT_MAX if the link wasn't found */
+};
+
+static int cmp_MediaSchedule_(const void *a, const void *b) {
+    return iCmp(((const iMediaSchedule *) a)->distance, ((const iMediaSchedule *) b)->distance);
+}
+
+static int mediaDistance_DocumentWidget_(const iDocumentWidget *d, iGmLinkId linkId,
+                                         iRangei visRange) {
+    const iRangei span = linkSpan_GmDocument(d->doc, linkId);
+    if (isEmpty_Range(&span)) {
+        return INT_MAX; /* not in the layout */
+    }
+    return span.end < visRange.start   ? visRange.start - span.end
+           : span.start > visRange.end ? span.start - visRange.end
+                                       : 0;
+}
+
+static void scheduleMediaRequests_DocumentWidget_(iDocumentWidget *d) {
+    /* Automatically requested images are fetched a few at a time, nearest to the viewport
+       first. Downloads that have scrolled far out of view keep going but no longer count
+       against the limit, so they don't hold up the ones being looked at. Only when too many
+       of them have piled up are the farthest ones put back in the queue. Requests made by
+       clicking a link are always submitted immediately. */
+    const int maxRunning = prefs_App()->maxMediaFetches;
+    const iRangei visRange = visibleRange_DocumentWidget_(d);
+    const int     farAway  = 2 * size_Range(&visRange);
+    int numRunning = 0; /* near the viewport */
+    int numTotal   = 0;
+    iArray schedule;
+    init_Array(&schedule, sizeof(iMediaSchedule));
+    d->mediaScheduleTop = visRange.start;
+    iForEach(ObjectList, i, d->media) {
+        iMediaRequest *req = (iMediaRequest *) i.object;
+        if (req->isExplicit) {
+            submit_MediaRequest(req);
+            continue;
+        }
+        if (req->isSubmitted && isFinished_GmRequest(req->req)) {
+            continue;
+        }
+        const iMediaSchedule sch = { req, mediaDistance_DocumentWidget_(d, req->linkId, visRange) };
+        if (req->isSubmitted && sch.distance <= farAway) {
+            numRunning++;
+        }
+        pushBack_Array(&schedule, &sch);
+    }
+    sort_Array(&schedule, cmp_MediaSchedule_);
+    iConstForEach(Array, i, &schedule) {
+        const iMediaSchedule *sch = i.value;
+        const iBool isFar = sch->distance > farAway;
+        if (sch->req->isSubmitted) {
+            if (isFar && numTotal >= 2 * maxRunning) {
+                requeue_MediaRequest(sch->req); /* the received data is discarded */
+            }
+            else {
+                numTotal++;
+            }
+        }
+        else if (!isFar && numRunning < maxRunning) {
+            submit_MediaRequest(sch->req);
+            numRunning++;
+            numTotal++;
+        }
+    }
+    deinit_Array(&schedule);
+}
+
+static iBool isMediaScheduleStale_DocumentWidget_(const iDocumentWidget *d) {
+    /* Distances only change meaningfully after scrolling by a good part of the view. */
+    const iRangei visRange = visibleRange_DocumentWidget_(d);
+    return iAbs(visRange.start - d->mediaScheduleTop) >= size_Range(&visRange) / 2;
+}
+
+static iBool hasPendingMedia_DocumentWidget_(const iDocumentWidget *d) {
+    iConstForEach(ObjectList, i, d->media) {
+        const iMediaRequest *req = (const iMediaRequest *) i.object;
+        if (!req->isExplicit && (!req->isSubmitted || !isFinished_GmRequest(req->req))) {
+            return iTrue;
+        }
+    }
+    return iFalse;
+}
+
+static iBool requestMedia_DocumentWidget_(iDocumentWidget *d, iGmLinkId linkId,
+                                          iBool isExplicit) {
     if (!findMediaRequest_DocumentWidget_(d, linkId)) {
         const iString *imageUrl = absoluteUrl_String(d->mod.url, linkUrl_GmDocument(d->doc, linkId));
-        pushBack_ObjectList(d->media, iClob(new_MediaRequest(d, linkId, imageUrl)));
+        iMediaRequest *req = new_MediaRequest(d, linkId, imageUrl);
+        req->isExplicit = isExplicit;
+        pushBack_ObjectList(d->media, iClob(req));
+        scheduleMediaRequests_DocumentWidget_(d);
         invalidate_DocumentWidget_(d);
         return iTrue;
     }
@@ -1314,23 +1754,26 @@ static iBool handleMediaCommand_DocumentWidget_(iDocumentWidget *d, const char *
     if (!isOurRequest) {
         return iFalse;
     }
-    if (equal_Command(cmd, "media.updated")) {
+    if (id_Command(cmd) == mediaUpdated_CommandId) {
         /* Pass new data to media players. */
         const enum iGmStatusCode code = status_GmRequest(req->req);
         if (isSuccess_GmStatusCode(code)) {
             iGmResponse *resp = lockResponse_GmRequest(req->req);
-            if (startsWith_String(&resp->meta, "audio/")) {
+            if (startsWith_String(&resp->meta, "audio/") ||
+                startsWith_String(&resp->meta, "image/")) {
                 /* TODO: Use a helper? This is same as below except for the partialData flag. */
                 if (setData_Media(media_GmDocument(d->doc),
                                   req->linkId,
+                                  url_GmRequest(req->req),
                                   &resp->meta,
                                   &resp->body,
                                   partialData_MediaFlag | allowHide_MediaFlag)) {
+                    /* A placeholder of the image's size was added. Otherwise the layout is
+                       unchanged, and the decoded data arrives later via "media.decoded". */
                     redoLayout_GmDocument(d->doc);
+                    updateVisible_DocumentWidget_(d);
+                    invalidate_DocumentWidget_(d);
                 }
-                updateVisible_DocumentWidget_(d);
-                invalidate_DocumentWidget_(d);
-                refresh_Widget(as_Widget(d));
             }
             unlockResponse_GmRequest(req->req);
         }
@@ -1339,7 +1782,11 @@ static iBool handleMediaCommand_DocumentWidget_(iDocumentWidget *d, const char *
         refresh_Widget(d);
         return iTrue;
     }
-    else if (equal_Command(cmd, "media.finished")) {
+    else if (id_Command(cmd) == mediaFinished_CommandId) {
+        if (!isFinished_GmRequest(req->req)) {
+            return iTrue; /* notification from a request that has since been requeued */
+        }
+        scheduleMediaRequests_DocumentWidget_(d);
         const enum iGmStatusCode code = status_GmRequest(req->req);
         /* Give the media to the document for presentation. */
         if (isSuccess_GmStatusCode(code)) {
@@ -1347,6 +1794,7 @@ static iBool handleMediaCommand_DocumentWidget_(iDocumentWidget *d, const char *
                 startsWith_String(meta_GmRequest(req->req), "audio/")) {
                 setData_Media(media_GmDocument(d->doc),
                               req->linkId,
+                              url_GmRequest(req->req),
                               meta_GmRequest(req->req),
                               body_GmRequest(req->req),
                               allowHide_MediaFlag);
@@ -1378,7 +1826,10 @@ static void allocVisBuffer_DocumentWidget_(const iDocumentWidget *d) {
     }
 }
 
-static iBool fetchNextUnfetchedImage_DocumentWidget_(iDocumentWidget *d) {
+static iBool fetchUnfetchedImages_DocumentWidget_(iDocumentWidget *d) {
+    /* All visible images are queued at once; the scheduler decides how many are fetched
+       concurrently. */
+    iBool isQueued = iFalse;
     iConstForEach(PtrArray, i, &d->visibleLinks) {
         const iGmRun *run = i.ptr;
         if (run->linkId && !run->imageId && ~run->flags & decoration_GmRunFlag) {
@@ -1386,13 +1837,13 @@ static iBool fetchNextUnfetchedImage_DocumentWidget_(iDocumentWidget *d) {
             if (isMediaLink_GmDocument(d->doc, run->linkId) &&
                 linkFlags & imageFileExtension_GmLinkFlag &&
                 ~linkFlags & content_GmLinkFlag && ~linkFlags & permanent_GmLinkFlag ) {
-                if (requestMedia_DocumentWidget_(d, run->linkId)) {
-                    return iTrue;
+                if (requestMedia_DocumentWidget_(d, run->linkId, iFalse)) {
+                    isQueued = iTrue;
                 }
             }
         }
     }
-    return iFalse;
+    return isQueued;
 }
 
 static void saveToDownloads_(const iString *url, const iString *mime, const iBlock *content) {
@@ -1469,7 +1920,8 @@ static void saveToDownloads_(const iString *url, const iString *mime, const iBlo
 
 static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd) {
     iWidget *w = as_Widget(d);
-    if (equal_Command(cmd, "window.resized") || equal_Command(cmd, "font.changed")) {
+    const enum iCommandId cmdId = id_Command(cmd);
+    if (cmdId == windowResized_CommandId || equal_Command(cmd, "font.changed")) {
         const iGmRun *mid = middleRun_DocumentWidget_(d);
         const char *midLoc = (mid ? mid->text.start : NULL);
         /* Alt/Option key may be involved in window size changes. */
@@ -1514,6 +1966,7 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
     else if (equal_Command(cmd, "tabs.changed")) {
         iChangeFlags(d->flags, showLinkNumbers_DocumentWidgetFlag, iFalse);
         if (cmp_String(id_Widget(w), suffixPtr_Command(cmd, "id")) == 0) {
+            materializeState_DocumentWidget_(d);
             /* Set palette for our document. */
             updateTheme_DocumentWidget_(d);
             updateTrust_DocumentWidget_(d, NULL);
@@ -1620,7 +2073,7 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
         postCommand_App("navigate.back");
         return iTrue;
     }
-    else if (equalWidget_Command(cmd, w, "document.request.updated") &&
+    else if (isWidget_Command(cmd, w, documentRequestUpdated_CommandId) &&
              d->request && pointerLabel_Command(cmd, "request") == d->request) {
         set_Block(&d->sourceContent, &lockResponse_GmRequest(d->request)->body);
         unlockResponse_GmRequest(d->request);
@@ -1631,7 +2084,7 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
         set_Atomic(&d->isRequestUpdated, iFalse); /* ready to be notified again */
         return iFalse;
     }
-    else if (equalWidget_Command(cmd, w, "document.request.finished") &&
+    else if (isWidget_Command(cmd, w, documentRequestFinished_CommandId) &&
              pointerLabel_Command(cmd, "request") == d->request) {
         set_Block(&d->sourceContent, body_GmRequest(d->request));
         updateFetchProgress_DocumentWidget_(d);
@@ -1657,9 +2110,38 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
         }
         return iFalse;
     }
-    else if (equal_Command(cmd, "media.updated") || equal_Command(cmd, "media.finished")) {
+    else if (cmdId == mediaUpdated_CommandId || cmdId == mediaFinished_CommandId) {
         return handleMediaCommand_DocumentWidget_(d, cmd);
     }
+    else if (cmdId == mediaDecoded_CommandId) {
+        iMedia *media = media_GmDocument(d->doc);
+        if (pointerLabel_Command(cmd, "owner") != media) {
+            return iFalse;
+        }
+        iArray decodedLinkIds;
+        init_Array(&decodedLinkIds, sizeof(iGmLinkId));
+        if (updateDecoded_Media(media, &decodedLinkIds)) {
+            redoLayout_GmDocument(d->doc);
+            updateVisible_DocumentWidget_(d);
+            invalidate_DocumentWidget_(d);
+        }
+        else {
+            /* Only the decoded images need to be redrawn. Ones that are not entirely in view
+               may also be in retained offscreen tiles, which must be rendered again. */
+            const iRangei vis = visibleRange_DocumentWidget_(d);
+            iConstForEach(Array, i, &decodedLinkIds) {
+                const iGmLinkId linkId = *(const iGmLinkId *) i.value;
+                const iRangei   span   = linkSpan_GmDocument(d->doc, linkId);
+                invalidateLink_DocumentWidget_(d, linkId);
+                if (!isEmpty_Rangei(span) && (span.start < vis.start || span.end > vis.end)) {
+                    invalidateRange_VisBuf(d->visBuf, span);
+                }
+            }
+        }
+        deinit_Array(&decodedLinkIds);
+        refresh_Widget(w);
+        return iTrue;
+    }
     else if (equal_Command(cmd, "media.player.started")) {
         /* When one media player starts, pause the others that may be playing. */
         const iPlayer *startedPlr = pointerLabel_Command(cmd, "player");
@@ -1672,7 +2154,7 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
             }
         }
     }
-    else if (equal_Command(cmd, "media.player.update")) {
+    else if (cmdId == mediaPlayerUpdate_CommandId) {
         updatePlayers_DocumentWidget_(d);
         return iFalse;
     }
@@ -1769,11 +2251,11 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
         updateVisible_DocumentWidget_(d);
         return iTrue;
     }
-    else if (equal_Command(cmd, "scroll.page") && document_App() == d) {
+    else if (cmdId == scrollPage_CommandId && document_App() == d) {
         const int dir = arg_Command(cmd);
         if (dir > 0 && !argLabel_Command(cmd, "repeat") &&
             prefs_App()->loadImageInsteadOfScrolling &&
-            fetchNextUnfetchedImage_DocumentWidget_(d)) {
+            fetchUnfetchedImages_DocumentWidget_(d)) {
             return iTrue;
         }
         smoothScroll_DocumentWidget_(d,
@@ -1782,7 +2264,7 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
                                      smoothDuration_DocumentWidget_);
         return iTrue;
     }
-    else if (equal_Command(cmd, "scroll.top") && document_App() == d) {
+    else if (cmdId == scrollTop_CommandId && document_App() == d) {
         init_Anim(&d->scrollY, 0);
         invalidate_VisBuf(d->visBuf);
         scroll_DocumentWidget_(d, 0);
@@ -1790,7 +2272,7 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
         refresh_Widget(w);
         return iTrue;
     }
-    else if (equal_Command(cmd, "scroll.bottom") && document_App() == d) {
+    else if (cmdId == scrollBottom_CommandId && document_App() == d) {
         init_Anim(&d->scrollY, scrollMax_DocumentWidget_(d));
         invalidate_VisBuf(d->visBuf);
         scroll_DocumentWidget_(d, 0);
@@ -1798,11 +2280,11 @@ static iBool handleCommand_DocumentWidget_(iDocumentWidget *d, const char *cmd)
         refresh_Widget(w);
         return iTrue;
     }
-    else if (equal_Command(cmd, "scroll.step") && document_App() == d) {
+    else if (cmdId == scrollStep_CommandId && document_App() == d) {
         const int dir = arg_Command(cmd);
         if (dir > 0 && !argLabel_Command(cmd, "repeat") &&
             prefs_App()->loadImageInsteadOfScrolling &&
-            fetchNextUnfetchedImage_DocumentWidget_(d)) {
+            fetchUnfetchedImages_DocumentWidget_(d)) {
             return iTrue;
         }
         smoothScroll_DocumentWidget_(d,
@@ -1892,10 +2374,11 @@ static iRect playerRect_DocumentWidget_(const iDocumentWidget *d, const iGmRun *
     return moved_Rect(run->bounds, addY_I2(topLeft_Rect(docBounds), -value_Anim(&d->scrollY)));
 }
 
-static void setGrabbedPlayer_DocumentWidget_(iDocumentWidget *d, const iGmRun *run) {
+static void setGrabbedPlayer_DocumentWidget_(iDocumentWidget *d, const iGmRun *run,
+                                             int grabFlag) {
     if (run) {
         iPlayer *plr = audioPlayer_Media(media_GmDocument(d->doc), run->audioId);
-        setFlags_Player(plr, volumeGrabbed_PlayerFlag, iTrue);
+        setFlags_Player(plr, grabFlag, iTrue);
         d->grabbedStartVolume = volume_Player(plr);
         d->grabbedPlayer      = run;
         refresh_Widget(d);
@@ -1903,7 +2386,7 @@ static void setGrabbedPlayer_DocumentWidget_(iDocumentWidget *d, const iGmRun *r
     else if (d->grabbedPlayer) {
         setFlags_Player(
             audioPlayer_Media(media_GmDocument(d->doc), d->grabbedPlayer->audioId),
-            volumeGrabbed_PlayerFlag,
+            volumeGrabbed_PlayerFlag | seekGrabbed_PlayerFlag,
             iFalse);
         d->grabbedPlayer = NULL;
         refresh_Widget(d);
@@ -1932,6 +2415,9 @@ static iBool processPlayerEvents_DocumentWidget_(iDocumentWidget *d, const SDL_E
         const iGmRun *run  = i.ptr;
         const iRect   rect = playerRect_DocumentWidget_(d, run);
         iPlayer *     plr  = audioPlayer_Media(media_GmDocument(d->doc), run->audioId);
+        if (ev->type == SDL_MOUSEMOTION) {
+            postRefreshRect_App(rect); /* buttons are highlighted under the mouse */
+        }
         if (contains_Rect(rect, mouse)) {
             iPlayerUI ui;
             init_PlayerUI(&ui, plr, rect);
@@ -1940,12 +2426,24 @@ static iBool processPlayerEvents_DocumentWidget_(iDocumentWidget *d, const SDL_E
                                             zero_I2(),
                                             init_I2(-height_Rect(ui.volumeAdjustRect), 0)),
                               mouse)) {
-                setGrabbedPlayer_DocumentWidget_(d, run);
+                setGrabbedPlayer_DocumentWidget_(d, run, volumeGrabbed_PlayerFlag);
                 processEvent_Click(&d->click, ev);
                 /* The rest is done in the DocumentWidget click responder. */
                 refresh_Widget(d);
                 return iTrue;
             }
+            else if (ev->type == SDL_MOUSEBUTTONDOWN && seekableTime_Player(plr) > 0 &&
+                     contains_Rect(ui.scrubberRect, mouse) &&
+                     mouse.x >= ui.scrubberSpan.start - gap_UI &&
+                     mouse.x <= ui.scrubberSpan.end + gap_UI) {
+                /* Jump to the clicked position and keep following the mouse while dragging. */
+                seek_Player(plr, seekTime_PlayerUI(&ui, mouse));
+                setGrabbedPlayer_DocumentWidget_(d, run, seekGrabbed_PlayerFlag);
+                processEvent_Click(&d->click, ev);
+                animatePlayers_DocumentWidget_(d);
+                refresh_Widget(d);
+                return iTrue;
+            }
             else if (ev->type == SDL_MOUSEBUTTONDOWN || ev->type == SDL_MOUSEMOTION) {
                 refresh_Widget(d);
                 return iTrue;
@@ -2332,8 +2830,14 @@ static iBool processEvent_DocumentWidget_(iDocumentWidget *d, const SDL_Event *e
                     audioPlayer_Media(media_GmDocument(d->doc), d->grabbedPlayer->audioId);
                 iPlayerUI ui;
                 init_PlayerUI(&ui, plr, playerRect_DocumentWidget_(d, d->grabbedPlayer));
-                float off = (float) delta_Click(&d->click).x / (float) width_Rect(ui.volumeSlider);
-                setVolume_Player(plr, d->grabbedStartVolume + off);
+                if (flags_Player(plr) & seekGrabbed_PlayerFlag) {
+                    seek_Player(plr, seekTime_PlayerUI(&ui, pos_Click(&d->click)));
+                }
+                else {
+                    float off =
+                        (float) delta_Click(&d->click).x / (float) width_Rect(ui.volumeSlider);
+                    setVolume_Player(plr, d->grabbedStartVolume + off);
+                }
                 refresh_Widget(w);
                 return iTrue;
             }
@@ -2362,7 +2866,7 @@ static iBool processEvent_DocumentWidget_(iDocumentWidget *d, const SDL_Event *e
         }
         case finished_ClickResult:
             if (d->grabbedPlayer) {
-                setGrabbedPlayer_DocumentWidget_(d, NULL);
+                setGrabbedPlayer_DocumentWidget_(d, NULL, 0);
                 return iTrue;
             }
             if (isVisible_Widget(d->menu)) {
@@ -2381,13 +2885,14 @@ static iBool processEvent_DocumentWidget_(iDocumentWidget *d, const SDL_Event *e
                                further to do. */
                             return iTrue;
                         }
-                        if (!requestMedia_DocumentWidget_(d, linkId)) {
+                        if (!requestMedia_DocumentWidget_(d, linkId, iTrue)) {
                             if (linkFlags & content_GmLinkFlag) {
                                 /* Dismiss shown content on click. */
                                 setData_Media(media_GmDocument(d->doc),
                                               linkId,
                                               NULL,
                                               NULL,
+                                              NULL,
                                               allowHide_MediaFlag);
                                 /* Cancel a partially received request. */ {
                                     iMediaRequest *req = findMediaRequest_DocumentWidget_(d, linkId);
@@ -2409,9 +2914,18 @@ static iBool processEvent_DocumentWidget_(iDocumentWidget *d, const SDL_Event *e
                             else {
                                 /* Show the existing content again if we have it. */
                                 iMediaRequest *req = findMediaRequest_DocumentWidget_(d, linkId);
+                                if (req && !req->isSubmitted) {
+                                    /* Still queued; fetch it now. */
+                                    req->isExplicit = iTrue;
+                                    scheduleMediaRequests_DocumentWidget_(d);
+                                    invalidate_DocumentWidget_(d);
+                                    refresh_Widget(w);
+                                    return iTrue;
+                                }
                                 if (req) {
                                     setData_Media(media_GmDocument(d->doc),
                                                   linkId,
+                                                  url_GmRequest(req->req),
                                                   meta_GmRequest(req->req),
                                                   body_GmRequest(req->req),
                                                   allowHide_MediaFlag);
@@ -2448,7 +2962,7 @@ static iBool processEvent_DocumentWidget_(iDocumentWidget *d, const SDL_Event *e
         case double_ClickResult:
         case aborted_ClickResult:
             if (d->grabbedPlayer) {
-                setGrabbedPlayer_DocumentWidget_(d, NULL);
+                setGrabbedPlayer_DocumentWidget_(d, NULL, 0);
                 return iTrue;
             }
             return iTrue;
@@ -2616,12 +3130,16 @@ static void drawRun_DrawContext_(void *context, const iGmRun *run) {
     const iInt2   origin = d->viewPos;
     if (run->imageId) {
         SDL_Texture *tex = imageTexture_Media(media_GmDocument(d->widget->doc), run->imageId);
+        const iRect  dst = moved_Rect(run->visBounds, origin);
+        fillRect_Paint(&d->paint, dst, tmBackground_ColorId); /* in case the image has alpha */
         if (tex) {
-            const iRect dst = moved_Rect(run->visBounds, origin);
-            fillRect_Paint(&d->paint, dst, tmBackground_ColorId); /* in case the image has alpha */
             SDL_RenderCopy(d->paint.dst->render, tex, NULL,
                            &(SDL_Rect){ dst.pos.x, dst.pos.y, dst.size.x, dst.size.y });
         }
+        else {
+            /* Still being decoded. */
+            drawRect_Paint(&d->paint, dst, tmInlineContentMetadata_ColorId);
+        }
         return;
     }
     else if (run->audioId) {
@@ -2636,6 +3154,12 @@ static void drawRun_DrawContext_(void *context, const iGmRun *run) {
     const iInt2 visPos = addX_I2(add_I2(run->visBounds.pos, origin),
                                  /* Preformatted runs can be scrolled. */
                                  runOffset_DocumentWidget_(d->widget, run));
+    if (run->flags & wide_GmRunFlag) {
+        const iWideBlockBuf *buf = findWideBlockBuf_DocumentWidget_(d->widget, run->preId);
+        if (buf && drawRun_WideBlockBuf_(buf, d->paint.dst->render, run, visPos)) {
+            return;
+        }
+    }
     fillRect_Paint(&d->paint, (iRect){ visPos, run->visBounds.size }, tmBackground_ColorId);
     if (run->linkId && ~run->flags & decoration_GmRunFlag) {
         fg = linkColor_GmDocument(doc, run->linkId, isHover ? textHover_GmLinkPart : text_GmLinkPart);
@@ -2719,9 +3243,15 @@ static void drawRun_DrawContext_(void *context, const iGmRun *run) {
                            "%s", cstr_String(&text));
             deinit_String(&text);
         }
-        else if (run->flags & endOfLine_GmRunFlag &&
+        else if (run->flags & endOfLine_GmRunFlag && size_ObjectList(d->widget->media) &&
                  (mr = findMediaRequest_DocumentWidget_(d->widget, run->linkId)) != NULL) {
-            if (!isFinished_GmRequest(mr->req)) {
+            if (!mr->isSubmitted) {
+                draw_Text(metaFont,
+                          topRight_Rect(linkRect),
+                          tmInlineContentMetadata_ColorId,
+                          " \u2014 Queued");
+            }
+            else if (!isFinished_GmRequest(mr->req)) {
                 draw_Text(metaFont,
                           topRight_Rect(linkRect),
                           tmInlineContentMetadata_ColorId,
@@ -2729,55 +3259,13 @@ static void drawRun_DrawContext_(void *context, const iGmRun *run) {
                           (float) bodySize_GmRequest(mr->req) / 1.0e6f);
             }
         }
-        else if (isHover) {
-            const iGmLinkId linkId = d->widget->hoverLink->linkId;
-            const iString * url    = linkUrl_GmDocument(doc, linkId);
-            const int       flags  = linkFlags_GmDocument(doc, linkId);
-            iUrl parts;
-            init_Url(&parts, url);
-            fg                    = linkColor_GmDocument(doc, linkId, textHover_GmLinkPart);
-            const iBool showHost  = (flags & humanReadable_GmLinkFlag &&
-                                    (!isEmpty_Range(&parts.host) || flags & mailto_GmLinkFlag));
-            const iBool showImage = (flags & imageFileExtension_GmLinkFlag) != 0;
-            const iBool showAudio = (flags & audioFileExtension_GmLinkFlag) != 0;
-            iString str;
-            init_String(&str);
-            /* Show scheme and host. */
-            if (run->flags & endOfLine_GmRunFlag &&
-                (flags & (imageFileExtension_GmLinkFlag | audioFileExtension_GmLinkFlag) ||
-                 showHost)) {
-                format_String(&str,
-                              " \u2014%s%s%s\r%c%s",
-                              showHost ? " " : "",
-                              showHost ? (flags & mailto_GmLinkFlag
-                                              ? cstr_String(url)
-                                              : ~flags & gemini_GmLinkFlag
-                                                    ? format_CStr("%s://%s",
-                                                                  cstr_Rangecc(parts.scheme),
-                                                                  cstr_Rangecc(parts.host))
-                                                    : cstr_Rangecc(parts.host))
-                                       : "",
-                              showHost && (showImage || showAudio) ? " \u2014" : "",
-                              showImage || showAudio
-                                  ? asciiBase_ColorEscape + fg
-                                  : (asciiBase_ColorEscape +
-                                     linkColor_GmDocument(doc, run->linkId, domain_GmLinkPart)),
-                              showImage ? " View Image \U0001f5bc"
-                                        : showAudio ? " Play Audio \U0001f3b5" : "");
-            }
-            if (run->flags & endOfLine_GmRunFlag && flags & visited_GmLinkFlag) {
-                iDate date;
-                init_Date(&date, linkTime_GmDocument(doc, run->linkId));
-                appendFormat_String(&str,
-                                    " \u2014 %s%s",
-                                    escape_Color(linkColor_GmDocument(doc, run->linkId,
-                                                                      visited_GmLinkPart)),
-                                    cstr_String(collect_String(format_Date(&date, "%b %d"))));
-            }
-            if (!isEmpty_String(&str)) {
-                const iInt2 textSize = measure_Text(metaFont, cstr_String(&str));
+        else if (isHover && run->flags & endOfLine_GmRunFlag) {
+            /* Composed after layout by GmDocument. */
+            const iString *str = linkHoverText_GmDocument(doc, run->linkId);
+            if (!isEmpty_String(str)) {
+                const iInt2 textSize = linkHoverTextSize_GmDocument(doc, run->linkId);
                 int tx = topRight_Rect(linkRect).x;
-                const char *msg = cstr_String(&str);
+                const char *msg = cstr_String(str);
                 if (tx + textSize.x > right_Rect(d->widgetBounds)) {
                     tx = right_Rect(d->widgetBounds) - textSize.x;
                     fillRect_Paint(&d->paint, (iRect){ init_I2(tx, top_Rect(linkRect)), textSize },
@@ -2791,7 +3279,6 @@ static void drawRun_DrawContext_(void *context, const iGmRun *run) {
                                left_Alignment,
                                "%s",
                                msg);
-                deinit_String(&str);
             }
         }
     }
@@ -2820,6 +3307,7 @@ static iBool isSideHeadingVisible_DocumentWidget_(const iDocumentWidget *d) {
 }
 
 static void updateSideIconBuf_DocumentWidget_(iDocumentWidget *d) {
+    d->flags &= ~pendingSideIcon_DocumentWidgetFlag;
     if (d->sideIconBuf) {
         SDL_DestroyTexture(d->sideIconBuf);
         d->sideIconBuf = NULL;
@@ -2982,6 +3470,7 @@ static void draw_DocumentWidget_(const iDocumentWidget *d) {
     const iWidget *w        = constAs_Widget(d);
     const iRect    bounds   = bounds_Widget(w);
     iVisBuf *      visBuf   = d->visBuf; /* will be updated now */
+    const uint64_t profileTime = begin_Profiler();
     draw_Widget(w);
     allocVisBuffer_DocumentWidget_(d);
     const iRect ctxWidgetBounds = init_Rect(
@@ -2995,21 +3484,27 @@ static void draw_DocumentWidget_(const iDocumentWidget *d) {
     const iRangei vis  = visibleRange_DocumentWidget_(d);
     const iRangei full = { 0, size_GmDocument(d->doc).y };
     reposition_VisBuf(visBuf, vis);
-    iRangei invalidRange[3];
+    iRangei invalidRange[maxBuffers_VisBuf];
     invalidRanges_VisBuf(visBuf, full, invalidRange);
+    iBool isTileRendered = iFalse;
+    updateWideBlockBufs_DocumentWidget_(iConstCast(iDocumentWidget *, d));
     /* Redraw the invalid ranges. */ {
         iPaint *p = &ctx.paint;
         init_Paint(p);
-        iForIndices(i, visBuf->buffers) {
+        for (size_t i = 0; i < visBuf->numBuffers; i++) {
             iVisBufTexture *buf = &visBuf->buffers[i];
             ctx.widgetBounds = moved_Rect(ctxWidgetBounds, init_I2(0, -buf->origin));
             ctx.viewPos      = init_I2(left_Rect(docBounds) - left_Rect(bounds), -buf->origin);
+            if (isEmpty_Rangei(buf->validRange) &&
+                isOverlapping_Rangei(vis, (iRangei){ buf->origin, buf->origin + visBuf->texSize.y })) {
+                /* Also clears tiles that have no content, like the ones past the end. */
+                beginTarget_Paint(p, buf->texture);
+                fillRect_Paint(p, (iRect){ zero_I2(), visBuf->texSize }, tmBackground_ColorId);
+            }
             if (!isEmpty_Rangei(invalidRange[i])) {
                 beginTarget_Paint(p, buf->texture);
-                if (isEmpty_Rangei(buf->validRange)) {
-                    fillRect_Paint(p, (iRect){ zero_I2(), visBuf->texSize }, tmBackground_ColorId);
-                }
                 render_GmDocument(d->doc, invalidRange[i], drawRun_DrawContext_, &ctx);
+                isTileRendered = iTrue;
             }
             /* Draw any invalidated runs that fall within this buffer. */ {
                 const iRangei bufRange = { buf->origin, buf->origin + visBuf->texSize.y };
@@ -3037,8 +3532,27 @@ static void draw_DocumentWidget_(const iDocumentWidget *d) {
             }
             endTarget_Paint(&ctx.paint);
         }
-        validate_VisBuf(visBuf);
+        validate_VisBuf(visBuf, full);
         clear_PtrSet(d->invalidRuns);
+        /* When the visible tiles are up to date, use the frame to render one of the upcoming
+           tiles so scrolling onto it doesn't need to. */
+        iRangei         prerenderRange;
+        iVisBufTexture *buf = !isTileRendered && !isFrameLate_App()
+                                  ? prerender_VisBuf(visBuf,
+                                                     aheadRange_DocumentWidget_(d),
+                                                     full,
+                                                     &prerenderRange)
+                                  : NULL;
+        if (buf) {
+            ctx.widgetBounds = moved_Rect(ctxWidgetBounds, init_I2(0, -buf->origin));
+            ctx.viewPos      = init_I2(left_Rect(docBounds) - left_Rect(bounds), -buf->origin);
+            beginTarget_Paint(p, buf->texture);
+            fillRect_Paint(p, (iRect){ zero_I2(), visBuf->texSize }, tmBackground_ColorId);
+            render_GmDocument(d->doc, prerenderRange, drawRun_DrawContext_, &ctx);
+            endTarget_Paint(p);
+            /* Keep going on the following frames. */
+            addTicker_App(refreshWhileScrolling_DocumentWidget_, iConstCast(iDocumentWidget *, d));
+        }
     }
     setClip_Paint(&ctx.paint, bounds);
     const int yTop = docBounds.pos.y - value_Anim(&d->scrollY);
@@ -3082,11 +3596,13 @@ static void draw_DocumentWidget_(const iDocumentWidget *d) {
     }
     drawSideElements_DocumentWidget_(d);
     draw_Widget(w);
+    end_Profiler(drawDocument_ProfileZone, profileTime);
 }
 
 /*----------------------------------------------------------------------------------------------*/
 
 iHistory *history_DocumentWidget(iDocumentWidget *d) {
+    materializeState_DocumentWidget_(d);
     return d->mod.history;
 }
 
@@ -3127,6 +3643,13 @@ const iString *bookmarkTitle_DocumentWidget(const iDocumentWidget *d) {
 }
 
 void serializeState_DocumentWidget(const iDocumentWidget *d, iStream *outs) {
+    if (d->pendingState) {
+        /* Never been shown, so the state is unchanged. */
+        writeData_Stream(outs,
+                         constData_Block(d->pendingState) + d->pendingStatePos,
+                         d->pendingStateSize);
+        return;
+    }
     serialize_PersistentDocumentState(&d->mod, outs);
 }
 
@@ -3136,7 +3659,37 @@ void deserializeState_DocumentWidget(iDocumentWidget *d, iStream *ins) {
     updateFromHistory_DocumentWidget_(d);
 }
 
+const iString *savedTitle_DocumentWidget(const iDocumentWidget *d, iChar *siteIcon_out) {
+    if (d->pendingState) {
+        *siteIcon_out = d->pendingSiteIcon;
+        return &d->pendingTitle;
+    }
+    *siteIcon_out = siteIcon_GmDocument(d->doc);
+    return title_GmDocument(d->doc);
+}
+
+void deserializeStateLater_DocumentWidget(iDocumentWidget *d, const iBlock *state, size_t pos,
+                                          size_t size, const iString *title, iChar siteIcon) {
+    if (d->pendingState) {
+        delete_Block(d->pendingState);
+    }
+    d->pendingState     = copy_Block(state); /* shared, not copied */
+    d->pendingStatePos  = pos;
+    d->pendingStateSize = size;
+    set_String(&d->pendingTitle, title);
+    d->pendingSiteIcon  = siteIcon;
+    /* Only the URL is needed before the tab is shown (e.g., for the tab title). */ {
+        iBuffer *buf = new_Buffer();
+        open_Buffer(buf, state);
+        seek_Stream(stream_Buffer(buf), pos);
+        deserialize_String(d->mod.url, stream_Buffer(buf));
+        iRelease(buf);
+    }
+    parseUser_DocumentWidget_(d);
+}
+
 void setUrlFromCache_DocumentWidget(iDocumentWidget *d, const iString *url, iBool isFromCache) {
+    materializeState_DocumentWidget_(d);
     d->flags &= ~showLinkNumbers_DocumentWidgetFlag;
     if (cmpStringSc_String(d->mod.url, url, &iCaseInsensitive)) {
         set_String(d->mod.url, url);
@@ -3152,6 +3705,7 @@ void setUrlFromCache_DocumentWidget(iDocumentWidget *d, const iString *url, iBoo
 }
 
 iDocumentWidget *duplicate_DocumentWidget(const iDocumentWidget *orig) {
+    materializeState_DocumentWidget_(iConstCast(iDocumentWidget *, orig));
     iDocumentWidget *d = new_DocumentWidget();
     delete_History(d->mod.history);
     d->initNormScrollY = normScrollPos_DocumentWidget_(d);
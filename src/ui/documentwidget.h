@@ -33,6 +33,9 @@ iDeclareObjectConstruction(DocumentWidget)
 
 void    serializeState_DocumentWidget   (const iDocumentWidget *, iStream *outs);
 void    deserializeState_DocumentWidget (iDocumentWidget *, iStream *ins);
+void    deserializeStateLater_DocumentWidget(iDocumentWidget *, const iBlock *state, size_t pos, size_t size,
+                                             const iString *title, iChar siteIcon);
+const iString *savedTitle_DocumentWidget    (const iDocumentWidget *, iChar *siteIcon_out);
 
 iDocumentWidget *   duplicate_DocumentWidget        (const iDocumentWidget *);
 iHistory *          history_DocumentWidget          (iDocumentWidget *);
@@ -32,8 +32,9 @@ static int timerId_;   /* common timer for all indicators */
 static int animCount_; /* number of animating indicators */
 
 static uint32_t postRefresh_(uint32_t interval, void *context) {
+    /* Animating indicators refresh themselves when the frame is processed. */
     iUnused(context);
-    postRefresh_App();
+    postRefreshRect_App(zero_Rect());
     return interval;
 }
 
@@ -114,8 +115,11 @@ void draw_IndicatorWidget_(const iIndicatorWidget *d) {
 iBool processEvent_IndicatorWidget_(iIndicatorWidget *d, const SDL_Event *ev) {
     iWidget *w = &d->widget;
     if (ev->type == SDL_USEREVENT && ev->user.code == refresh_UserEventCode) {
-        if (isFinished_Anim(&d->pos)) {
-            stopTimer_IndicatorWidget_(d);
+        if (isActive_IndicatorWidget_(d)) {
+            refresh_Widget(w);
+            if (isFinished_Anim(&d->pos)) {
+                stopTimer_IndicatorWidget_(d);
+            }
         }
     }
     else if (isCommand_SDLEvent(ev)) {
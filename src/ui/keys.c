@@ -78,6 +78,9 @@ static const struct { int id; iMenuItem bind; int flags; } defaultBindings_[] =
     { 41, { "Open link via modifier key", SDLK_LALT, 0,                 "document.linkkeys arg:0" }, argRelease_BindFlag },
     { 80, { "Previous tab",              prevTab_KeyShortcut,           "tabs.prev"          }, 0 },
     { 81, { "Next tab",                  nextTab_KeyShortcut,           "tabs.next"          }, 0 },
+    { 90, { "Toggle profiler overlay",   SDLK_p, KMOD_SHIFT | KMOD_PRIMARY, "profiler.toggle" }, 0 },
+    { 91, { "Export profiler trace",     SDLK_e, KMOD_SHIFT | KMOD_PRIMARY, "profiler.export" }, 0 },
+    { 92, { "Flash redrawn regions",     SDLK_f, KMOD_SHIFT | KMOD_PRIMARY, "window.flashdamage" }, 0 },
     /* The following cannot currently be changed (built-in duplicates). */
     { 1000, { NULL, SDLK_SPACE, KMOD_SHIFT, "scroll.page arg:-1" }, argRepeat_BindFlag },
     { 1001, { NULL, SDLK_SPACE, 0, "scroll.page arg:1" }, argRepeat_BindFlag },
@@ -275,6 +275,7 @@ void updateSize_LabelWidget(iLabelWidget *d) {
     if (~flags & fixedHeight_WidgetFlag) {
         w->rect.size.y = size.y;
     }
+    invalidateArrange_Widget(w);
 }
 
 void init_LabelWidget(iLabelWidget *d, const char *label, const char *cmd) {
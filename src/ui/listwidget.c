@@ -50,7 +50,10 @@ struct Impl_ListWidget {
     iScrollWidget *scroll;
     int scrollY;
     int itemHeight;
-    iPtrArray items;
+    iPtrArray items; /* all items, or the realized window of a source's items */
+    size_t firstItem; /* index of the first element of `items` */
+    const iListSource *source;
+    iAny *sourceContext;
     size_t hoverItem;
     iClick click;
     iIntSet invalidItems;
@@ -67,6 +70,9 @@ void init_ListWidget(iListWidget *d) {
     setThumb_ScrollWidget(d->scroll, 0, 0);
     d->scrollY = 0;
     init_PtrArray(&d->items);
+    d->firstItem = 0;
+    d->source = NULL;
+    d->sourceContext = NULL;
     d->hoverItem = iInvalidPos;
     init_Click(&d->click, d, SDL_BUTTON_LEFT);
     init_IntSet(&d->invalidItems);
@@ -90,34 +96,51 @@ void invalidateItem_ListWidget(iListWidget *d, size_t index) {
     refresh_Widget(d);
 }
 
-void clear_ListWidget(iListWidget *d) {
+static void releaseItems_ListWidget_(iListWidget *d) {
     iForEach(PtrArray, i, &d->items) {
         deref_Object(i.ptr);
     }
     clear_PtrArray(&d->items);
+    d->firstItem = 0;
+}
+
+void clear_ListWidget(iListWidget *d) {
+    releaseItems_ListWidget_(d);
+    d->source = NULL;
+    d->sourceContext = NULL;
     d->hoverItem = iInvalidPos;
 }
 
 void addItem_ListWidget(iListWidget *d, iAnyObject *item) {
+    iAssert(!d->source);
     pushBack_PtrArray(&d->items, ref_Object(item));
 }
 
+void setSource_ListWidget(iListWidget *d, const iListSource *source, iAny *context) {
+    clear_ListWidget(d);
+    d->source = source;
+    d->sourceContext = context;
+}
+
 iScrollWidget *scroll_ListWidget(iListWidget *d) {
     return d->scroll;
 }
 
 size_t numItems_ListWidget(const iListWidget *d) {
+    if (d->source) {
+        return d->source->numItems(d->sourceContext);
+    }
     return size_PtrArray(&d->items);
 }
 
 static int scrollMax_ListWidget_(const iListWidget *d) {
     return iMax(0,
-                (int) size_PtrArray(&d->items) * d->itemHeight -
+                (int) numItems_ListWidget(d) * d->itemHeight -
                     height_Rect(innerBounds_Widget(constAs_Widget(d))));
 }
 
 void updateVisible_ListWidget(iListWidget *d) {
-    const int   contentSize = size_PtrArray(&d->items) * d->itemHeight;
+    const int   contentSize = numItems_ListWidget(d) * d->itemHeight;
     const iRect bounds      = innerBounds_Widget(as_Widget(d));
     const iBool wasVisible  = isVisible_Widget(d->scroll);
     if (area_Rect(bounds) == 0) {
@@ -189,7 +212,7 @@ void scrollToItem_ListWidget(iListWidget *d, size_t index) {
 
 int visCount_ListWidget(const iListWidget *d) {
     return iMin(height_Rect(innerBounds_Widget(constAs_Widget(d))) / d->itemHeight,
-                (int) size_PtrArray(&d->items));
+                (int) numItems_ListWidget(d));
 }
 
 static iRanges visRange_ListWidget_(const iListWidget *d) {
@@ -197,24 +220,64 @@ static iRanges visRange_ListWidget_(const iListWidget *d) {
         return (iRanges){ 0, 0 };
     }
     iRanges vis = { d->scrollY / d->itemHeight, 0 };
-    vis.end = iMin(size_PtrArray(&d->items), vis.start + visCount_ListWidget(d) + 1);
+    vis.end = iMin(numItems_ListWidget(d), vis.start + visCount_ListWidget(d) + 1);
     return vis;
 }
 
+static void realizeItems_ListWidget_(iListWidget *d, size_t index) {
+    /* Keep the items of the visible range, plus a page in both directions, so that scrolling
+       by small amounts does not have to ask the source for new items every time. */
+    const size_t num  = numItems_ListWidget(d);
+    const size_t page = visCount_ListWidget(d) + 1;
+    iRanges      vis  = visRange_ListWidget_(d);
+    vis.start = iMin(vis.start, index);
+    vis.end   = iMax(vis.end, index + 1);
+    const iRanges window = { vis.start > page ? vis.start - page : 0, iMin(num, vis.end + page) };
+    const iRanges old    = { d->firstItem, d->firstItem + size_PtrArray(&d->items) };
+    iPtrArray     items;
+    init_PtrArray(&items);
+    for (size_t i = window.start; i < window.end; i++) {
+        if (contains_Range(&old, i)) {
+            /* Already realized; the reference moves over to the new window. */
+            void **item = at_Array(&d->items, i - old.start);
+            pushBack_PtrArray(&items, *item);
+            *item = NULL;
+        }
+        else {
+            pushBack_PtrArray(&items, d->source->newItem(d->sourceContext, i));
+        }
+    }
+    iForEach(PtrArray, i, &d->items) {
+        if (i.ptr) {
+            deref_Object(i.ptr);
+        }
+    }
+    deinit_PtrArray(&d->items);
+    d->items     = items;
+    d->firstItem = window.start;
+}
+
+static iListItem *realizedItem_ListWidget_(const iListWidget *d, size_t index) {
+    if (index >= numItems_ListWidget(d)) {
+        return NULL;
+    }
+    if (d->source && (index < d->firstItem || index >= d->firstItem + size_PtrArray(&d->items))) {
+        realizeItems_ListWidget_(iConstCast(iListWidget *, d), index);
+    }
+    return iConstCast(iListItem *, constAt_PtrArray(&d->items, index - d->firstItem));
+}
+
 size_t itemIndex_ListWidget(const iListWidget *d, iInt2 pos) {
     const iRect bounds = innerBounds_Widget(constAs_Widget(d));
     pos.y -= top_Rect(bounds) - d->scrollY;
     if (pos.y < 0 || !d->itemHeight) return iInvalidPos;
     size_t index = pos.y / d->itemHeight;
-    if (index >= size_Array(&d->items)) return iInvalidPos;
+    if (index >= numItems_ListWidget(d)) return iInvalidPos;
     return index;
 }
 
 const iAnyObject *constItem_ListWidget(const iListWidget *d, size_t index) {
-    if (index < size_PtrArray(&d->items)) {
-        return constAt_PtrArray(&d->items, index);
-    }
-    return NULL;
+    return realizedItem_ListWidget_(d, index);
 }
 
 const iAnyObject *constHoverItem_ListWidget(const iListWidget *d) {
@@ -222,10 +285,7 @@ const iAnyObject *constHoverItem_ListWidget(const iListWidget *d) {
 }
 
 iAnyObject *item_ListWidget(iListWidget *d, size_t index) {
-    if (index < size_PtrArray(&d->items)) {
-        return at_PtrArray(&d->items, index);
-    }
-    return NULL;
+    return realizedItem_ListWidget_(d, index);
 }
 
 iAnyObject *hoverItem_ListWidget(iListWidget *d) {
@@ -237,8 +297,8 @@ size_t hoverItemIndex_ListWidget(const iListWidget *d) {
 }
 
 static void setHoverItem_ListWidget_(iListWidget *d, size_t index) {
-    if (index < size_PtrArray(&d->items)) {
-        const iListItem *item = at_PtrArray(&d->items, index);
+    const iListItem *item = realizedItem_ListWidget_(d, index);
+    if (item) {
         if (item->isSeparator) {
             index = iInvalidPos;
         }
@@ -257,6 +317,7 @@ void updateMouseHover_ListWidget(iListWidget *d) {
 }
 
 void sort_ListWidget(iListWidget *d, int (*cmp)(const iListItem **item1, const iListItem **item2)) {
+    iAssert(!d->source); /* the source decides the order */
     sort_Array(&d->items, (iSortedArrayCompareElemFunc) cmp);
 }
 
@@ -322,18 +383,24 @@ static iBool processEvent_ListWidget_(iListWidget *d, const SDL_Event *ev) {
     return processEvent_Widget(w, ev);
 }
 
-#if 0
-static void drawItem_ListWidget_(const iListWidget *d, iPaint *p, size_t index, iInt2 pos) {
-    const iWidget *  w         = constAs_Widget(d);
-    const iRect      bounds    = innerBounds_Widget(w);
-    const iListItem *item      = constAt_PtrArray(&d->items, index);
-    const iRect      itemRect  = { pos, init_I2(width_Rect(bounds), d->itemHeight) };
+static void drawItem_ListWidget_(const iListWidget *d, iPaint *p, size_t index,
+                                 const iVisBufTexture *buf, int bg) {
+    const iListItem *item = realizedItem_ListWidget_(d, index);
+    if (!item) {
+        return;
+    }
+    const iRect itemRect    = { init_I2(0, index * d->itemHeight - buf->origin),
+                                init_I2(d->visBuf->texSize.x, d->itemHeight) };
+    const iRect sbBlankRect = { init_I2(d->visBuf->texSize.x - scrollBarWidth_ListWidget(d),
+                                        top_Rect(itemRect)),
+                                init_I2(scrollBarWidth_ListWidget(d), d->itemHeight) };
+    /* The item may look up other items while drawing, which could move the realized window
+       of a source-backed list. */
+    ref_Object(item);
+    fillRect_Paint(p, itemRect, bg);
     class_ListItem(item)->draw(item, p, itemRect, d);
-}
-#endif
-
-static const iListItem *item_ListWidget_(const iListWidget *d, size_t pos) {
-    return constAt_PtrArray(&d->items, pos);
+    fillRect_Paint(p, sbBlankRect, bg);
+    deref_Object(item);
 }
 
 static void draw_ListWidget_(const iListWidget *d) {
@@ -351,38 +418,28 @@ static void draw_ListWidget_(const iListWidget *d) {
            one should be enough. Probably an off-by-one error in the calculation of the
            invalid range. */
         iAssert(d->visBuf->buffers[0].texture);
-        iAssert(d->visBuf->buffers[1].texture);
-        iAssert(d->visBuf->buffers[2].texture);
-        const int bg[3] = { w->bgColor, w->bgColor, w->bgColor };
-//        const int bg[3] = { red_ColorId, magenta_ColorId, blue_ColorId };
-        const int bottom = numItems_ListWidget(d) * d->itemHeight;
+        const int bg = w->bgColor;
+        const size_t numItems = numItems_ListWidget(d);
+        const int bottom = numItems * d->itemHeight;
         const iRangei vis = { d->scrollY / d->itemHeight * d->itemHeight,
                              ((d->scrollY + bounds.size.y) / d->itemHeight + 1) * d->itemHeight };
         reposition_VisBuf(d->visBuf, vis);
         /* Check which parts are invalid. */
-        iRangei invalidRange[3];
+        iRangei invalidRange[maxBuffers_VisBuf];
         invalidRanges_VisBuf(d->visBuf, (iRangei){ 0, bottom }, invalidRange);
-        iForIndices(i, d->visBuf->buffers) {
+        for (size_t i = 0; i < d->visBuf->numBuffers; i++) {
             iVisBufTexture *buf = &d->visBuf->buffers[i];
             iRanges drawItems = { iMax(0, buf->origin) / d->itemHeight,
                                   iMax(0, buf->origin + d->visBuf->texSize.y) / d->itemHeight };
             if (isEmpty_Rangei(buf->validRange)) {
                 beginTarget_Paint(&p, buf->texture);
-                fillRect_Paint(&p, (iRect){ zero_I2(), d->visBuf->texSize }, bg[i]);
+                fillRect_Paint(&p, (iRect){ zero_I2(), d->visBuf->texSize }, bg);
             }
-            const iRect sbBlankRect =
-                { init_I2(d->visBuf->texSize.x - scrollBarWidth_ListWidget(d), 0),
-                         init_I2(scrollBarWidth_ListWidget(d), d->itemHeight) };
             iConstForEach(IntSet, v, &d->invalidItems) {
                 const size_t index = *v.value;
                 if (contains_Range(&drawItems, index)) {
-                    const iListItem *item = constAt_PtrArray(&d->items, index);
-                    const iRect      itemRect = { init_I2(0, index * d->itemHeight - buf->origin),
-                                                  init_I2(d->visBuf->texSize.x, d->itemHeight) };
                     beginTarget_Paint(&p, buf->texture);
-                    fillRect_Paint(&p, itemRect, bg[i]);
-                    class_ListItem(item)->draw(item, &p, itemRect, d);
-                    fillRect_Paint(&p, moved_Rect(sbBlankRect, init_I2(0, top_Rect(itemRect))), bg[i]);
+                    drawItem_ListWidget_(d, &p, index, buf, bg);
                 }
             }
             /* Visible range is not fully covered. Fill in the new items. */
@@ -390,18 +447,13 @@ static void draw_ListWidget_(const iListWidget *d) {
                 beginTarget_Paint(&p, buf->texture);
                 drawItems.start = invalidRange[i].start / d->itemHeight;
                 drawItems.end   = invalidRange[i].end   / d->itemHeight + 1;
-                for (size_t j = drawItems.start; j < drawItems.end && j < size_PtrArray(&d->items); j++) {
-                    const iListItem *item     = constAt_PtrArray(&d->items, j);
-                    const iRect      itemRect = { init_I2(0, j * d->itemHeight - buf->origin),
-                                                  init_I2(d->visBuf->texSize.x, d->itemHeight) };
-                    fillRect_Paint(&p, itemRect, bg[i]);
-                    class_ListItem(item)->draw(item, &p, itemRect, d);
-                    fillRect_Paint(&p, moved_Rect(sbBlankRect, init_I2(0, top_Rect(itemRect))), bg[i]);
+                for (size_t j = drawItems.start; j < drawItems.end && j < numItems; j++) {
+                    drawItem_ListWidget_(d, &p, j, buf, bg);
                 }
             }
             endTarget_Paint(&p);
         }
-        validate_VisBuf(d->visBuf);
+        validate_VisBuf(d->visBuf, (iRangei){ 0, bottom });
         clear_IntSet(&iConstCast(iListWidget *, d)->invalidItems);
     }
     setClip_Paint(&p, bounds_Widget(w));
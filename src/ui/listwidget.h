@@ -43,6 +43,16 @@ struct Impl_ListItem {
 
 iDeclareObjectConstruction(ListItem)
 
+/* A list can also be backed by a data source instead of items added up front. Items are
+   then requested from the source only when they need to be drawn or accessed, and only the
+   items near the visible range are kept in memory. */
+iDeclareType(ListSource)
+
+struct Impl_ListSource {
+    size_t       (*numItems)(const iAny *context);
+    iAnyObject * (*newItem) (iAny *context, size_t index); /* returns a new reference */
+};
+
 iDeclareWidgetClass(ListWidget)
 iDeclareObjectConstruction(ListWidget)
 
@@ -52,6 +62,7 @@ void    invalidate_ListWidget       (iListWidget *);
 void    invalidateItem_ListWidget   (iListWidget *, size_t index);
 void    clear_ListWidget            (iListWidget *);
 void    addItem_ListWidget          (iListWidget *, iAnyObject *item);
+void    setSource_ListWidget        (iListWidget *, const iListSource *source, iAny *context);
 
 iScrollWidget * scroll_ListWidget   (iListWidget *);
 
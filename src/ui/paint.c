@@ -21,6 +21,7 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "paint.h"
+#include "util.h"
 
 #include <SDL_version.h>
 
@@ -34,6 +35,12 @@ static void setColor_Paint_(const iPaint *d, int color) {
     SDL_SetRenderDrawColor(renderer_Paint_(d), clr.r, clr.g, clr.b, clr.a * d->alpha / 255);
 }
 
+static iBool isDrawingWindow_Paint_(const iPaint *d) {
+    /* The window's clip only applies when drawing the window contents. */
+    const SDL_Texture *target = SDL_GetRenderTarget(renderer_Paint_(d));
+    return target == NULL || target == d->dst->composite;
+}
+
 void init_Paint(iPaint *d) {
     d->dst       = get_Window();
     d->setTarget = NULL;
@@ -45,6 +52,8 @@ void beginTarget_Paint(iPaint *d, SDL_Texture *target) {
     SDL_Renderer *rend = renderer_Paint_(d);
     if (!d->setTarget) {
         d->oldTarget = SDL_GetRenderTarget(rend);
+        d->oldClipEnabled = SDL_RenderIsClipEnabled(rend);
+        SDL_RenderGetClipRect(rend, &d->oldClip);
         SDL_SetRenderTarget(rend, target);
         d->setTarget = target;
     }
@@ -55,7 +64,10 @@ void beginTarget_Paint(iPaint *d, SDL_Texture *target) {
 
 void endTarget_Paint(iPaint *d) {
     if (d->setTarget) {
-        SDL_SetRenderTarget(renderer_Paint_(d), d->oldTarget);
+        SDL_Renderer *rend = renderer_Paint_(d);
+        SDL_SetRenderTarget(rend, d->oldTarget);
+        /* Switching between texture targets resets the clip. */
+        SDL_RenderSetClipRect(rend, d->oldClipEnabled ? &d->oldClip : NULL);
         d->oldTarget = NULL;
         d->setTarget = NULL;
     }
@@ -67,10 +79,18 @@ void setClip_Paint(iPaint *d, iRect rect) {
         rect.pos.y -= off;
         rect.size.y = iMax(0, rect.size.y + off);
     }
+    if (!isEmpty_Rect(d->dst->drawClip) && isDrawingWindow_Paint_(d)) {
+        /* Only a damaged region of the window is being redrawn. */
+        rect = clipped_Rect(rect, d->dst->drawClip);
+    }
     SDL_RenderSetClipRect(renderer_Paint_(d), (const SDL_Rect *) &rect);
 }
 
 void unsetClip_Paint(iPaint *d) {
+    if (!isEmpty_Rect(d->dst->drawClip) && isDrawingWindow_Paint_(d)) {
+        SDL_RenderSetClipRect(renderer_Paint_(d), (const SDL_Rect *) &d->dst->drawClip);
+        return;
+    }
 #if SDL_VERSION_ATLEAST(2, 0, 12)
     SDL_RenderSetClipRect(renderer_Paint_(d), NULL);
 #else
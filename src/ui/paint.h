@@ -33,6 +33,8 @@ struct Impl_Paint {
     iWindow *    dst;
     SDL_Texture *setTarget;
     SDL_Texture *oldTarget;
+    SDL_Rect     oldClip;
+    SDL_bool     oldClipEnabled;
     uint8_t      alpha;
 };
 
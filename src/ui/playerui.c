@@ -38,6 +38,37 @@ static const char *volumeChar_(float volume) {
     return "\U0001f50a";
 }
 
+static void sevenSegmentTime_(iString *num, int seconds) {
+    const uint32_t sevenSegmentDigit = 0x1fbf0;
+    const int hours = seconds / 3600;
+    const int mins  = (seconds / 60) % 60;
+    const int secs  = seconds % 60;
+    if (hours) {
+        appendChar_String(num, sevenSegmentDigit + (hours % 10));
+        appendChar_String(num, ':');
+    }
+    appendChar_String(num, sevenSegmentDigit + (mins / 10) % 10);
+    appendChar_String(num, sevenSegmentDigit + (mins % 10));
+    appendChar_String(num, ':');
+    appendChar_String(num, sevenSegmentDigit + (secs / 10) % 10);
+    appendChar_String(num, sevenSegmentDigit + (secs % 10));
+}
+
+static int sevenSegmentTimeWidth_(int seconds) {
+    iString num;
+    init_String(&num);
+    sevenSegmentTime_(&num, seconds);
+    const int width = advanceRange_Text(uiLabel_FontId, range_String(&num)).x;
+    deinit_String(&num);
+    return width;
+}
+
+static float scrubberTime_(const iPlayer *player) {
+    /* While the duration is unknown, the scrubber covers the downloaded part of the stream. */
+    const float totalTime = duration_Player(player);
+    return totalTime > 0 ? totalTime : seekableTime_Player(player);
+}
+
 void init_PlayerUI(iPlayerUI *d, const iPlayer *player, iRect bounds) {
     d->player = player;
     d->bounds = bounds;
@@ -49,6 +80,13 @@ void init_PlayerUI(iPlayerUI *d, const iPlayer *player, iRect bounds) {
     d->volumeAdjustRect = d->volumeRect;
     adjustEdges_Rect(&d->volumeAdjustRect, 0, 0, 0, -35 * gap_UI);
     d->scrubberRect  = initCorners_Rect(topRight_Rect(d->rewindRect), bottomLeft_Rect(d->volumeRect));
+    /* The progress bar is between the time labels. */ {
+        const float totalTime = duration_Player(player);
+        d->scrubberSpan.start = left_Rect(d->scrubberRect) +
+                                sevenSegmentTimeWidth_(iRound(time_Player(player))) + 6 * gap_UI;
+        d->scrubberSpan.end = right_Rect(d->scrubberRect) - 6 * gap_UI -
+                              (totalTime > 0 ? sevenSegmentTimeWidth_(iRound(totalTime)) : 0);
+    }
     /* Volume slider. */ {
         d->volumeSlider = shrunk_Rect(d->volumeAdjustRect, init_I2(gap_UI / 2, gap_UI));
         adjustEdges_Rect(&d->volumeSlider, 0, -width_Rect(d->volumeRect) - 2 * gap_UI, 0, 5 * gap_UI);
@@ -73,22 +111,10 @@ static void drawPlayerButton_(iPaint *p, iRect rect, const char *label, int font
 }
 
 static int drawSevenSegmentTime_(iInt2 pos, int color, int align, int seconds) { /* returns width */
-    const uint32_t sevenSegmentDigit = 0x1fbf0;
-    const int hours = seconds / 3600;
-    const int mins  = (seconds / 60) % 60;
-    const int secs  = seconds % 60;
-    const int font  = uiLabel_FontId;
+    const int font = uiLabel_FontId;
     iString   num;
     init_String(&num);
-    if (hours) {
-        appendChar_String(&num, sevenSegmentDigit + (hours % 10));
-        appendChar_String(&num, ':');
-    }
-    appendChar_String(&num, sevenSegmentDigit + (mins / 10) % 10);
-    appendChar_String(&num, sevenSegmentDigit + (mins % 10));
-    appendChar_String(&num, ':');
-    appendChar_String(&num, sevenSegmentDigit + (secs / 10) % 10);
-    appendChar_String(&num, sevenSegmentDigit + (secs % 10));
+    sevenSegmentTime_(&num, seconds);
     iInt2 size = advanceRange_Text(font, range_String(&num));
     if (align == right_Alignment) {
         pos.x -= size.x;
@@ -118,27 +144,28 @@ void draw_PlayerUI(iPlayerUI *d, iPaint *p) {
     const int   yMid      = mid_Rect(d->scrubberRect).y;
     const float playTime  = time_Player(d->player);
     const float totalTime = duration_Player(d->player);
+    const float scaleTime = scrubberTime_(d->player);
     const int   bright    = uiHeading_ColorId;
     const int   dim       = uiAnnotation_ColorId;
-    int leftWidth = drawSevenSegmentTime_(
+    drawSevenSegmentTime_(
         init_I2(left_Rect(d->scrubberRect) + 2 * gap_UI, yMid - hgt / 2),
         isPaused_Player(d->player) ? dim : bright,
         left_Alignment,
         iRound(playTime));
-    int rightWidth = 0;
     if (totalTime > 0) {
-        rightWidth =
-            drawSevenSegmentTime_(init_I2(right_Rect(d->scrubberRect) - 2 * gap_UI, yMid - hgt / 2),
-                                  dim,
-                                  right_Alignment,
-                                  iRound(totalTime));
+        drawSevenSegmentTime_(init_I2(right_Rect(d->scrubberRect) - 2 * gap_UI, yMid - hgt / 2),
+                              dim,
+                              right_Alignment,
+                              iRound(totalTime));
     }
     /* Scrubber. */
-    const int   s1      = left_Rect(d->scrubberRect) + leftWidth + 6 * gap_UI;
-    const int   s2      = right_Rect(d->scrubberRect) - rightWidth - 6 * gap_UI;
-    const float normPos = totalTime > 0 ? playTime / totalTime : 0.0f;
+    const int   s1      = d->scrubberSpan.start;
+    const int   s2      = d->scrubberSpan.end;
+    const float normPos = scaleTime > 0 ? iMin(1.0f, playTime / scaleTime) : 0.0f;
     const int   part    = (s2 - s1) * normPos;
-    const int   scrubMax = (s2 - s1) * streamProgress_Player(d->player);
+    const int   scrubMax = (s2 - s1) * (scaleTime > 0 ? iMin(1.0f, seekableTime_Player(d->player) /
+                                                                     scaleTime)
+                                                      : streamProgress_Player(d->player));
     drawHLine_Paint(p, init_I2(s1, yMid), part, bright);
     drawHLine_Paint(p, init_I2(s1 + part, yMid), scrubMax - part, dim);
     const char *dot = "\u23fa";
@@ -182,3 +209,14 @@ void draw_PlayerUI(iPlayerUI *d, iPaint *p) {
                   dot);
     }
 }
+
+float seekTime_PlayerUI(const iPlayerUI *d, iInt2 pos) {
+    /* Seeking is limited to the part of the stream that has been downloaded. */
+    const float scaleTime = scrubberTime_(d->player);
+    const int   width     = d->scrubberSpan.end - d->scrubberSpan.start;
+    if (scaleTime <= 0 || width <= 0) {
+        return time_Player(d->player);
+    }
+    const float normPos = iClamp((float) (pos.x - d->scrubberSpan.start) / (float) width, 0.0f, 1.0f);
+    return iMin(normPos * scaleTime, seekableTime_Player(d->player));
+}
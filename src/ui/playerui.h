@@ -22,6 +22,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #pragma once
 
+#include <the_Foundation/range.h>
 #include <the_Foundation/rect.h>
 
 iDeclareType(Paint)
@@ -34,6 +35,7 @@ struct Impl_PlayerUI {
     iRect playPauseRect;
     iRect rewindRect;
     iRect scrubberRect;
+    iRangei scrubberSpan; /* horizontal extent of the progress bar */
     iRect volumeRect;
     iRect volumeAdjustRect;
     iRect volumeSlider;
@@ -42,3 +44,4 @@ struct Impl_PlayerUI {
 
 void    init_PlayerUI   (iPlayerUI *, const iPlayer *player, iRect bounds);
 void    draw_PlayerUI   (iPlayerUI *, iPaint *p);
+float   seekTime_PlayerUI   (const iPlayerUI *, iInt2 pos);
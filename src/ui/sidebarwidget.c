@@ -38,7 +38,6 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "visited.h"
 
 #include <the_Foundation/intset.h>
-#include <the_Foundation/regexp.h>
 #include <the_Foundation/stringarray.h>
 #include <SDL_clipboard.h>
 #include <SDL_mouse.h>
@@ -80,6 +79,28 @@ iEndDefineSubclass(SidebarItem)
 
 iDefineObjectConstruction(SidebarItem)
 
+/* Bookmarks, feeds, and history may have a very large number of entries, so they are only
+   listed as lightweight rows. The list asks for SidebarItems when it needs to draw them. */
+enum iSidebarRowType {
+    bookmark_SidebarRowType,
+    feedEntry_SidebarRowType,
+    feedDate_SidebarRowType,
+    visitedUrl_SidebarRowType,
+    visitedDate_SidebarRowType,
+    visitedDateTail_SidebarRowType, /* date separators in the history are two rows tall */
+};
+
+iDeclareType(SidebarRow)
+
+struct Impl_SidebarRow {
+    enum iSidebarRowType type;
+    uint32_t             bookmarkId;
+    iString *            url;   /* visited URLs and feed entries may be removed at any time, */
+    iString *            title; /* so keep a copy */
+    iBool                isUnread;
+    iTime                when;
+};
+
 /*----------------------------------------------------------------------------------------------*/
 
 struct Impl_SidebarWidget {
@@ -94,7 +115,8 @@ struct Impl_SidebarWidget {
     iWidget *         resizer;
     SDL_Cursor *      resizeCursor;
     iWidget *         menu;
-    iSidebarItem *    contextItem; /* list item accessed in the context menu */
+    iArray            rows;
+    iSidebarItem *    contextItem; /* list item accessed in the context menu (a reference) */
 };
 
 iDefineObjectConstruction(SidebarWidget)
@@ -107,30 +129,129 @@ static int cmpTitle_Bookmark_(const iBookmark **a, const iBookmark **b) {
     return cmpStringCase_String(&(*a)->title, &(*b)->title);
 }
 
+static void clearRows_SidebarWidget_(iSidebarWidget *d) {
+    iForEach(Array, i, &d->rows) {
+        iSidebarRow *row = i.value;
+        if (row->url) {
+            delete_String(row->url);
+        }
+        if (row->title) {
+            delete_String(row->title);
+        }
+    }
+    clear_Array(&d->rows);
+}
+
+static void pushRow_SidebarWidget_(iSidebarWidget *d, enum iSidebarRowType type,
+                                   const iTime *when) {
+    iSidebarRow row;
+    iZap(row);
+    row.type = type;
+    if (when) {
+        row.when = *when;
+    }
+    pushBack_Array(&d->rows, &row);
+}
+
+static size_t numRows_SidebarWidget_(const iSidebarWidget *d) {
+    return size_Array(&d->rows);
+}
+
+static const iString *formatRowDate_SidebarWidget_(const iSidebarRow *row) {
+    iDate today, date;
+    initCurrent_Date(&today);
+    init_Date(&date, &row->when);
+    return collect_String(format_Date(&date, date.year != today.year ? "%b. %d, %Y" : "%b. %d"));
+}
+
+static iAnyObject *newItem_SidebarWidget_(iSidebarWidget *d, size_t index) {
+    const iSidebarRow *row  = constAt_Array(&d->rows, index);
+    iSidebarItem *     item = new_SidebarItem();
+    switch (row->type) {
+        case bookmark_SidebarRowType: {
+            const iBookmark *bm = get_Bookmarks(bookmarks_App(), row->bookmarkId);
+            if (!bm) {
+                break; /* removed after the rows were listed */
+            }
+            item->id   = row->bookmarkId;
+            item->icon = bm->icon;
+            set_String(&item->url, &bm->url);
+            set_String(&item->label, &bm->title);
+            /* Icons for special tags. */
+            if (hasTag_Bookmark(bm, "subscribed")) {
+                appendChar_String(&item->meta, 0x2605);
+            }
+            if (hasTag_Bookmark(bm, "homepage")) {
+                appendChar_String(&item->meta, 0x1f3e0);
+            }
+            break;
+        }
+        case feedEntry_SidebarRowType: {
+            if (equal_String(url_DocumentWidget(document_App()), row->url)) {
+                item->listItem.isSelected = iTrue; /* currently being viewed */
+            }
+            item->indent = row->isUnread;
+            set_String(&item->url, row->url);
+            set_String(&item->label, row->title);
+            const iBookmark *bm = get_Bookmarks(bookmarks_App(), row->bookmarkId);
+            if (bm) {
+                item->id = row->bookmarkId;
+                item->icon = bm->icon;
+                append_String(&item->meta, &bm->title);
+            }
+            break;
+        }
+        case feedDate_SidebarRowType:
+            item->listItem.isSeparator = iTrue;
+            item->id = (index > 0); /* draw a line above it */
+            set_String(&item->meta, formatRowDate_SidebarWidget_(row));
+            break;
+        case visitedUrl_SidebarRowType:
+            set_String(&item->url, row->url);
+            break;
+        case visitedDate_SidebarRowType:
+        case visitedDateTail_SidebarRowType: {
+            const int yOffset = itemHeight_ListWidget(d->list) * 2 / 3;
+            item->listItem.isSeparator = iTrue;
+            item->id = (row->type == visitedDate_SidebarRowType
+                            ? yOffset
+                            : -itemHeight_ListWidget(d->list) + yOffset);
+            set_String(&item->meta, formatRowDate_SidebarWidget_(row));
+            break;
+        }
+    }
+    return item;
+}
+
+static const iListSource rowSource_SidebarWidget_ = {
+    .numItems = (iAny *) numRows_SidebarWidget_,
+    .newItem  = (iAny *) newItem_SidebarWidget_,
+};
+
+static void setContextItem_SidebarWidget_(iSidebarWidget *d, iSidebarItem *item) {
+    if (d->contextItem) {
+        iRelease(d->contextItem);
+    }
+    d->contextItem = item ? ref_Object(item) : NULL;
+}
+
 static void updateItems_SidebarWidget_(iSidebarWidget *d) {
     clear_ListWidget(d->list);
+    clearRows_SidebarWidget_(d);
     releaseChildren_Widget(d->blank);
     destroy_Widget(d->menu);
     d->menu = NULL;
     switch (d->mode) {
         case feeds_SidebarMode: {
-            const iString *docUrl = url_DocumentWidget(document_App());
             iTime now;
             iDate on;
             initCurrent_Time(&now);
-            init_Date(&on, &now);
-            const int thisYear = on.year;
             iZap(on);
             iConstForEach(PtrArray, i, listEntries_Feeds()) {
                 const iFeedEntry *entry = i.ptr;
                 if (isHidden_FeedEntry(entry)) {
                     continue; /* A hidden entry. */
                 }
-                /* For more items, one can always see "about:feeds". A large number of items
-                   is a bit difficult to navigate in the sidebar. */
-                if (numItems_ListWidget(d->list) == 100) {
-                    break;
-                }
                 /* Exclude entries that are too old for Visited to keep track of. */
                 if (secondsSince_Time(&now, &entry->discovered) > maxAge_Visited) {
                     break; /* the rest are even older */
@@ -141,31 +262,17 @@ static void updateItems_SidebarWidget_(iSidebarWidget *d) {
                     if (on.year != entryDate.year || on.month != entryDate.month ||
                         on.day != entryDate.day) {
                         on = entryDate;
-                        iSidebarItem *sep = new_SidebarItem();
-                        sep->listItem.isSeparator = iTrue;
-                        iString *text = format_Date(&on, on.year == thisYear ? "%b. %d" : "%b. %d, %Y");
-                        set_String(&sep->meta, text);
-                        delete_String(text);
-                        addItem_ListWidget(d->list, sep);
-                        iRelease(sep);
+                        pushRow_SidebarWidget_(d, feedDate_SidebarRowType, &entry->posted);
                     }
                 }
-                iSidebarItem *item = new_SidebarItem();
-                if (equal_String(docUrl, &entry->url)) {
-                    item->listItem.isSelected = iTrue; /* currently being viewed */
-                }
-                item->indent = isUnread_FeedEntry(entry);
-                set_String(&item->url, &entry->url);
-                set_String(&item->label, &entry->title);
-                const iBookmark *bm = get_Bookmarks(bookmarks_App(), entry->bookmarkId);
-                if (bm) {
-                    item->id = entry->bookmarkId;
-                    item->icon = bm->icon;
-                    append_String(&item->meta, &bm->title);
-                }
-                addItem_ListWidget(d->list, item);
-                iRelease(item);
+                pushRow_SidebarWidget_(d, feedEntry_SidebarRowType, NULL);
+                iSidebarRow *row = (iSidebarRow *) back_Array(&d->rows);
+                row->bookmarkId = entry->bookmarkId;
+                row->url        = copy_String(&entry->url);
+                row->title      = copy_String(&entry->title);
+                row->isUnread   = isUnread_FeedEntry(entry);
             }
+            setSource_ListWidget(d->list, &rowSource_SidebarWidget_, d);
             d->menu = makeMenu_Widget(
                 as_Widget(d),
                 (iMenuItem[]){ { "Open Entry in New Tab", 0, 0, "feed.entry.opentab" },
@@ -195,29 +302,11 @@ static void updateItems_SidebarWidget_(iSidebarWidget *d) {
             break;
         }
         case bookmarks_SidebarMode: {
-            iRegExp *homeTag = iClob(new_RegExp("\\bhomepage\\b", caseSensitive_RegExpOption));
-            iRegExp *subTag  = iClob(new_RegExp("\\bsubscribed\\b", caseSensitive_RegExpOption));
             iConstForEach(PtrArray, i, list_Bookmarks(bookmarks_App(), cmpTitle_Bookmark_, NULL, NULL)) {
-                const iBookmark *bm = i.ptr;
-                iSidebarItem *item = new_SidebarItem();
-                item->id = id_Bookmark(bm);
-                item->icon = bm->icon;
-                set_String(&item->url, &bm->url);
-                set_String(&item->label, &bm->title);
-                /* Icons for special tags. */ {
-                    iRegExpMatch m;
-                    init_RegExpMatch(&m);
-                    if (matchString_RegExp(subTag, &bm->tags, &m)) {
-                        appendChar_String(&item->meta, 0x2605);
-                    }
-                    init_RegExpMatch(&m);
-                    if (matchString_RegExp(homeTag, &bm->tags, &m)) {
-                        appendChar_String(&item->meta, 0x1f3e0);
-                    }
-                }
-                addItem_ListWidget(d->list, item);
-                iRelease(item);
+                pushRow_SidebarWidget_(d, bookmark_SidebarRowType, NULL);
+                ((iSidebarRow *) back_Array(&d->rows))->bookmarkId = id_Bookmark(i.ptr);
             }
+            setSource_ListWidget(d->list, &rowSource_SidebarWidget_, d);
             d->menu = makeMenu_Widget(
                 as_Widget(d),
                 (iMenuItem[]){ { "Edit Bookmark...", 0, 0, "bookmark.edit" },
@@ -233,36 +322,19 @@ static void updateItems_SidebarWidget_(iSidebarWidget *d) {
         case history_SidebarMode: {
             iDate on;
             initCurrent_Date(&on);
-            const int thisYear = on.year;
-            iConstForEach(PtrArray, i, list_Visited(visited_App(), 200)) {
+            iConstForEach(PtrArray, i, list_Visited(visited_App(), 0)) {
                 const iVisitedUrl *visit = i.ptr;
-                iSidebarItem *item = new_SidebarItem();
-                set_String(&item->url, &visit->url);
                 iDate date;
                 init_Date(&date, &visit->when);
                 if (date.day != on.day || date.month != on.month || date.year != on.year) {
                     on = date;
-                    /* Date separator. */
-                    iSidebarItem *sep = new_SidebarItem();
-                    sep->listItem.isSeparator = iTrue;
-                    const iString *text = collect_String(format_Date(
-                        &date, date.year != thisYear ? "%b. %d, %Y" : "%b. %d"));
-                    set_String(&sep->meta, text);
-                    const int yOffset = itemHeight_ListWidget(d->list) * 2 / 3;
-                    sep->id = yOffset;
-                    addItem_ListWidget(d->list, sep);
-                    iRelease(sep);
-                    /* Date separators are two items tall. */
-                    sep = new_SidebarItem();
-                    sep->listItem.isSeparator = iTrue;
-                    sep->id = -itemHeight_ListWidget(d->list) + yOffset;
-                    set_String(&sep->meta, text);
-                    addItem_ListWidget(d->list, sep);
-                    iRelease(sep);
+                    pushRow_SidebarWidget_(d, visitedDate_SidebarRowType, &visit->when);
+                    pushRow_SidebarWidget_(d, visitedDateTail_SidebarRowType, &visit->when);
                 }
-                addItem_ListWidget(d->list, item);
-                iRelease(item);
+                pushRow_SidebarWidget_(d, visitedUrl_SidebarRowType, &visit->when);
+                ((iSidebarRow *) back_Array(&d->rows))->url = copy_String(&visit->url);
             }
+            setSource_ListWidget(d->list, &rowSource_SidebarWidget_, d);
             d->menu = makeMenu_Widget(
                 as_Widget(d),
                 (iMenuItem[]){
@@ -458,10 +530,16 @@ void init_SidebarWidget(iSidebarWidget *d) {
     setBackgroundColor_Widget(d->resizer, none_ColorId);
     d->resizeCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_SIZEWE);
     d->menu = NULL;
+    init_Array(&d->rows, sizeof(iSidebarRow));
+    d->contextItem = NULL;
     addAction_Widget(w, SDLK_r, KMOD_PRIMARY | KMOD_SHIFT, "feeds.refresh");
 }
 
 void deinit_SidebarWidget(iSidebarWidget *d) {
+    setContextItem_SidebarWidget_(d, NULL);
+    clear_ListWidget(d->list);
+    clearRows_SidebarWidget_(d);
+    deinit_Array(&d->rows);
     SDL_FreeCursor(d->resizeCursor);
 }
 
@@ -563,6 +641,7 @@ void setWidth_SidebarWidget(iSidebarWidget *d, int width) {
     d->width = width;
     if (isVisible_Widget(w)) {
         w->rect.size.x = width;
+        invalidateArrange_Widget(w);
     }
     arrange_Widget(findWidget_App("doctabs"));
     checkModeButtonLayout_SidebarWidget_(d);
@@ -659,6 +738,7 @@ static iBool processEvent_SidebarWidget_(iSidebarWidget *d, const SDL_Event *ev)
             setFlags_Widget(w, hidden_WidgetFlag, isVisible_Widget(w));
             if (isVisible_Widget(w)) {
                 w->rect.size.x = d->width;
+                invalidateArrange_Widget(w);
                 invalidate_ListWidget(d->list);
             }
             arrange_Widget(w->parent);
@@ -950,7 +1030,7 @@ static iBool processEvent_SidebarWidget_(iSidebarWidget *d, const SDL_Event *ev)
                 updateMouseHover_ListWidget(d->list);
             }
             if (constHoverItem_ListWidget(d->list) || isVisible_Widget(d->menu)) {
-                d->contextItem = hoverItem_ListWidget(d->list);
+                setContextItem_SidebarWidget_(d, hoverItem_ListWidget(d->list));
                 /* Update menu items. */
                 /* TODO: Some callback-based mechanism would be nice for updating menus right
                    before they open? */
@@ -1072,7 +1152,7 @@ static void draw_SidebarItem_(const iSidebarItem *d, iPaint *p, iRect itemRect,
         const int fg = isHover ? (isPressing ? uiTextPressed_ColorId : uiTextFramelessHover_ColorId)
                                : uiText_ColorId;
         if (d->listItem.isSeparator) {
-            if (d != constItem_ListWidget(list, 0)) {
+            if (d->id) {
                 drawHLine_Paint(p,
                                 addY_I2(pos, 2 * gap_UI),
                                 width_Rect(itemRect) - scrollBarWidth,
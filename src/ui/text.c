@@ -25,6 +25,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "metrics.h"
 #include "embedded.h"
 #include "app.h"
+#include "profiler.h"
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "../stb_truetype.h"
@@ -34,7 +35,6 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <the_Foundation/hash.h>
 #include <the_Foundation/math.h>
 #include <the_Foundation/stringlist.h>
-#include <the_Foundation/regexp.h>
 #include <the_Foundation/path.h>
 #include <the_Foundation/vec2.h>
 
@@ -59,6 +59,7 @@ struct Impl_Glyph {
     iRect rect[2]; /* zero and half pixel offset */
     iInt2 d[2];
     float advance; /* scaled */
+    uint32_t cacheGeneration; /* glyph cache contents `rect` refers to */
 };
 
 void init_Glyph(iGlyph *d, iChar ch) {
@@ -68,6 +69,7 @@ void init_Glyph(iGlyph *d, iChar ch) {
     d->rect[0]    = zero_Rect();
     d->rect[1]    = zero_Rect();
     d->advance    = 0.0f;
+    d->cacheGeneration = 0;
 }
 
 void deinit_Glyph(iGlyph *d) {
@@ -138,11 +140,14 @@ static uint32_t glyphIndex_Font_(iFont *d, iChar ch) {
 }
 
 iDeclareType(Text)
-iDeclareType(CacheRow)
-
-struct Impl_CacheRow {
-    int   height;
-    iInt2 pos;
+iDeclareType(SkylineNode)
+
+/* The glyph cache is packed bottom-left along a skyline: each node is a horizontal span
+   whose free space begins at `y`. The nodes cover the full width of the cache. */
+struct Impl_SkylineNode {
+    int x;
+    int y;
+    int width;
 };
 
 struct Impl_Text {
@@ -152,16 +157,40 @@ struct Impl_Text {
     iFont          fonts[max_FontId];
     SDL_Renderer * render;
     SDL_Texture *  cache;
+    uint32_t       cacheFormat;
     iInt2          cacheSize;
-    int            cacheRowAllocStep;
+    int            cacheMaxHeight; /* the cache texture is enlarged up to this */
     int            cacheBottom;
-    iArray         cacheRows;
+    iArray         cacheSkyline;
+    size_t         cacheUsedArea; /* pixels covered by glyphs */
+    uint32_t       cacheGeneration; /* incremented when the cache is flushed */
     SDL_Palette *  grayscale;
-    iRegExp *      ansiEscape;
 };
 
 static iText text_;
 
+iDeclareType(RenderTarget)
+
+struct Impl_RenderTarget {
+    SDL_Texture *texture;
+    SDL_Rect     clip;
+    SDL_bool     isClipped;
+};
+
+static void beginTarget_Text_(iRenderTarget *old, SDL_Texture *target) {
+    old->texture   = SDL_GetRenderTarget(text_.render);
+    old->isClipped = SDL_RenderIsClipEnabled(text_.render);
+    SDL_RenderGetClipRect(text_.render, &old->clip);
+    SDL_SetRenderTarget(text_.render, target);
+}
+
+static void endTarget_Text_(const iRenderTarget *old) {
+    /* Glyphs may get cached in the middle of drawing into another texture, whose clip
+       is reset by the switch. */
+    SDL_SetRenderTarget(text_.render, old->texture);
+    SDL_RenderSetClipRect(text_.render, old->isClipped ? &old->clip : NULL);
+}
+
 static void initFonts_Text_(iText *d) {
     const float textSize = fontSize_UI * d->contentFontSize;
     const float monoSize = fontSize_UI * d->contentFontSize / contentScale_Text_ * 0.866f;
@@ -317,35 +346,66 @@ static void deinitFonts_Text_(iText *d) {
     }
 }
 
+static uint32_t cacheFormat_Text_(const SDL_RendererInfo *info) {
+    /* Glyphs are white and only use the alpha channel. Prefer a native format with 8 bits
+       of alpha so antialiasing is not quantized. */
+    for (uint32_t i = 0; i < info->num_texture_formats; i++) {
+        const uint32_t fmt = info->texture_formats[i];
+        if (SDL_ISPIXELFORMAT_ALPHA(fmt) && !SDL_ISPIXELFORMAT_FOURCC(fmt) &&
+            SDL_BYTESPERPIXEL(fmt) == 4) {
+            return fmt;
+        }
+    }
+    return SDL_PIXELFORMAT_RGBA4444;
+}
+
+static SDL_Texture *newCacheTexture_Text_(iText *d, int height) {
+    SDL_Texture *tex = SDL_CreateTexture(d->render,
+                                         d->cacheFormat,
+                                         SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET,
+                                         d->cacheSize.x,
+                                         height);
+    if (tex) {
+        iRenderTarget oldTarget;
+        beginTarget_Text_(&oldTarget, tex);
+        SDL_SetRenderDrawColor(d->render, 255, 255, 255, 0);
+        SDL_RenderClear(d->render);
+        endTarget_Text_(&oldTarget);
+        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+    }
+    return tex;
+}
+
+static void resetSkyline_Text_(iText *d) {
+    clear_Array(&d->cacheSkyline);
+    pushBack_Array(&d->cacheSkyline, &(iSkylineNode){ 0, 0, d->cacheSize.x });
+    d->cacheBottom   = 0;
+    d->cacheUsedArea = 0;
+}
+
 static void initCache_Text_(iText *d) {
-    init_Array(&d->cacheRows, sizeof(iCacheRow));
+    init_Array(&d->cacheSkyline, sizeof(iSkylineNode));
     const int textSize = d->contentFontSize * fontSize_UI;
     iAssert(textSize > 0);
-    const iInt2 cacheDims = init_I2(16, 80);
-    d->cacheSize = mul_I2(cacheDims, init1_I2(iMax(textSize, fontSize_UI)));
     SDL_RendererInfo renderInfo;
     SDL_GetRendererInfo(d->render, &renderInfo);
-    if (renderInfo.max_texture_height > 0 && d->cacheSize.y > renderInfo.max_texture_height) {
-        d->cacheSize.y = renderInfo.max_texture_height;
-        d->cacheSize.x = renderInfo.max_texture_width;
-    }    
-    d->cacheRowAllocStep = iMax(2, textSize / 6);
-    /* Allocate initial (empty) rows. These will be assigned actual locations in the cache
-       once at least one glyph is stored. */
-    for (int h = d->cacheRowAllocStep; h <= 2 * textSize + d->cacheRowAllocStep; h += d->cacheRowAllocStep) {
-        pushBack_Array(&d->cacheRows, &(iCacheRow){ .height = 0 });
+    d->cacheFormat = cacheFormat_Text_(&renderInfo);
+    /* Start small; the cache grows as glyphs are added. */
+    const int cellSize = iMax(textSize, fontSize_UI);
+    d->cacheSize      = init_I2(16 * cellSize, 8 * cellSize);
+    d->cacheMaxHeight = renderInfo.max_texture_height > 0 ? renderInfo.max_texture_height
+                                                          : 80 * cellSize;
+    if (renderInfo.max_texture_width > 0) {
+        d->cacheSize.x = iMin(d->cacheSize.x, renderInfo.max_texture_width);
     }
-    d->cacheBottom = 0;
-    d->cache = SDL_CreateTexture(d->render,
-                                 SDL_PIXELFORMAT_RGBA4444,
-                                 SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET,
-                                 d->cacheSize.x,
-                                 d->cacheSize.y);    
-    SDL_SetTextureBlendMode(d->cache, SDL_BLENDMODE_BLEND);
+    d->cacheSize.y = iMin(d->cacheSize.y, d->cacheMaxHeight);
+    resetSkyline_Text_(d);
+    d->cacheGeneration++;
+    d->cache = newCacheTexture_Text_(d, d->cacheSize.y);
 }
 
 static void deinitCache_Text_(iText *d) {
-    deinit_Array(&d->cacheRows);
+    deinit_Array(&d->cacheSkyline);
     SDL_DestroyTexture(d->cache);
 }
 
@@ -354,7 +414,6 @@ void init_Text(SDL_Renderer *render) {
     d->contentFont     = nunito_TextFont;
     d->headingFont     = nunito_TextFont;
     d->contentFontSize = contentScale_Text_;    
-    d->ansiEscape      = new_RegExp("\\[([0-9;]+)m", 0);
     d->render          = render;
     /* A grayscale palette for rasterized glyphs. */ {
         SDL_Color colors[256];
@@ -374,7 +433,6 @@ void deinit_Text(void) {
     deinitFonts_Text_(d);
     deinitCache_Text_(d);
     d->render = NULL;
-    iRelease(d->ansiEscape);
 }
 
 void setOpacity_Text(float opacity) {
@@ -439,34 +497,126 @@ iLocalDef SDL_Rect sdlRect_(const iRect rect) {
     return (SDL_Rect){ rect.pos.x, rect.pos.y, rect.size.x, rect.size.y };
 }
 
-iLocalDef iCacheRow *cacheRow_Text_(iText *d, int height) {
-    return at_Array(&d->cacheRows, (height - 1) / d->cacheRowAllocStep);
+static iBool growCache_Text_(iText *d, int minHeight) {
+    int height = d->cacheSize.y;
+    while (height < minHeight) {
+        height *= 2;
+    }
+    height = iMin(height, d->cacheMaxHeight);
+    SDL_Texture *grown = newCacheTexture_Text_(d, height);
+    if (!grown) {
+        return iFalse;
+    }
+    /* Carry over the existing glyphs and the current drawing state. */
+    SDL_BlendMode blend;
+    Uint8 alpha, red, green, blue;
+    SDL_GetTextureBlendMode(d->cache, &blend);
+    SDL_GetTextureAlphaMod(d->cache, &alpha);
+    SDL_GetTextureColorMod(d->cache, &red, &green, &blue);
+    SDL_SetTextureBlendMode(d->cache, SDL_BLENDMODE_NONE);
+    SDL_SetTextureAlphaMod(d->cache, 255);
+    SDL_SetTextureColorMod(d->cache, 255, 255, 255);
+    iRenderTarget oldTarget;
+    beginTarget_Text_(&oldTarget, grown);
+    SDL_RenderCopy(d->render, d->cache, NULL, &(SDL_Rect){ 0, 0, d->cacheSize.x, d->cacheSize.y });
+    endTarget_Text_(&oldTarget);
+    SDL_SetTextureBlendMode(grown, blend);
+    SDL_SetTextureAlphaMod(grown, alpha);
+    SDL_SetTextureColorMod(grown, red, green, blue);
+    SDL_DestroyTexture(d->cache);
+    d->cache       = grown;
+    d->cacheSize.y = height;
+    return iTrue;
+}
+
+static void flushCache_Text_(iText *d) {
+    /* All cached glyphs become stale and get rasterized again when next used. */
+    resetSkyline_Text_(d);
+    d->cacheGeneration++;
+    iRenderTarget oldTarget;
+    beginTarget_Text_(&oldTarget, d->cache);
+    SDL_SetRenderDrawColor(d->render, 255, 255, 255, 0);
+    SDL_RenderClear(d->render);
+    endTarget_Text_(&oldTarget);
+    count_Profiler(glyphCacheFlush_ProfileCounter);
 }
 
-static iInt2 assignCachePos_Text_(iText *d, iInt2 size) {
-    iCacheRow *cur = cacheRow_Text_(d, size.y);
-    if (cur->height == 0) {
-        /* Begin a new row height. */
-        cur->height = (1 + (size.y - 1) / d->cacheRowAllocStep) * d->cacheRowAllocStep;
-        cur->pos.y = d->cacheBottom;
-        d->cacheBottom = cur->pos.y + cur->height;
+static int skylineFit_Text_(const iText *d, size_t index, iInt2 size) {
+    /* Returns the top of a `size` rectangle placed at the node, or -1 if it doesn't fit. */
+    const iSkylineNode *nodes = constData_Array(&d->cacheSkyline);
+    if (nodes[index].x + size.x > d->cacheSize.x) {
+        return -1;
     }
-    iAssert(cur->height >= size.y);
-    /* TODO: Automatically enlarge the cache if running out of space?
-       Maybe make it paged, but beware of texture swapping too often inside a text string. */
-    if (cur->pos.x + size.x > d->cacheSize.x) {
-        /* Does not fit on this row, advance to a new location in the cache. */
-        cur->pos.y = d->cacheBottom;
-        cur->pos.x = 0;
-        d->cacheBottom += cur->height;
-        iAssert(d->cacheBottom <= d->cacheSize.y);
+    int y = 0;
+    for (int remaining = size.x; remaining > 0; index++) {
+        y = iMax(y, nodes[index].y);
+        remaining -= nodes[index].width;
     }
-    const iInt2 assigned = cur->pos;
-    cur->pos.x += size.x;
-    return assigned;
+    return y + size.y <= d->cacheMaxHeight ? y : -1;
 }
 
-static void cache_Font_(iFont *d, iGlyph *glyph, int hoff) {
+static iBool assignCachePos_Text_(iText *d, iInt2 size, iInt2 *pos_out) {
+    /* One pixel of padding keeps neighbors from bleeding into each other. */
+    const iInt2 padded = add_I2(size, one_I2());
+    size_t bestIndex  = iInvalidPos;
+    int    bestBottom = 0;
+    int    bestWidth  = 0;
+    iInt2  bestPos    = zero_I2();
+    for (size_t i = 0; i < size_Array(&d->cacheSkyline); i++) {
+        const iSkylineNode *node = constAt_Array(&d->cacheSkyline, i);
+        const int y = skylineFit_Text_(d, i, padded);
+        if (y < 0) {
+            continue;
+        }
+        /* Prefer the lowest resulting top edge, then the tightest span. */
+        if (bestIndex == iInvalidPos || y + padded.y < bestBottom ||
+            (y + padded.y == bestBottom && node->width < bestWidth)) {
+            bestIndex  = i;
+            bestBottom = y + padded.y;
+            bestWidth  = node->width;
+            bestPos    = init_I2(node->x, y);
+        }
+    }
+    if (bestIndex == iInvalidPos) {
+        return iFalse;
+    }
+    if (bestBottom > d->cacheSize.y && !growCache_Text_(d, bestBottom)) {
+        return iFalse;
+    }
+    /* Raise the skyline over the new rectangle. */
+    insert_Array(&d->cacheSkyline, bestIndex, &(iSkylineNode){ bestPos.x, bestBottom, padded.x });
+    for (size_t i = bestIndex + 1; i < size_Array(&d->cacheSkyline); ) {
+        const iSkylineNode *prev = constAt_Array(&d->cacheSkyline, i - 1);
+        iSkylineNode *      node = at_Array(&d->cacheSkyline, i);
+        const int overlap = prev->x + prev->width - node->x;
+        if (overlap <= 0) {
+            break;
+        }
+        node->x     += overlap;
+        node->width -= overlap;
+        if (node->width > 0) {
+            break;
+        }
+        remove_Array(&d->cacheSkyline, i);
+    }
+    for (size_t i = 0; i + 1 < size_Array(&d->cacheSkyline); ) {
+        iSkylineNode *      node = at_Array(&d->cacheSkyline, i);
+        const iSkylineNode *next = constAt_Array(&d->cacheSkyline, i + 1);
+        if (node->y == next->y) {
+            node->width += next->width;
+            remove_Array(&d->cacheSkyline, i + 1);
+        }
+        else {
+            i++;
+        }
+    }
+    d->cacheBottom = iMax(d->cacheBottom, bestBottom);
+    d->cacheUsedArea += (size_t) size.x * size.y;
+    *pos_out = bestPos;
+    return iTrue;
+}
+
+static iBool cache_Font_(iFont *d, iGlyph *glyph, int hoff) {
     iText *txt = &text_;
     SDL_Renderer *render = txt->render;
     SDL_Texture *tex = NULL;
@@ -495,15 +645,22 @@ static void cache_Font_(iFont *d, iGlyph *glyph, int hoff) {
         SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_NONE);
         glRect->size = init_I2(surface->w, surface->h);
     }
+    iBool isCached = iTrue;
     if (tex) {
-        /* Determine placement in the glyph cache texture, advancing in rows. */
-        glRect->pos = assignCachePos_Text_(txt, glRect->size);
-        const SDL_Rect dstRect = sdlRect_(*glRect);
-        SDL_RenderCopy(render, tex, &(SDL_Rect){ 0, 0, dstRect.w, dstRect.h }, &dstRect);
+        /* Determine placement in the glyph cache texture. This may enlarge the texture. */
+        isCached = assignCachePos_Text_(txt, glRect->size, &glRect->pos);
+        if (isCached) {
+            iRenderTarget oldTarget;
+            beginTarget_Text_(&oldTarget, txt->cache);
+            const SDL_Rect dstRect = sdlRect_(*glRect);
+            SDL_RenderCopy(render, tex, &(SDL_Rect){ 0, 0, dstRect.w, dstRect.h }, &dstRect);
+            endTarget_Text_(&oldTarget);
+        }
         SDL_DestroyTexture(tex);
         iAssert(surface);
         SDL_FreeSurface(surface);
     }
+    return isCached;
 }
 
 iLocalDef iFont *characterFont_Font_(iFont *d, iChar ch, uint32_t *glyphIndex) {
@@ -552,19 +709,26 @@ static const iGlyph *glyph_Font_(iFont *d, iChar ch) {
     uint32_t glyphIndex = 0;
     /* The glyph may actually come from a different font; look up the right font. */
     iFont *font = characterFont_Font_(d, ch, &glyphIndex);
-    const void *node = value_Hash(&font->glyphs, ch);
-    if (node) {
-        return node;
+    iGlyph *glyph = (iGlyph *) value_Hash(&font->glyphs, ch);
+    if (glyph && glyph->cacheGeneration == text_.cacheGeneration) {
+        return glyph;
+    }
+    const uint64_t profileTime = begin_Profiler();
+    if (!glyph) {
+        glyph             = new_Glyph(ch);
+        glyph->glyphIndex = glyphIndex;
+        glyph->font       = font;
+        insert_Hash(&font->glyphs, &glyph->node);
     }
-    iGlyph *glyph     = new_Glyph(ch);
-    glyph->glyphIndex = glyphIndex;
-    glyph->font       = font;
-    SDL_Texture *oldTarget = SDL_GetRenderTarget(text_.render);
-    SDL_SetRenderTarget(text_.render, text_.cache);
-    cache_Font_(font, glyph, 0);
-    cache_Font_(font, glyph, 1); /* half-pixel offset */
-    SDL_SetRenderTarget(text_.render, oldTarget);
-    insert_Hash(&font->glyphs, &glyph->node);
+    /* Glyph objects are kept when the cache is flushed, so callers may hold on to them. */
+    if (!cache_Font_(font, glyph, 0) || !cache_Font_(font, glyph, 1) /* half-pixel offset */) {
+        flushCache_Text_(&text_);
+        cache_Font_(font, glyph, 0);
+        cache_Font_(font, glyph, 1);
+    }
+    glyph->cacheGeneration = text_.cacheGeneration;
+    count_Profiler(glyphCacheMiss_ProfileCounter);
+    end_Profiler(cacheGlyph_ProfileZone, profileTime);
     return glyph;
 }
 
@@ -611,6 +775,26 @@ iLocalDef iBool isWrapBoundary_(iChar prevC, iChar c) {
     return isSpace_Char(c);
 }
 
+static iBool parseAnsiEscape_(const char *chPos, const char *end, iRangecc *params_out,
+                              const char **end_out) {
+    /* An SGR sequence following the ESC character: "[<params>m". This is checked for every
+       escape while drawing and measuring, so it is parsed directly instead of matching a
+       regular expression. */
+    if (chPos == end || *chPos != '[') {
+        return iFalse;
+    }
+    const char *start = ++chPos;
+    while (chPos != end && ((*chPos >= '0' && *chPos <= '9') || *chPos == ';')) {
+        chPos++;
+    }
+    if (chPos == start || chPos == end || *chPos != 'm') {
+        return iFalse;
+    }
+    *params_out = (iRangecc){ start, chPos };
+    *end_out    = chPos + 1;
+    return iTrue;
+}
+
 iLocalDef iBool isMeasuring_(enum iRunMode mode) {
     return mode == measure_RunMode || mode == measureNoWrap_RunMode ||
            mode == measureVisual_RunMode;
@@ -638,16 +822,15 @@ static iRect run_Font_(iFont *d, enum iRunMode mode, iRangecc text, size_t maxLe
         if (*chPos == 0x1b) {
             /* ANSI escape. */
             chPos++;
-            iRegExpMatch m;
-            init_RegExpMatch(&m);
-            if (match_RegExp(text_.ansiEscape, chPos, text.end - chPos, &m)) {
+            iRangecc    params;
+            const char *escEnd;
+            if (parseAnsiEscape_(chPos, text.end, &params, &escEnd)) {
                 if (mode == draw_RunMode) {
                     /* Change the color. */
-                    const iColor clr =
-                        ansiForeground_Color(capturedRange_RegExpMatch(&m, 1), tmParagraph_ColorId);
+                    const iColor clr = ansiForeground_Color(params, tmParagraph_ColorId);
                     SDL_SetTextureColorMod(text_.cache, clr.r, clr.g, clr.b);
                 }
-                chPos = end_RegExpMatch(&m);
+                chPos = escEnd;
                 continue;
             }
         }
@@ -948,6 +1131,17 @@ SDL_Texture *glyphCache_Text(void) {
     return text_.cache;
 }
 
+float glyphCacheUsage_Text(void) {
+    const iText *d = &text_;
+    const size_t allocated = (size_t) d->cacheSize.x * d->cacheBottom;
+    return allocated ? (float) d->cacheUsedArea / allocated : 0.0f;
+}
+
+size_t glyphCacheBytes_Text(void) {
+    const iText *d = &text_;
+    return (size_t) d->cacheSize.x * d->cacheSize.y * SDL_BYTESPERPIXEL(d->cacheFormat);
+}
+
 static void freeBitmap_(void *ptr) {
     stbtt_FreeBitmap(ptr, NULL);
 }
@@ -1065,14 +1259,14 @@ void init_TextBuf(iTextBuf *d, int font, const char *text) {
                                    SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET,
                                    d->size.x,
                                    d->size.y);
-    SDL_Texture *oldTarget = SDL_GetRenderTarget(render);
-    SDL_SetRenderTarget(render, d->texture);
+    iRenderTarget oldTarget;
+    beginTarget_Text_(&oldTarget, d->texture);
     SDL_SetTextureBlendMode(text_.cache, SDL_BLENDMODE_NONE); /* blended when TextBuf is drawn */
     SDL_SetRenderDrawColor(text_.render, 255, 255, 255, 0);
     SDL_RenderClear(text_.render);
     draw_Text_(font, zero_I2(), white_ColorId, range_CStr(text));
     SDL_SetTextureBlendMode(text_.cache, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderTarget(render, oldTarget);
+    endTarget_Text_(&oldTarget);
     SDL_SetTextureBlendMode(d->texture, SDL_BLENDMODE_BLEND);
 }
 
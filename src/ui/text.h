@@ -165,6 +165,8 @@ void    drawRange_Text      (int fontId, iInt2 pos, int color, iRangecc text);
 int     drawWrapRange_Text  (int fontId, iInt2 pos, int maxWidth, int color, iRangecc text); /* returns new Y */
 
 SDL_Texture *   glyphCache_Text     (void);
+float           glyphCacheUsage_Text(void); /* fraction of the filled area covered by glyphs */
+size_t          glyphCacheBytes_Text(void);
 
 enum iTextBlockMode { quadrants_TextBlockMode, shading_TextBlockMode };
 
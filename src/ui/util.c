@@ -45,12 +45,12 @@ iBool isCommand_SDLEvent(const SDL_Event *d) {
 
 iBool isCommand_UserEvent(const SDL_Event *d, const char *cmd) {
     return d->type == SDL_USEREVENT && d->user.code == command_UserEventCode &&
-           equal_Command(d->user.data1, cmd);
+           equal_Command(cstr_Command(d->user.data1), cmd);
 }
 
 const char *command_UserEvent(const SDL_Event *d) {
     if (d->type == SDL_USEREVENT && d->user.code == command_UserEventCode) {
-        return d->user.data1;
+        return cstr_Command(d->user.data1);
     }
     return "";
 }
@@ -142,6 +142,15 @@ iRangei intersect_Rangei(iRangei a, iRangei b) {
     return (iRangei){ iMax(a.start, b.start), iMin(a.end, b.end) };
 }
 
+iRect clipped_Rect(iRect d, iRect clip) {
+    const iRangei x = intersect_Rangei(xSpan_Rect(d), xSpan_Rect(clip));
+    const iRangei y = intersect_Rangei(ySpan_Rect(d), ySpan_Rect(clip));
+    if (isEmpty_Rangei(x) || isEmpty_Rangei(y)) {
+        return zero_Rect();
+    }
+    return init_Rect(x.start, y.start, x.end - x.start, y.end - y.start);
+}
+
 iRangei union_Rangei(iRangei a, iRangei b) {
     if (isEmpty_Rangei(a)) return b;
     if (isEmpty_Rangei(b)) return a;
@@ -367,10 +376,11 @@ iWidget *addAction_Widget(iWidget *parent, int key, int kmods, const char *comma
 /*-----------------------------------------------------------------------------------------------*/
 
 static iBool isCommandIgnoredByMenus_(const char *cmd) {
-    return equal_Command(cmd, "media.updated") || equal_Command(cmd, "media.player.update") ||
+    const enum iCommandId id = id_Command(cmd);
+    return id == mediaUpdated_CommandId || id == mediaPlayerUpdate_CommandId ||
            startsWith_CStr(cmd, "feeds.update.") ||
-           equal_Command(cmd, "document.request.updated") || equal_Command(cmd, "window.resized") ||
-           (equal_Command(cmd, "mouse.clicked") && !arg_Command(cmd)); /* button released */
+           id == documentRequestUpdated_CommandId || id == windowResized_CommandId ||
+           (id == mouseClicked_CommandId && !arg_Command(cmd)); /* button released */
 }
 
 static iBool menuHandler_(iWidget *menu, const char *cmd) {
@@ -410,6 +420,7 @@ iWidget *makeMenu_Widget(iWidget *parent, const iMenuItem *items, size_t n) {
             iWidget *sep = addChild_Widget(menu, iClob(new_Widget()));
             setBackgroundColor_Widget(sep, uiSeparator_ColorId);
             sep->rect.size.y = gap_UI / 3;
+            invalidateArrange_Widget(sep);
             setFlags_Widget(sep, hover_WidgetFlag | fixedHeight_WidgetFlag, iTrue);
         }
         else {
@@ -773,6 +784,7 @@ void makeFilePath_Widget(iWidget *      parent,
     }
     setId_Widget(as_Widget(input), "input");
     as_Widget(input)->rect.size.x = dlg->rect.size.x;
+    invalidateArrange_Widget(input);
     addChild_Widget(dlg, iClob(makePadding_Widget(gap_UI)));
     iWidget *div = new_Widget(); {
         setFlags_Widget(div, arrangeHorizontal_WidgetFlag | arrangeSize_WidgetFlag, iTrue);
@@ -801,6 +813,7 @@ static void updateValueInputWidth_(iWidget *dlg) {
     iWidget *   prompt   = findChild_Widget(dlg, "valueinput.prompt");
     dlg->rect.size.x     = iMaxi(iMaxi(rootSize.x / 2, title->rect.size.x), prompt->rect.size.x);
     as_Widget(findChild_Widget(dlg, "input"))->rect.size.x = dlg->rect.size.x;
+    invalidateArrange_Widget(findChild_Widget(dlg, "input")); /* and `dlg` as its parent */
     centerSheet_Widget(dlg);
 }
 
@@ -890,8 +903,9 @@ void updateValueInput_Widget(iWidget *d, const char *title, const char *prompt)
 
 static iBool messageHandler_(iWidget *msg, const char *cmd) {
     /* Almost any command dismisses the sheet. */
-    if (!(equal_Command(cmd, "media.updated") || equal_Command(cmd, "media.player.update") ||
-          equal_Command(cmd, "document.request.updated") || startsWith_CStr(cmd, "window."))) {
+    const enum iCommandId id = id_Command(cmd);
+    if (!(id == mediaUpdated_CommandId || id == mediaPlayerUpdate_CommandId ||
+          id == documentRequestUpdated_CommandId || startsWith_CStr(cmd, "window."))) {
         destroy_Widget(msg);
     }
     return iFalse;
@@ -999,6 +1013,7 @@ static void expandInputFieldWidth_(iInputWidget *input) {
     iWidget *page = as_Widget(input)->parent->parent->parent->parent; /* tabs > page > values > input */
     as_Widget(input)->rect.size.x =
         right_Rect(bounds_Widget(page)) - left_Rect(bounds_Widget(constAs_Widget(input)));
+    invalidateArrange_Widget(input);
 }
 
 static void addRadioButton_(iWidget *parent, const char *id, const char *label, const char *cmd) {
@@ -1191,6 +1206,7 @@ iWidget *makeBookmarkEditor_Widget(void) {
     arrange_Widget(dlg);
     for (int i = 0; i < 3; ++i) {
         as_Widget(inputs[i])->rect.size.x = 100 * gap_UI - headings->rect.size.x;
+        invalidateArrange_Widget(inputs[i]);
     }
     iWidget *div = new_Widget(); {
         setFlags_Widget(div, arrangeHorizontal_WidgetFlag | arrangeSize_WidgetFlag, iTrue);
@@ -1285,6 +1301,7 @@ iWidget *makeFeedSettings_Widget(uint32_t bookmarkId) {
     addChild_Widget(dlg, iClob(div));
     arrange_Widget(dlg);
     as_Widget(input)->rect.size.x = 100 * gap_UI - headings->rect.size.x;
+    invalidateArrange_Widget(input);
     addChild_Widget(get_Window()->root, iClob(dlg));
     centerSheet_Widget(dlg);
     return dlg;
@@ -1342,6 +1359,7 @@ iWidget *makeIdentityCreation_Widget(void) {
     arrange_Widget(dlg);
     for (size_t i = 0; i < iElemCount(inputs); ++i) {
         as_Widget(inputs[i])->rect.size.x = 100 * gap_UI - headings->rect.size.x;
+        invalidateArrange_Widget(inputs[i]);
     }
     iWidget *div = new_Widget(); {
         setFlags_Widget(div, arrangeHorizontal_WidgetFlag | arrangeSize_WidgetFlag, iTrue);
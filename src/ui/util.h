@@ -66,6 +66,8 @@ iLocalDef iBool isOverlapping_Rangei(iRangei a, iRangei b) {
     return !isEmpty_Rangei(intersect_Rangei(a, b));
 }
 
+iRect       clipped_Rect        (iRect d, iRect clip); /* intersection; zero if none */
+
 /*-----------------------------------------------------------------------------------------------*/
 
 iDeclareType(Anim)
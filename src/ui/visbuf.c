@@ -24,10 +24,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "window.h"
 #include "util.h"
 
+#include <limits.h>
+
 iDefineTypeConstruction(VisBuf)
 
 void init_VisBuf(iVisBuf *d) {
-    d->texSize = zero_I2();
+    d->texSize      = zero_I2();
+    iZap(d->vis);
+    d->numBuffers   = 3;
+    d->tilesPerView = 2;
     iZap(d->buffers);
 }
 
@@ -35,18 +40,80 @@ void deinit_VisBuf(iVisBuf *d) {
     dealloc_VisBuf(d);
 }
 
+static int tileIndex_VisBuf_(const iVisBuf *d, int pos) {
+    /* Rounds down also when `pos` is above the top of the content. */
+    const int height = d->texSize.y;
+    return pos >= 0 ? pos / height : -((height - 1 - pos) / height);
+}
+
+static iRangei region_VisBuf_(const iVisBuf *d, const iVisBufTexture *buf) {
+    return (iRangei){ buf->origin, buf->origin + d->texSize.y };
+}
+
+static iVisBufTexture *findTile_VisBuf_(iVisBuf *d, int index) {
+    for (size_t i = 0; i < d->numBuffers; i++) {
+        if (d->buffers[i].origin == index * d->texSize.y) {
+            return &d->buffers[i];
+        }
+    }
+    return NULL;
+}
+
+static iVisBufTexture *reusable_VisBuf_(iVisBuf *d, const iRangei keep) {
+    iVisBufTexture *reuse     = NULL;
+    int             reuseDist = -1;
+    for (size_t i = 0; i < d->numBuffers; i++) {
+        iVisBufTexture *buf    = &d->buffers[i];
+        const iRangei   region = region_VisBuf_(d, buf);
+        if (isOverlapping_Rangei(keep, region)) {
+            continue;
+        }
+        /* Empty tiles go first, then the ones farthest from the visible range. */
+        const int dist = isEmpty_Rangei(buf->validRange) ? INT_MAX
+                         : region.start >= d->vis.end   ? region.start - d->vis.end
+                                                         : d->vis.start - region.end;
+        if (dist > reuseDist) {
+            reuse     = buf;
+            reuseDist = dist;
+        }
+    }
+    return reuse;
+}
+
 void invalidate_VisBuf(iVisBuf *d) {
-    iForIndices(i, d->buffers) {
+    for (size_t i = 0; i < d->numBuffers; i++) {
         d->buffers[i].origin = i * d->texSize.y;
         iZap(d->buffers[i].validRange);
     }
 }
 
+void invalidateRange_VisBuf(iVisBuf *d, const iRangei range) {
+    for (size_t i = 0; i < d->numBuffers; i++) {
+        iVisBufTexture *buf = &d->buffers[i];
+        if (isOverlapping_Rangei(range, region_VisBuf_(d, buf))) {
+            iZap(buf->validRange);
+        }
+    }
+}
+
+void setTiles_VisBuf(iVisBuf *d, size_t numBuffers, int tilesPerView) {
+    iAssert(tilesPerView >= 1 && tilesPerView < maxBuffers_VisBuf);
+    /* The visible range may straddle one more tile than fits in the view. */
+    numBuffers = iMax(numBuffers, (size_t) tilesPerView + 1);
+    numBuffers = iMin(numBuffers, (size_t) maxBuffers_VisBuf);
+    if (numBuffers != d->numBuffers || tilesPerView != d->tilesPerView) {
+        dealloc_VisBuf(d);
+        d->numBuffers   = numBuffers;
+        d->tilesPerView = tilesPerView;
+    }
+}
+
 void alloc_VisBuf(iVisBuf *d, const iInt2 size, int granularity) {
-    const iInt2 texSize = init_I2(size.x, (size.y / 2 / granularity + 1) * granularity);
+    const iInt2 texSize =
+        init_I2(size.x, (size.y / d->tilesPerView / granularity + 1) * granularity);
     if (!d->buffers[0].texture || !isEqual_I2(texSize, d->texSize)) {
         d->texSize = texSize;
-        iForIndices(i, d->buffers) {
+        for (size_t i = 0; i < d->numBuffers; i++) {
             iVisBufTexture *tex = &d->buffers[i];
             if (tex->texture) {
                 SDL_DestroyTexture(tex->texture);
@@ -66,57 +133,43 @@ void alloc_VisBuf(iVisBuf *d, const iInt2 size, int granularity) {
 
 void dealloc_VisBuf(iVisBuf *d) {
     d->texSize = zero_I2();
-    iForIndices(i, d->buffers) {
-        SDL_DestroyTexture(d->buffers[i].texture);
-        d->buffers[i].texture = NULL;
+    for (size_t i = 0; i < d->numBuffers; i++) {
+        if (d->buffers[i].texture) {
+            SDL_DestroyTexture(d->buffers[i].texture);
+            d->buffers[i].texture = NULL;
+        }
     }
 }
 
 void reposition_VisBuf(iVisBuf *d, const iRangei vis) {
     d->vis = vis;
-    iRangei good = { 0, 0 };
-    size_t avail[3], numAvail = 0;
-    /* Check which buffers are available for reuse. */ {
-        iForIndices(i, d->buffers) {
-            iVisBufTexture *buf = d->buffers + i;
-            const iRangei region = { buf->origin, buf->origin + d->texSize.y };
-            if (region.start >= vis.end || region.end <= vis.start) {
-                avail[numAvail++] = i;
-                iZap(buf->validRange);
-            }
-            else {
-                good = union_Rangei(good, region);
-            }
-        }
+    if (!d->texSize.y) {
+        return;
     }
-    if (numAvail == iElemCount(d->buffers)) {
-        /* All buffers are outside the visible range, do a reset. */
-        d->buffers[0].origin = vis.start;
-        d->buffers[1].origin = vis.start + d->texSize.y;
-        d->buffers[2].origin = vis.start + 2 * d->texSize.y;
-    }
-    else {
-        /* Extend to cover the visible range. */
-        while (vis.start < good.start) {
-            iAssert(numAvail > 0);
-            d->buffers[avail[--numAvail]].origin = good.start - d->texSize.y;
-            good.start -= d->texSize.y;
-        }
-        while (vis.end > good.end) {
-            iAssert(numAvail > 0);
-            d->buffers[avail[--numAvail]].origin = good.end;
-            good.end += d->texSize.y;
+    const int first = tileIndex_VisBuf_(d, vis.start);
+    const int last  = iMin(tileIndex_VisBuf_(d, vis.end - 1), first + (int) d->numBuffers - 1);
+    /* Tiles already in place are kept; the others are taken over from outside the view. */
+    for (int index = first; index <= last; index++) {
+        if (!findTile_VisBuf_(d, index)) {
+            iVisBufTexture *buf = reusable_VisBuf_(d, vis);
+            iAssert(buf);
+            buf->origin = index * d->texSize.y;
+            iZap(buf->validRange);
         }
     }
 }
 
 void invalidRanges_VisBuf(const iVisBuf *d, const iRangei full, iRangei *out_invalidRanges) {
-    iForIndices(i, d->buffers) {
+    for (size_t i = 0; i < d->numBuffers; i++) {
         const iVisBufTexture *buf = d->buffers + i;
         const iRangei before = { full.start, buf->validRange.start };
         const iRangei after  = { buf->validRange.end, full.end };
-        const iRangei region = intersect_Rangei(d->vis, (iRangei){ buf->origin,
-                                                                   buf->origin + d->texSize.y });
+        const iRangei region = region_VisBuf_(d, buf);
+        iZap(out_invalidRanges[i]);
+        if (!isOverlapping_Rangei(d->vis, region)) {
+            continue; /* see prerender_VisBuf() */
+        }
+        /* Visible tiles are always rendered in full so they stay valid while scrolling. */
         out_invalidRanges[i] = intersect_Rangei(before, region);
         if (isEmpty_Rangei(out_invalidRanges[i])) {
             out_invalidRanges[i] = intersect_Rangei(after, region);
@@ -124,18 +177,70 @@ void invalidRanges_VisBuf(const iVisBuf *d, const iRangei full, iRangei *out_inv
     }
 }
 
-void validate_VisBuf(iVisBuf *d) {
-    iForIndices(i, d->buffers) {
-        iVisBufTexture *buf = &d->buffers[i];
-        buf->validRange =
-            intersect_Rangei(d->vis, (iRangei){ buf->origin, buf->origin + d->texSize.y });
+iVisBufTexture *prerender_VisBuf(iVisBuf *d, const iRangei ahead, const iRangei full,
+                                 iRangei *out_range) {
+    const iRangei bounds = intersect_Rangei(ahead, full);
+    if (!d->texSize.y || !d->buffers[0].texture || isEmpty_Rangei(bounds) ||
+        isEmpty_Rangei(d->vis)) {
+        return NULL;
+    }
+    const iRangei keep     = union_Rangei(d->vis, bounds);
+    const int     visFirst = tileIndex_VisBuf_(d, d->vis.start);
+    const int     visLast  = tileIndex_VisBuf_(d, d->vis.end - 1);
+    const int     first    = tileIndex_VisBuf_(d, bounds.start);
+    const int     last     = tileIndex_VisBuf_(d, bounds.end - 1);
+    /* Nearest tiles first, leaning towards the side where `ahead` extends further. */
+    const iBool isDownFirst = (last - visLast >= visFirst - first);
+    for (int dist = 1; visLast + dist <= last || visFirst - dist >= first; dist++) {
+        const int candidates[2] = { isDownFirst ? visLast + dist : visFirst - dist,
+                                    isDownFirst ? visFirst - dist : visLast + dist };
+        iForIndices(c, candidates) {
+            const int index = candidates[c];
+            if (index < first || index > last) {
+                continue;
+            }
+            const iRangei tile = intersect_Rangei(
+                full, (iRangei){ index * d->texSize.y, (index + 1) * d->texSize.y });
+            if (isEmpty_Rangei(tile)) {
+                continue;
+            }
+            iVisBufTexture *buf = findTile_VisBuf_(d, index);
+            if (buf && buf->validRange.start == tile.start && buf->validRange.end == tile.end) {
+                continue; /* already done */
+            }
+            if (!buf) {
+                buf = reusable_VisBuf_(d, keep);
+                if (!buf) {
+                    return NULL; /* all tiles are in use */
+                }
+                buf->origin = index * d->texSize.y;
+            }
+            /* The caller will clear the texture and render the range. */
+            buf->validRange = tile;
+            *out_range      = tile;
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+void validate_VisBuf(iVisBuf *d, const iRangei full) {
+    for (size_t i = 0; i < d->numBuffers; i++) {
+        iVisBufTexture *buf    = &d->buffers[i];
+        const iRangei   region = region_VisBuf_(d, buf);
+        if (isOverlapping_Rangei(d->vis, region)) {
+            buf->validRange = intersect_Rangei(full, region);
+        }
     }
 }
 
 void draw_VisBuf(const iVisBuf *d, iInt2 topLeft) {
     SDL_Renderer *render = renderer_Window(get_Window());
-    iForIndices(i, d->buffers) {
+    for (size_t i = 0; i < d->numBuffers; i++) {
         const iVisBufTexture *buf = d->buffers + i;
+        if (!isOverlapping_Rangei(d->vis, region_VisBuf_(d, buf))) {
+            continue;
+        }
         SDL_RenderCopy(render,
                        buf->texture,
                        NULL,
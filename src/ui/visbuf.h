@@ -35,19 +35,29 @@ struct Impl_VisBufTexture {
     iRangei validRange;
 };
 
+#define maxBuffers_VisBuf   16
+
+/* Tiles are aligned to a grid of `texSize.y`. Tiles outside the visible range keep their
+   contents until they are needed elsewhere, so they can be prerendered ahead of scrolling. */
 struct Impl_VisBuf {
     iInt2 texSize;
     iRangei vis;
-    iVisBufTexture buffers[3];
+    size_t numBuffers;
+    int tilesPerView;
+    iVisBufTexture buffers[maxBuffers_VisBuf];
 };
 
 iDeclareTypeConstruction(VisBuf)
 
 void    invalidate_VisBuf       (iVisBuf *);
+void    invalidateRange_VisBuf  (iVisBuf *, const iRangei range);
+void    setTiles_VisBuf         (iVisBuf *, size_t numBuffers, int tilesPerView);
 void    alloc_VisBuf            (iVisBuf *, const iInt2 size, int granularity);
 void    dealloc_VisBuf          (iVisBuf *);
 void    reposition_VisBuf       (iVisBuf *, const iRangei vis);
-void    validate_VisBuf         (iVisBuf *);
+void    validate_VisBuf         (iVisBuf *, const iRangei full);
 
 void    invalidRanges_VisBuf    (const iVisBuf *, const iRangei full, iRangei *out_invalidRanges);
+iVisBufTexture *prerender_VisBuf(iVisBuf *, const iRangei ahead, const iRangei full,
+                                 iRangei *out_range);
 void    draw_VisBuf             (const iVisBuf *, iInt2 topLeft);
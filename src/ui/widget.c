@@ -73,7 +73,7 @@ iDefineObjectConstruction(Widget)
 
 void init_Widget(iWidget *d) {
     init_String(&d->id);
-    d->flags          = 0;
+    d->flags          = needsArrange_WidgetFlag;
     d->rect           = zero_Rect();
     d->bgColor        = none_ColorId;
     d->frameColor     = none_ColorId;
@@ -129,9 +129,49 @@ int64_t flags_Widget(const iWidget *d) {
     return d->flags;
 }
 
+/* Flags that affect the arrangement of the widget or its siblings. */
+static const int64_t layoutFlags_Widget_ =
+    hidden_WidgetFlag | tight_WidgetFlag | fixedPosition_WidgetFlag |
+    arrangeHorizontal_WidgetFlag | arrangeVertical_WidgetFlag | arrangeSize_WidgetFlag |
+    resizeChildren_WidgetFlag | expand_WidgetFlag | fixedSize_WidgetFlag |
+    resizeChildrenToWidestChild_WidgetFlag | resizeToParentWidth_WidgetFlag |
+    resizeToParentHeight_WidgetFlag | collapse_WidgetFlag | centerHorizontal_WidgetFlag |
+    moveToParentRightEdge_WidgetFlag | wrapText_WidgetFlag;
+
+/* Flags that change how the widget is drawn. */
+static const int64_t drawFlags_Widget_ =
+    hidden_WidgetFlag | disabled_WidgetFlag | selected_WidgetFlag | pressed_WidgetFlag |
+    alignLeft_WidgetFlag | alignRight_WidgetFlag | frameless_WidgetFlag | drawKey_WidgetFlag |
+    borderTop_WidgetFlag;
+
+/* Flags of widgets whose size or position depends on the parent's size. */
+static const int64_t parentDependentFlags_Widget_ =
+    resizeToParentWidth_WidgetFlag | resizeToParentHeight_WidgetFlag |
+    centerHorizontal_WidgetFlag | moveToParentRightEdge_WidgetFlag;
+
+void invalidateArrange_Widget(iAnyObject *d) {
+    /* All the way to the root, so the next arrangement reaches this widget. */
+    for (iWidget *w = d; w; w = w->parent) {
+        w->flags |= needsArrange_WidgetFlag;
+    }
+}
+
 void setFlags_Widget(iWidget *d, int64_t flags, iBool set) {
     if (d) {
+        const iBool wasPending = (d->flags & needsArrange_WidgetFlag) != 0;
+        const int64_t drawFlags = flags & drawFlags_Widget_;
+        if (set ? (d->flags & drawFlags) != drawFlags : (d->flags & drawFlags) != 0) {
+            refresh_Widget(d); /* if hidden, the area needs redrawing as well */
+        }
+        const int64_t layoutFlags = flags & layoutFlags_Widget_;
+        if (set ? (d->flags & layoutFlags) != layoutFlags : (d->flags & layoutFlags) != 0) {
+            invalidateArrange_Widget(d);
+        }
         iChangeFlags(d->flags, flags, set);
+        if (flags & hidden_WidgetFlag && !set && wasPending && d->parent) {
+            /* Changed since it was last arranged. */
+            arrange_Widget(d);
+        }
         if (flags & keepOnTop_WidgetFlag) {
             if (set) {
                 pushBack_PtrArray(onTop_RootData_(), d);
@@ -151,6 +191,7 @@ void setPos_Widget(iWidget *d, iInt2 pos) {
 void setSize_Widget(iWidget *d, iInt2 size) {
     d->rect.size = size;
     setFlags_Widget(d, fixedSize_WidgetFlag, iTrue);
+    invalidateArrange_Widget(d);
 }
 
 void setPadding_Widget(iWidget *d, int left, int top, int right, int bottom) {
@@ -158,6 +199,7 @@ void setPadding_Widget(iWidget *d, int left, int top, int right, int bottom) {
     d->padding[1] = top;
     d->padding[2] = right;
     d->padding[3] = bottom;
+    invalidateArrange_Widget(d);
 }
 
 void setBackgroundColor_Widget(iWidget *d, int bgColor) {
@@ -197,6 +239,7 @@ static void setWidth_Widget_(iWidget *d, int width) {
     if (~d->flags & fixedWidth_WidgetFlag || d->flags & collapse_WidgetFlag) {
         if (d->rect.size.x != width) {
             d->rect.size.x = width;
+            invalidateArrange_Widget(d);
             if (class_Widget(d)->sizeChanged) {
                 const int oldHeight = d->rect.size.y;
                 class_Widget(d)->sizeChanged(d);
@@ -214,6 +257,7 @@ static void setHeight_Widget_(iWidget *d, int height) {
     if (~d->flags & fixedHeight_WidgetFlag || d->flags & collapse_WidgetFlag) {
         if (d->rect.size.y != height) {
             d->rect.size.y = height;
+            invalidateArrange_Widget(d);
             if (class_Widget(d)->sizeChanged) {
                 class_Widget(d)->sizeChanged(d);
             }
@@ -258,7 +302,35 @@ static void centerHorizontal_Widget_(iWidget *d) {
                     2;
 }
 
+static iBool isArrangeNeeded_Widget_(iWidget *d) {
+    if (isCollapsed_Widget_(d)) {
+        return iTrue; /* just notes that it was collapsed */
+    }
+    /* Hidden widgets that are not collapsed are arranged as well, because their sizes may
+       be measured while they are hidden (e.g., inactive tab pages). */
+    if (!(d->flags & (needsArrange_WidgetFlag | parentDependentFlags_Widget_))) {
+        /* Nothing has changed in the subtree, so the previous arrangement and the sizes
+           measured during it remain valid. */
+        return iFalse;
+    }
+    return iTrue;
+}
+
+static void arrange_Widget_(iWidget *d);
+
 void arrange_Widget(iWidget *d) {
+    static int depth_;
+    if (depth_++ == 0) {
+        postRefresh_App(); /* widgets may move anywhere */
+    }
+    arrange_Widget_(d);
+    depth_--;
+    if (!isCollapsed_Widget_(d)) {
+        d->flags &= ~needsArrange_WidgetFlag;
+    }
+}
+
+static void arrange_Widget_(iWidget *d) {
     if (isCollapsed_Widget_(d)) {
         setFlags_Widget(d, wasCollapsed_WidgetFlag, iTrue);
         return;
@@ -380,7 +452,9 @@ void arrange_Widget(iWidget *d) {
     iInt2 pos = initv_I2(d->padding);
     iForEach(ObjectList, i, d->children) {
         iWidget *child = as_Widget(i.object);
-        arrange_Widget(child);
+        if (isArrangeNeeded_Widget_(child)) {
+            arrange_Widget(child);
+        }
         if (child->flags & fixedPosition_WidgetFlag) {
             continue;
         }
@@ -587,6 +661,7 @@ iBool processEvent_Widget(iWidget *d, const SDL_Event *ev) {
             else {
                 bounds.pos.y = iMax(bounds.pos.y, winSize.y - height_Rect(bounds));
             }
+            refresh_Widget(d); /* the old position */
             d->rect.pos = localCoord_Widget(d->parent, bounds.pos);
             refresh_Widget(d);
             return iTrue;
@@ -595,7 +670,7 @@ iBool processEvent_Widget(iWidget *d, const SDL_Event *ev) {
     switch (ev->type) {
         case SDL_USEREVENT: {
             if (ev->user.code == command_UserEventCode && d->commandHandler &&
-                d->commandHandler(d, ev->user.data1)) {
+                d->commandHandler(d, command_UserEvent(ev))) {
                 return iTrue;
             }
             break;
@@ -640,16 +715,21 @@ void drawBackground_Widget(const iWidget *d) {
 
 void drawChildren_Widget(const iWidget *d) {
     if (d->flags & hidden_WidgetFlag) return;
+    const iWindow *win = get_Window();
     iConstForEach(ObjectList, i, d->children) {
         const iWidget *child = constAs_Widget(i.object);
-        if (~child->flags & keepOnTop_WidgetFlag && ~child->flags & hidden_WidgetFlag) {
+        if (~child->flags & keepOnTop_WidgetFlag && ~child->flags & hidden_WidgetFlag &&
+            isDrawn_Window(win, bounds_Widget(child))) {
             class_Widget(child)->draw(child);
         }
     }
     /* Root draws the on-top widgets on top of everything else. */
     if (!d->parent) {
         iConstForEach(PtrArray, i, onTop_RootData_()) {
-            draw_Widget(*i.value);
+            const iWidget *top = *i.value;
+            if (isDrawn_Window(win, bounds_Widget(top))) {
+                draw_Widget(top);
+            }
         }
     }
 }
@@ -678,6 +758,7 @@ iAny *addChildPos_Widget(iWidget *d, iAnyObject *child, enum iWidgetAddPos addPo
         pushFront_ObjectList(d->children, widget); /* ref */
     }
     widget->parent = d;
+    invalidateArrange_Widget(widget);
     return child;
 }
 
@@ -699,6 +780,7 @@ iAny *removeChild_Widget(iWidget *d, iAnyObject *child) {
     }
     iAssert(found);
     ((iWidget *) child)->parent = NULL;
+    invalidateArrange_Widget(d);
     postRefresh_App();
     return child;
 }
@@ -787,13 +869,18 @@ iBool isSelected_Widget(const iAnyObject *d) {
     return iFalse;
 }
 
+static iBool isFromWidget_Command_(const char *cmd, const iWidget *widget) {
+    const iWidget *src = pointer_Command(cmd);
+    iAssert(!src || strstr(cmd, " ptr:"));
+    return src == widget || hasParent_Widget(src, widget);
+}
+
 iBool equalWidget_Command(const char *cmd, const iWidget *widget, const char *checkCommand) {
-    if (equal_Command(cmd, checkCommand)) {
-        const iWidget *src = pointer_Command(cmd);
-        iAssert(!src || strstr(cmd, " ptr:"));
-        return src == widget || hasParent_Widget(src, widget);
-    }
-    return iFalse;
+    return equal_Command(cmd, checkCommand) && isFromWidget_Command_(cmd, widget);
+}
+
+iBool isWidget_Command(const char *cmd, const iWidget *widget, enum iCommandId checkId) {
+    return id_Command(cmd) == checkId && isFromWidget_Command_(cmd, widget);
 }
 
 iBool isCommand_Widget(const iWidget *d, const SDL_Event *ev, const char *cmd) {
@@ -905,12 +992,11 @@ void postCommand_Widget(const iAnyObject *d, const char *cmd, ...) {
 }
 
 void refresh_Widget(const iAnyObject *d) {
-    /* TODO: Could be widget specific, if parts of the tree are cached. */
+    /* Only the widget's area of the window is redrawn. */
     /* TODO: The visbuffer in DocumentWidget and ListWidget could be moved to be a general
        purpose feature of Widget. */
     iAssert(isInstance_Object(d, &Class_Widget));
-    iUnused(d);
-    postRefresh_App();
+    postRefreshRect_App(bounds_Widget(constAs_Widget(d)));
 }
 
 iBeginDefineClass(Widget)
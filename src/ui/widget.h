@@ -24,6 +24,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 /* Base class for UI widgets. */
 
+#include "command.h"
 #include "metrics.h"
 
 #include <the_Foundation/object.h>
@@ -89,6 +90,7 @@ enum iWidgetFlag {
 #define wrapText_WidgetFlag                 iBit64(35)
 #define borderTop_WidgetFlag                iBit64(36)
 #define overflowScrollable_WidgetFlag       iBit64(37)
+#define needsArrange_WidgetFlag             iBit64(38) /* widget or a descendant must be arranged */
 
 enum iWidgetAddPos {
     back_WidgetAddPos,
@@ -196,6 +198,7 @@ iAny *  removeChild_Widget  (iWidget *, iAnyObject *child); /* returns a ref */
 iAny *  child_Widget        (iWidget *, size_t index); /* O(n) */
 size_t  childIndex_Widget   (const iWidget *, const iAnyObject *child); /* O(n) */
 void    arrange_Widget      (iWidget *);
+void    invalidateArrange_Widget    (iAnyObject *); /* rearranged with the next parent arrange */
 iBool   dispatchEvent_Widget(iWidget *, const SDL_Event *);
 iBool   processEvent_Widget (iWidget *, const SDL_Event *);
 void    postCommand_Widget  (const iAnyObject *, const char *cmd, ...);
@@ -209,3 +212,4 @@ void    setMouseGrab_Widget (iWidget *);
 iWidget *mouseGrab_Widget   (void);
 
 iBool   equalWidget_Command (const char *cmd, const iWidget *widget, const char *checkCommand);
+iBool   isWidget_Command    (const char *cmd, const iWidget *widget, enum iCommandId checkId);
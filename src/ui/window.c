@@ -36,6 +36,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include "../visited.h"
 #include "../gmcerts.h"
 #include "../gmutil.h"
+#include "../profiler.h"
 #include "../visited.h"
 #if defined (iPlatformMsys)
 #   include "../win32.h"
@@ -55,6 +56,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 static iWindow *theWindow_ = NULL;
 
+enum { maxDamageRegions_Window_ = 16 };
+
 #if defined (iPlatformApple)
 static float initialUiScale_ = 1.0f;
 #else
@@ -559,6 +562,13 @@ iBool create_Window_(iWindow *d, iRect rect, uint32_t flags) {
 
 void init_Window(iWindow *d, iRect rect) {
     theWindow_ = d;
+    d->composite = NULL;
+    init_Mutex(&d->damageMutex);
+    init_Array(&d->damage, sizeof(iRect));
+    d->isFullyDamaged   = iTrue;
+    d->drawClip         = zero_Rect();
+    d->isFlashingDamage = iFalse;
+    d->isFlashVisible   = iFalse;
     iZap(d->cursors);
     d->initialPos = rect.pos;
     d->lastRect = rect;
@@ -629,6 +639,7 @@ void init_Window(iWindow *d, iRect rect) {
     }
 #endif
     d->root = new_Widget();
+    d->drawTime = 0;
     d->presentTime = 0.0;
     d->frameTime = SDL_GetTicks();
     setId_Widget(d->root, "root");
@@ -650,6 +661,11 @@ void deinit_Window(iWindow *d) {
     }
     iReleasePtr(&d->root);
     deinit_Text();
+    if (d->composite) {
+        SDL_DestroyTexture(d->composite);
+    }
+    deinit_Array(&d->damage);
+    deinit_Mutex(&d->damageMutex);
     SDL_DestroyRenderer(d->render);
     SDL_DestroyWindow(d->win);
 }
@@ -740,6 +756,7 @@ iBool processEvent_Window(iWindow *d, const SDL_Event *ev) {
         }
         case SDL_RENDER_TARGETS_RESET:
         case SDL_RENDER_DEVICE_RESET: {
+            damageAll_Window(d); /* the composite was lost */
             resetFonts_Text();
             postCommand_App("theme.changed"); /* forces UI invalidation */
             break;
@@ -801,6 +818,16 @@ iBool processEvent_Window(iWindow *d, const SDL_Event *ev) {
                 }
             }
             if (oldHover != hover_Widget()) {
+                if (oldHover) {
+                    refresh_Widget(oldHover);
+                }
+                if (hover_Widget()) {
+                    refresh_Widget(hover_Widget());
+                }
+            }
+            if (event.type != SDL_MOUSEMOTION && event.type != SDL_USEREVENT) {
+                /* Input may change the state of any widget. Widgets are expected to refresh
+                   themselves after commands and pointer movement. */
                 postRefresh_App();
             }
             if (event.type == SDL_MOUSEMOTION) {
@@ -812,19 +839,199 @@ iBool processEvent_Window(iWindow *d, const SDL_Event *ev) {
     return iFalse;
 }
 
+static void drawProfilerOverlay_Window_(iWindow *d) {
+    const iProfileFrame *last  = lastFrame_Profiler();
+    const iProfileFrame *peak  = peakFrame_Profiler();
+    const int            font  = defaultMonospace_FontId;
+    const int            lineH = lineHeight_Text(font);
+    const iInt2          size  = init_I2(advance_Text(font, "0000000000000000000000000000000000000").x,
+                                         (max_ProfileZone + 7) * lineH);
+    const iRect          rect  = { init_I2(d->root->rect.size.x - size.x - 3 * gap_UI, 3 * gap_UI),
+                                   add_I2(size, init1_I2(2 * gap_UI)) };
+    iPaint p;
+    init_Paint(&p);
+    fillRect_Paint(&p, rect, uiBackground_ColorId);
+    drawRect_Paint(&p, rect, uiSeparator_ColorId);
+    iInt2 pos = add_I2(rect.pos, init1_I2(gap_UI));
+    draw_Text(font, pos, uiTextStrong_ColorId, "%-19s%7s%9s", "(ms)", "last", "peak");
+    pos.y += lineH;
+    draw_Text(font, pos, uiText_ColorId, "%-19s%7.2f%9.2f", "frame interval",
+              last->interval / 1000.0f, peak->interval / 1000.0f);
+    pos.y += lineH;
+    for (int i = 0; i < max_ProfileZone; i++) {
+        draw_Text(font, pos, uiText_ColorId, "%-19.19s%7.2f%9.2f", zoneName_Profiler(i),
+                  last->zoneTime[i] / 1000.0f, peak->zoneTime[i] / 1000.0f);
+        pos.y += lineH;
+    }
+    draw_Text(font, pos, uiText_ColorId, "%-19s%7u%9u", "glyph cache misses",
+              last->counters[glyphCacheMiss_ProfileCounter],
+              peak->counters[glyphCacheMiss_ProfileCounter]);
+    pos.y += lineH;
+    draw_Text(font, pos, uiText_ColorId, "%-19s%7u%9u", "glyph cache flushes",
+              last->counters[glyphCacheFlush_ProfileCounter],
+              peak->counters[glyphCacheFlush_ProfileCounter]);
+    pos.y += lineH;
+    draw_Text(font, pos, uiText_ColorId, "%-19s%7.1f", "glyph cache use %",
+              glyphCacheUsage_Text() * 100.0f);
+    pos.y += lineH;
+    draw_Text(font, pos, uiText_ColorId, "%-19s%7zu", "glyph cache KB",
+              glyphCacheBytes_Text() / 1024);
+    pos.y += lineH;
+    draw_Text(font, pos, uiText_ColorId, "%-19s%7u%9u", "missed frames",
+              last->counters[missedFrame_ProfileCounter],
+              peak->counters[missedFrame_ProfileCounter]);
+}
+
+static iBool updateComposite_Window_(iWindow *d) {
+    /* Returns iFalse if the renderer cannot draw into textures. */
+    const iInt2 size = rootSize_Window(d);
+    if (d->composite && !isEqual_I2(size_SDLTexture(d->composite), size)) {
+        SDL_DestroyTexture(d->composite);
+        d->composite = NULL;
+    }
+    if (!d->composite && SDL_RenderTargetSupported(d->render)) {
+        d->composite = SDL_CreateTexture(d->render,
+                                         SDL_PIXELFORMAT_RGBA8888,
+                                         SDL_TEXTUREACCESS_TARGET,
+                                         size.x,
+                                         size.y);
+        if (d->composite) {
+            SDL_SetTextureBlendMode(d->composite, SDL_BLENDMODE_NONE);
+        }
+        damageAll_Window(d);
+    }
+    return d->composite != NULL;
+}
+
+static uint32_t hideFlash_Window_(uint32_t interval, void *context) {
+    iUnused(interval, context);
+    postRefreshRect_App(zero_Rect());
+    return 0;
+}
+
+static void drawDamageFlash_Window_(iWindow *d, const iArray *damage) {
+    SDL_SetRenderDrawBlendMode(d->render, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(d->render, 255, 0, 255, 96);
+    if (isEmpty_Array(damage)) {
+        SDL_RenderFillRect(d->render, NULL);
+    }
+    else {
+        iConstForEach(Array, i, damage) {
+            SDL_RenderFillRect(d->render, i.value);
+        }
+    }
+    d->isFlashVisible = iTrue;
+    SDL_AddTimer(100, hideFlash_Window_, NULL);
+}
+
+void addDamage_Window(iWindow *d, iRect rect) {
+    if (!d->root) {
+        return;
+    }
+    rect = clipped_Rect(rect, (iRect){ zero_I2(), rootSize_Window(d) });
+    if (isEmpty_Rect(rect)) {
+        return;
+    }
+    lock_Mutex(&d->damageMutex);
+    if (!d->isFullyDamaged) {
+        /* Overlapping regions are combined so nothing gets drawn twice. */
+        iBool isMerged = iFalse;
+        iForEach(Array, i, &d->damage) {
+            iRect *region = i.value;
+            if (!isEmpty_Rect(clipped_Rect(*region, rect))) {
+                *region  = union_Rect(*region, rect);
+                isMerged = iTrue;
+                break;
+            }
+        }
+        if (!isMerged) {
+            if (size_Array(&d->damage) < maxDamageRegions_Window_) {
+                pushBack_Array(&d->damage, &rect);
+            }
+            else {
+                iRect *last = at_Array(&d->damage, size_Array(&d->damage) - 1);
+                *last = union_Rect(*last, rect);
+            }
+        }
+    }
+    unlock_Mutex(&d->damageMutex);
+}
+
+void damageAll_Window(iWindow *d) {
+    lock_Mutex(&d->damageMutex);
+    d->isFullyDamaged = iTrue;
+    clear_Array(&d->damage);
+    unlock_Mutex(&d->damageMutex);
+}
+
+void setFlashDamage_Window(iWindow *d, iBool flash) {
+    d->isFlashingDamage = flash;
+    postRefresh_App();
+}
+
+iBool isDrawn_Window(const iWindow *d, iRect rect) {
+    return isEmpty_Rect(d->drawClip) || !isEmpty_Rect(clipped_Rect(rect, d->drawClip));
+}
+
 void draw_Window(iWindow *d) {
     if (d->isDrawFrozen) {
         return;
     }
+    const uint64_t profileTime = begin_Profiler();
 //#if !defined (NDEBUG)
 //    printf("draw %d\n", d->frameTime); fflush(stdout);
 //#endif
-    /* Clear the window. */
-    SDL_SetRenderDrawColor(d->render, 0, 0, 0, 255);
-    SDL_RenderClear(d->render);
-    /* Draw widgets. */
+    /* Widgets are drawn into the composite texture, and only the regions that have been
+       damaged since the previous frame need redrawing. */
+    const iBool hasComposite = updateComposite_Window_(d);
+    iArray damage;
+    lock_Mutex(&d->damageMutex);
+    const iBool isFull = d->isFullyDamaged || !hasComposite;
+    init_Array(&damage, sizeof(iRect));
+    pushBackN_Array(&damage, constData_Array(&d->damage), size_Array(&d->damage));
+    d->isFullyDamaged = iFalse;
+    clear_Array(&d->damage);
+    unlock_Mutex(&d->damageMutex);
+    const iBool isDamaged = isFull || !isEmpty_Array(&damage);
+    d->drawTime = 0;
+    if (!isDamaged && !d->isFlashVisible && !isEnabled_Profiler()) {
+        /* Nothing has changed since the last frame. */
+        deinit_Array(&damage);
+        end_Profiler(drawWindow_ProfileZone, profileTime);
+        return;
+    }
     d->frameTime = SDL_GetTicks();
-    draw_Widget(d->root);
+    const uint64_t drawStart = SDL_GetPerformanceCounter();
+    if (hasComposite) {
+        SDL_SetRenderTarget(d->render, d->composite);
+    }
+    if (isFull) {
+        clear_Array(&damage);
+        SDL_SetRenderDrawColor(d->render, 0, 0, 0, 255);
+        SDL_RenderClear(d->render);
+        draw_Widget(d->root);
+    }
+    else {
+        iConstForEach(Array, i, &damage) {
+            /* Widgets outside the region are skipped, and the rest are clipped to it. */
+            d->drawClip = *(const iRect *) i.value;
+            SDL_RenderSetClipRect(d->render, i.value);
+            SDL_SetRenderDrawColor(d->render, 0, 0, 0, 255);
+            SDL_RenderFillRect(d->render, i.value);
+            draw_Widget(d->root);
+        }
+        d->drawClip = zero_Rect();
+        SDL_RenderSetClipRect(d->render, NULL);
+    }
+    if (hasComposite) {
+        SDL_SetRenderTarget(d->render, NULL);
+        SDL_RenderCopy(d->render, d->composite, NULL, NULL);
+    }
+    d->isFlashVisible = iFalse;
+    if (d->isFlashingDamage && isDamaged) {
+        drawDamageFlash_Window_(d, &damage);
+    }
+    deinit_Array(&damage);
 #if 0
     /* Text cache debugging. */ {
         SDL_Texture *cache = glyphCache_Text();
@@ -834,7 +1041,14 @@ void draw_Window(iWindow *d) {
         SDL_RenderCopy(d->render, glyphCache_Text(), NULL, &rect);
     }
 #endif
+    if (isEnabled_Profiler()) {
+        drawProfilerOverlay_Window_(d);
+    }
+    d->drawTime = iMax(1, (uint32_t) ((SDL_GetPerformanceCounter() - drawStart) * 1000000 /
+                                      SDL_GetPerformanceFrequency()));
     SDL_RenderPresent(d->render);
+    end_Profiler(drawWindow_ProfileZone, profileTime);
+    endFrame_Profiler();
 }
 
 void resize_Window(iWindow *d, int w, int h) {
@@ -905,6 +1119,10 @@ uint32_t frameTime_Window(const iWindow *d) {
     return d->frameTime;
 }
 
+uint32_t drawTime_Window(const iWindow *d) {
+    return d->drawTime;
+}
+
 iWindow *get_Window(void) {
     return theWindow_;
 }
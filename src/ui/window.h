@@ -24,6 +24,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "widget.h"
 
+#include <the_Foundation/array.h>
+#include <the_Foundation/mutex.h>
 #include <the_Foundation/rect.h>
 #include <SDL_events.h>
 #include <SDL_render.h>
@@ -44,9 +46,17 @@ struct Impl_Window {
     float         pixelRatio;
     float         uiScale;
     uint32_t      frameTime;
+    uint32_t      drawTime; /* microseconds, not including presenting; zero if nothing drawn */
     double        presentTime;
     SDL_Cursor *  cursors[SDL_NUM_SYSTEM_CURSORS];
     SDL_Cursor *  pendingCursor;
+    SDL_Texture * composite; /* window contents; only damaged regions are redrawn */
+    iMutex        damageMutex;
+    iArray        damage; /* iRect regions to redraw in the next frame */
+    iBool         isFullyDamaged;
+    iRect         drawClip; /* region being redrawn; zero size when drawing everything */
+    iBool         isFlashingDamage; /* debug: highlight the redrawn regions */
+    iBool         isFlashVisible;
 };
 
 iBool       processEvent_Window     (iWindow *, const SDL_Event *);
@@ -57,12 +67,17 @@ void        setTitle_Window         (iWindow *, const iString *title);
 void        setUiScale_Window       (iWindow *, float uiScale);
 void        setFreezeDraw_Window    (iWindow *, iBool freezeDraw);
 void        setCursor_Window        (iWindow *, int cursor);
+void        addDamage_Window        (iWindow *, iRect rect); /* thread-safe */
+void        damageAll_Window        (iWindow *); /* thread-safe */
+void        setFlashDamage_Window   (iWindow *, iBool flash);
 
 iInt2       rootSize_Window         (const iWindow *);
 float       uiScale_Window          (const iWindow *);
 iInt2       coord_Window            (const iWindow *, int x, int y);
 iInt2       mouseCoord_Window       (const iWindow *);
 uint32_t    frameTime_Window        (const iWindow *);
+uint32_t    drawTime_Window         (const iWindow *);
 SDL_Renderer *renderer_Window       (const iWindow *);
+iBool       isDrawn_Window          (const iWindow *, iRect rect); /* overlaps the drawn region */
 
 iWindow *   get_Window              (void);
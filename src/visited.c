@@ -22,6 +22,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include "visited.h"
 #include "app.h"
+#include "saver.h"
 
 #include <the_Foundation/file.h>
 #include <the_Foundation/mutex.h>
@@ -73,30 +74,26 @@ void deinit_Visited(iVisited *d) {
 }
 
 void save_Visited(const iVisited *d, const char *dirPath) {
-    iString *line = new_String();
-    iFile *f = newCStr_File(concatPath_CStr(dirPath, "visited.txt"));
-    if (open_File(f, writeOnly_FileMode | text_FileMode)) {
-        lock_Mutex(d->mtx);
-        iConstForEach(Array, i, &d->visited.values) {
-            const iVisitedUrl *item = i.value;
-            iDate date;
-            init_Date(&date, &item->when);
-            format_String(line,
-                          "%04d-%02d-%02dT%02d:%02d:%02d %04x %s\n",
-                          date.year,
-                          date.month,
-                          date.day,
-                          date.hour,
-                          date.minute,
-                          date.second,
-                          item->flags,
-                          cstr_String(&item->url));
-            writeData_File(f, cstr_String(line), size_String(line));
-        }
-        unlock_Mutex(d->mtx);
+    iString *content = new_String();
+    lock_Mutex(d->mtx);
+    iConstForEach(Array, i, &d->visited.values) {
+        const iVisitedUrl *item = i.value;
+        iDate date;
+        init_Date(&date, &item->when);
+        appendFormat_String(content,
+                            "%04d-%02d-%02dT%02d:%02d:%02d %04x %s\n",
+                            date.year,
+                            date.month,
+                            date.day,
+                            date.hour,
+                            date.minute,
+                            date.second,
+                            item->flags,
+                            cstr_String(&item->url));
     }
-    iRelease(f);
-    delete_String(line);
+    unlock_Mutex(d->mtx);
+    submitTextCStr_Saver(concatPath_CStr(dirPath, "visited.txt"), content);
+    delete_String(content);
 }
 
 void load_Visited(iVisited *d, const char *dirPath) {